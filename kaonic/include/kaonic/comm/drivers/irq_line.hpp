@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+
+#include "kaonic/common/error.hpp"
+
+namespace kaonic::drivers {
+
+// Edge events of a requested GPIO line, read without blocking.
+// The IRQ thread polls the line without a lock while another thread may take the same edge, so
+// a reader never waits for an event that is already gone.
+class irq_line final {
+
+public:
+    explicit irq_line() noexcept = default;
+    ~irq_line() = default;
+
+    // Switches the line request fd to non-blocking reads, the fd stays owned by the request
+    [[nodiscard]] auto open(int fd) -> error;
+
+    [[nodiscard]] auto fd() const noexcept -> int { return _fd; }
+
+    // Waits until an edge is pending or the timeout expires
+    [[nodiscard]] auto wait(std::chrono::nanoseconds timeout) const noexcept -> bool;
+
+    // Takes every pending edge and the time of the latest one, false when none was pending
+    [[nodiscard]] auto take(std::chrono::nanoseconds& timestamp) const noexcept -> bool;
+
+protected:
+    irq_line(const irq_line&) = delete;
+    irq_line(irq_line&&) = delete;
+
+    irq_line& operator=(const irq_line&) = delete;
+    irq_line& operator=(irq_line&&) = delete;
+
+private:
+    int _fd = -1;
+};
+
+} // namespace kaonic::drivers
@@ -6,6 +6,8 @@
 
 #include "kaonic/common/error.hpp"
 
+#include <linux/spi/spidev.h>
+
 namespace kaonic::drivers {
 
 struct spi_config final {
@@ -15,6 +17,43 @@ struct spi_config final {
     uint8_t bits_per_word = 8;
 };
 
+// Register writes collected to be submitted with a single ioctl.
+// Writes to contiguous addresses are merged into one auto-increment burst.
+class spi_batch final {
+
+public:
+    explicit spi_batch() noexcept = default;
+    ~spi_batch() = default;
+
+    auto write(const uint16_t addr, const uint8_t* buffer, size_t length) -> void;
+
+    auto clear() noexcept -> void;
+
+    [[nodiscard]] auto empty() const noexcept -> bool { return _bursts.empty(); }
+
+    [[nodiscard]] auto bursts() const noexcept -> size_t { return _bursts.size(); }
+
+protected:
+    spi_batch(const spi_batch&) = delete;
+    spi_batch(spi_batch&&) = delete;
+
+    spi_batch& operator=(const spi_batch&) = delete;
+    spi_batch& operator=(spi_batch&&) = delete;
+
+private:
+    friend class spi;
+
+    struct burst final {
+        uint16_t addr;
+        uint16_t header;
+        size_t offset;
+        size_t length;
+    };
+
+    std::vector<burst> _bursts;
+    std::vector<uint8_t> _data;
+};
+
 class spi final {
 
 public:
@@ -28,6 +67,9 @@ public:
     [[nodiscard]] auto write_buffer(const uint16_t addr, const uint8_t* buffer, size_t length)
         -> error;
 
+    // Submits every queued burst and clears the batch
+    [[nodiscard]] auto submit(spi_batch& batch) -> error;
+
     auto close() noexcept -> void;
 
 protected:
@@ -40,6 +82,8 @@ protected:
 private:
     int _device_fd;
     spi_config _config;
+
+    std::vector<struct spi_ioc_transfer> _xfers;
 };
 
 } // namespace kaonic::drivers
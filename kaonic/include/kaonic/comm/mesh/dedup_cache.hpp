@@ -0,0 +1,107 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <stddef.h>
+#include <vector>
+
+#include "kaonic/comm/mesh/network_interface.hpp"
+
+namespace kaonic::comm::mesh {
+
+struct dedup_config final {
+    // Frames remembered at once, rounded up to a power of two
+    size_t capacity = 1024;
+
+    // Copy of a frame arriving later than this is delivered again
+    std::chrono::milliseconds window { 2000 };
+};
+
+struct dedup_stats final {
+    size_t lookups = 0;
+    size_t duplicates = 0;
+
+    // Key matched a remembered frame but the payload fingerprint didn't
+    size_t false_positives = 0;
+
+    // Frames forgotten before their window ended to make room
+    size_t evictions = 0;
+
+    [[nodiscard]] auto hit_rate() const noexcept -> double {
+        return lookups ? static_cast<double>(duplicates) / static_cast<double>(lookups) : 0.0;
+    }
+};
+
+// Time-windowed set of recently seen frames in a fixed open-addressed table.
+// Routed frames are keyed by source and sequence number. Other frames are keyed by a payload
+// hash and only count as duplicates when heard on another module, since a node may well send
+// the same payload twice. A second payload hash is kept with every key to tell key collisions
+// from duplicates.
+class dedup_cache final {
+
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit dedup_cache(const dedup_config& config) noexcept;
+    ~dedup_cache() = default;
+
+    dedup_cache(const dedup_cache&) = default;
+    dedup_cache(dedup_cache&&) = default;
+
+    // Returns true when the frame was seen within the window, remembers it otherwise
+    [[nodiscard]] auto check(const frame_view& frame, clock::time_point now) noexcept -> bool;
+
+    auto clear() noexcept -> void;
+
+    [[nodiscard]] auto get_stats() const noexcept -> dedup_stats { return _stats; }
+
+    dedup_cache& operator=(const dedup_cache&) = default;
+    dedup_cache& operator=(dedup_cache&&) = default;
+
+private:
+    struct entry final {
+        uint64_t key = 0;
+        uint32_t fingerprint = 0;
+        uint8_t module = 0;
+        // Time the frame was first seen, 0 for a free slot
+        int64_t seen = 0;
+    };
+
+    [[nodiscard]] auto is_live(const entry& entry, int64_t now) const noexcept -> bool;
+
+private:
+    int64_t _window;
+
+    std::vector<entry> _entries;
+    size_t _mask;
+
+    dedup_stats _stats;
+};
+
+// Cache shared by the broadcasters of several modules, a frame heard on more than one radio is
+// delivered on the module that heard it first
+class dedup_filter final {
+
+public:
+    explicit dedup_filter(const dedup_config& config) noexcept;
+    ~dedup_filter() = default;
+
+    // Returns true when the frame was seen within the window, remembers it otherwise
+    [[nodiscard]] auto check(const frame_view& frame) noexcept -> bool;
+
+    [[nodiscard]] auto get_stats() const noexcept -> dedup_stats;
+
+protected:
+    dedup_filter(const dedup_filter&) = delete;
+    dedup_filter(dedup_filter&&) = delete;
+
+    dedup_filter& operator=(const dedup_filter&) = delete;
+    dedup_filter& operator=(dedup_filter&&) = delete;
+
+private:
+    dedup_cache _cache;
+    mutable std::mutex _mut;
+};
+
+} // namespace kaonic::comm::mesh
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <stddef.h>
+#include <vector>
+
+#include "kaonic/comm/mesh/network_interface.hpp"
+#include "kaonic/common/error.hpp"
+#include "kaonic/common/span.hpp"
+
+namespace kaonic::comm::mesh {
+
+struct fragmentation_config final {
+    // Frames carry a fragment header and payloads larger than one frame are split.
+    // Nodes without it see the header as part of the payload.
+    bool enabled = false;
+
+    // Largest frame handed to rfnet, fragment and routing headers included.
+    // Leaves room for rfnet's own header within the radio's data_max_size.
+    size_t mtu = 1792;
+
+    // Largest payload accepted for transmission and reassembly
+    size_t max_payload = 64 * 1024;
+
+    // Messages reassembled at once and the memory all of them may take
+    size_t max_messages = 8;
+    size_t max_memory = 256 * 1024;
+
+    // Incomplete message is dropped when no fragment of it arrived for this long
+    std::chrono::milliseconds timeout { 2000 };
+};
+
+struct fragmentation_stats final {
+    size_t messages_sent = 0;
+    size_t fragments_sent = 0;
+
+    size_t fragments_received = 0;
+    size_t reassembled = 0;
+
+    // Fragments heard twice, malformed or of messages that don't fit the limits
+    size_t duplicates = 0;
+    size_t rejected = 0;
+
+    // Incomplete messages dropped on timeout or to make room for a newer one
+    size_t timed_out = 0;
+    size_t evicted = 0;
+};
+
+// Header in front of every fragment, offset and total size are in payload bytes
+struct fragment_header final {
+    uint32_t id = 0;
+    uint8_t index = 0;
+    uint8_t count = 0;
+    uint32_t offset = 0;
+    uint32_t total = 0;
+};
+
+// Splits payloads into numbered fragments that fit one frame each
+class fragmenter final {
+
+public:
+    constexpr static size_t header_size = 16;
+
+    // Fragments can't be more than this many, the index is a single byte
+    constexpr static size_t max_fragments = 255;
+
+    // Overhead is the size of the headers in front of the fragment header, e.g. routing
+    explicit fragmenter(const fragmentation_config& config, size_t overhead) noexcept;
+    ~fragmenter() = default;
+
+    fragmenter(const fragmenter&) = default;
+    fragmenter(fragmenter&&) = default;
+
+    // Payload bytes carried by one fragment
+    [[nodiscard]] auto fragment_size() const noexcept -> size_t { return _fragment_size; }
+
+    // Largest payload that can be sent
+    [[nodiscard]] auto max_payload() const noexcept -> size_t { return _max_payload; }
+
+    // Number of fragments of a payload, 0 when it's too large to be sent
+    [[nodiscard]] auto count(size_t size) const noexcept -> size_t;
+
+    // Starts a message of 'size' bytes and sets the header of its first fragment
+    [[nodiscard]] auto start(size_t size, fragment_header& header) noexcept -> error;
+
+    // Header of a fragment of the message 'first' belongs to
+    [[nodiscard]] auto fragment(const fragment_header& first, size_t index) const noexcept
+        -> fragment_header;
+
+    // Payload bytes carried by the fragment, it starts at header.offset
+    [[nodiscard]] auto length(const fragment_header& header) const noexcept -> size_t;
+
+    static auto encode(const fragment_header& header, span<uint8_t> buffer) noexcept -> void;
+
+    [[nodiscard]] static auto decode(span<const uint8_t> frame,
+                                     fragment_header& header,
+                                     span<const uint8_t>& payload) noexcept -> bool;
+
+    // Messages and fragments sent, the receive counters are left at 0
+    [[nodiscard]] auto get_stats() const noexcept -> fragmentation_stats { return _stats; }
+
+    fragmenter& operator=(const fragmenter&) = default;
+    fragmenter& operator=(fragmenter&&) = default;
+
+private:
+    size_t _fragment_size;
+    size_t _max_payload;
+
+    uint32_t _id;
+
+    fragmentation_stats _stats;
+};
+
+// Collects fragments into whole messages in a fixed number of slots within a memory budget.
+// Slot buffers are kept between messages, so a steady stream doesn't allocate.
+class reassembler final {
+
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit reassembler(const fragmentation_config& config) noexcept;
+    ~reassembler() = default;
+
+    reassembler(const reassembler&) = default;
+    reassembler(reassembler&&) = default;
+
+    // Adds a fragment, returns true when it completed its message. 'message' then borrows
+    // the payload until the next call and carries the link info of the first fragment.
+    [[nodiscard]] auto receive(const frame_view& frame,
+                               clock::time_point now,
+                               frame_view& message) noexcept -> bool;
+
+    // Drops messages that stalled for longer than the timeout, returns how many were dropped
+    auto expire(clock::time_point now) noexcept -> size_t;
+
+    // Memory taken by the messages being reassembled
+    [[nodiscard]] auto memory() const noexcept -> size_t { return _memory; }
+
+    [[nodiscard]] auto get_stats() const noexcept -> fragmentation_stats { return _stats; }
+
+    reassembler& operator=(const reassembler&) = default;
+    reassembler& operator=(reassembler&&) = default;
+
+private:
+    struct slot final {
+        bool active = false;
+
+        uint64_t source = 0;
+        uint8_t module = 0;
+        uint32_t id = 0;
+
+        uint8_t count = 0;
+        uint8_t received = 0;
+        // Payload bytes of every fragment but the last, 0 until the first fragment arrived
+        size_t stride = 0;
+        std::bitset<fragmenter::max_fragments> fragments;
+
+        std::vector<uint8_t> buffer;
+        frame_info info;
+
+        clock::time_point updated;
+    };
+
+    [[nodiscard]] auto find(const frame_info& info, uint32_t id) noexcept -> slot*;
+
+    // Whether the fragment takes its own place in the message, so that distinct indices
+    // cover all of it without overlaps
+    [[nodiscard]] static auto fits(slot& slot, const fragment_header& header, size_t size) noexcept
+        -> bool;
+
+    // Free slot with room for 'size' bytes, older messages are evicted to make it
+    [[nodiscard]] auto allocate(size_t size) noexcept -> slot*;
+
+    auto release(slot& slot) noexcept -> void;
+
+private:
+    fragmentation_config _config;
+
+    std::vector<slot> _slots;
+    size_t _memory = 0;
+
+    fragmentation_stats _stats;
+};
+
+} // namespace kaonic::comm::mesh
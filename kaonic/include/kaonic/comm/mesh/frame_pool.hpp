@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+
+#include "kaonic/common/span.hpp"
+
+namespace kaonic::comm::mesh {
+
+class frame_pool;
+
+struct frame_slot final {
+    std::atomic<uint32_t> refs { 0 };
+
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    // Pool the slot goes back to, nullptr for a heap slot of an oversized frame
+    frame_pool* pool = nullptr;
+    frame_slot* next = nullptr;
+};
+
+// Ref-counted handle to a frame buffer, the last handle returns the buffer to its pool.
+// Copies share the bytes, they're written before the handle is shared.
+class frame_buffer final {
+
+public:
+    frame_buffer() noexcept = default;
+    ~frame_buffer();
+
+    frame_buffer(const frame_buffer& other) noexcept;
+    frame_buffer(frame_buffer&& other) noexcept;
+
+    frame_buffer& operator=(const frame_buffer& other) noexcept;
+    frame_buffer& operator=(frame_buffer&& other) noexcept;
+
+    [[nodiscard]] auto data() const noexcept -> uint8_t* { return _slot ? _slot->data : nullptr; }
+
+    [[nodiscard]] auto size() const noexcept -> size_t { return _slot ? _slot->size : 0; }
+
+    [[nodiscard]] auto capacity() const noexcept -> size_t {
+        return _slot ? _slot->capacity : 0;
+    }
+
+    [[nodiscard]] auto empty() const noexcept -> bool { return size() == 0; }
+
+    // Sets the size within the capacity, returns false when it doesn't fit
+    auto resize(size_t size) noexcept -> bool;
+
+    auto reset() noexcept -> void;
+
+    [[nodiscard]] explicit operator bool() const noexcept { return _slot != nullptr; }
+
+private:
+    friend class frame_pool;
+
+    explicit frame_buffer(frame_slot* slot) noexcept;
+
+private:
+    frame_slot* _slot = nullptr;
+};
+
+struct frame_pool_stats final {
+    size_t capacity = 0;
+    size_t available = 0;
+
+    size_t allocated = 0;
+
+    // Requests that found the pool empty and frames too large for a slot, which got a
+    // buffer of their own from the heap
+    size_t exhausted = 0;
+    size_t oversized = 0;
+};
+
+// Fixed number of radio frame sized buffers allocated at startup and shared by the frame path.
+// Handles may be released from any thread, the pool has to outlive them.
+class frame_pool final {
+
+public:
+    // Largest frame of the radio, data_max_size
+    constexpr static size_t slot_size = 2048;
+
+    // Slots of another capacity hold what the frame path derives from frames, e.g. their
+    // serialized responses
+    explicit frame_pool(size_t count, size_t slot_capacity = slot_size) noexcept;
+    ~frame_pool() = default;
+
+    // Buffer of 'size' bytes. Falls back to the heap when the pool is exhausted or the frame
+    // doesn't fit a slot, every holder of buffers is bounded so that stays bounded too.
+    [[nodiscard]] auto allocate(size_t size) noexcept -> frame_buffer;
+
+    [[nodiscard]] auto copy(span<const uint8_t> data) noexcept -> frame_buffer;
+
+    [[nodiscard]] auto get_stats() const noexcept -> frame_pool_stats;
+
+    [[nodiscard]] auto slot_capacity() const noexcept -> size_t { return _slot_capacity; }
+
+protected:
+    frame_pool(const frame_pool&) = delete;
+    frame_pool(frame_pool&&) = delete;
+
+    frame_pool& operator=(const frame_pool&) = delete;
+    frame_pool& operator=(frame_pool&&) = delete;
+
+private:
+    friend class frame_buffer;
+
+    static auto release(frame_slot* slot) noexcept -> void;
+
+    auto recycle(frame_slot* slot) noexcept -> void;
+
+private:
+    const size_t _count;
+    const size_t _slot_capacity;
+
+    std::unique_ptr<uint8_t[]> _storage;
+    std::unique_ptr<frame_slot[]> _slots;
+
+    frame_slot* _free = nullptr;
+    size_t _available = 0;
+
+    frame_pool_stats _stats;
+
+    mutable std::mutex _mut;
+};
+
+} // namespace kaonic::comm::mesh
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stddef.h>
+#include <vector>
+
+#include "kaonic/comm/mesh/network_interface.hpp"
+
+namespace kaonic::comm::mesh {
+
+// What happens once a subscriber is 'depth' frames behind the ring
+enum class overflow_policy {
+    // Subscriber skips its stalest frames and stays within 'depth' of the newest one
+    drop_oldest,
+    // Subscriber keeps its backlog, frames published until it has read it are skipped
+    drop_newest,
+    // Subscriber is cut off, e.g. so its client reconnects
+    disconnect,
+};
+
+struct subscriber_config final {
+    // Clamped to the capacity of the ring
+    size_t depth = 64;
+    overflow_policy policy = overflow_policy::drop_oldest;
+};
+
+struct subscriber_stats final {
+    size_t delivered = 0;
+    size_t dropped = 0;
+
+    // Frames published and not yet read
+    size_t lag = 0;
+
+    bool disconnected = false;
+};
+
+class frame_subscriber;
+
+// Single producer broadcast ring of pooled frames. Every subscriber reads every frame through
+// its own cursor, the frames share the buffer the producer published.
+class frame_ring final {
+
+public:
+    explicit frame_ring(size_t capacity) noexcept;
+    ~frame_ring() = default;
+
+    // Never blocks, frame isn't kept while nobody is subscribed
+    auto publish(const frame& frame) noexcept -> void;
+
+    [[nodiscard]] auto capacity() const noexcept -> size_t { return _slots.size(); }
+
+    [[nodiscard]] auto subscriber_count() const noexcept -> size_t;
+
+protected:
+    frame_ring(const frame_ring&) = delete;
+    frame_ring(frame_ring&&) = delete;
+
+    frame_ring& operator=(const frame_ring&) = delete;
+    frame_ring& operator=(frame_ring&&) = delete;
+
+private:
+    friend class frame_subscriber;
+
+    auto subscribe(frame_subscriber* subscriber) noexcept -> void;
+
+    auto unsubscribe(frame_subscriber* subscriber) noexcept -> void;
+
+    // Applies the subscriber's policy when frame 'seq' leaves it without room, lock is held
+    auto account(frame_subscriber& subscriber, uint64_t seq) noexcept -> void;
+
+private:
+    std::vector<frame> _slots;
+    size_t _mask;
+
+    // Sequence number of the next frame published
+    uint64_t _head = 0;
+
+    std::vector<frame_subscriber*> _subscribers;
+
+    mutable std::mutex _mut;
+    std::condition_variable _cond;
+};
+
+// Read cursor of one consumer, subscribed from construction until it's destroyed.
+// Sees the frames published after it subscribed. The ring must outlive it.
+class frame_subscriber final {
+
+public:
+    // Called by the producer with the ring locked after every frame it published, so a
+    // consumer that doesn't wait in pop() learns about it. It must not call into the ring.
+    using publish_callback = std::function<void()>;
+
+    explicit frame_subscriber(frame_ring& ring,
+                              const subscriber_config& config = {},
+                              publish_callback on_publish = {}) noexcept;
+    ~frame_subscriber();
+
+    // Returns false on timeout or once the subscriber is disconnected
+    [[nodiscard]] auto pop(frame& frame, std::chrono::milliseconds timeout) noexcept -> bool;
+
+    [[nodiscard]] auto is_disconnected() const noexcept -> bool;
+
+    [[nodiscard]] auto get_stats() const noexcept -> subscriber_stats;
+
+protected:
+    frame_subscriber(const frame_subscriber&) = delete;
+    frame_subscriber(frame_subscriber&&) = delete;
+
+    frame_subscriber& operator=(const frame_subscriber&) = delete;
+    frame_subscriber& operator=(frame_subscriber&&) = delete;
+
+private:
+    friend class frame_ring;
+
+    // Skips the frames dropped by drop_newest once the backlog is read, lock is held
+    [[nodiscard]] auto ready() noexcept -> bool;
+
+private:
+    frame_ring& _ring;
+
+    const size_t _depth;
+    const overflow_policy _policy;
+    const publish_callback _on_publish;
+
+    // Guarded by the lock of the ring
+    uint64_t _next = 0;
+    // Set by drop_newest, frames from it on are skipped
+    std::optional<uint64_t> _stop;
+    bool _disconnected = false;
+
+    size_t _delivered = 0;
+    size_t _dropped = 0;
+};
+
+} // namespace kaonic::comm::mesh
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <thread>
+
+#include "kaonic/comm/mesh/network_interface.hpp"
+#include "kaonic/common/mpmc_queue.hpp"
+
+namespace kaonic::comm::mesh {
+
+class network_receiver;
+
+// Frame given up when a listener's queue is full
+enum class drop_policy {
+    // Listener gets the most recent frames, stale ones are dropped
+    oldest,
+    // Listener gets its backlog in full, new frames are dropped
+    newest,
+};
+
+struct listener_config final {
+    size_t queue_size = 64;
+    drop_policy policy = drop_policy::oldest;
+};
+
+struct listener_stats final {
+    size_t delivered = 0;
+    size_t dropped = 0;
+    size_t queued = 0;
+};
+
+// Lock-free queue of pooled frames and the thread handing them to one listener, so a slow
+// listener only falls behind itself. Frames may be pushed from any number of threads.
+class listener_channel final {
+
+public:
+    explicit listener_channel(const std::shared_ptr<network_receiver>& listener,
+                              const listener_config& config) noexcept;
+    ~listener_channel();
+
+    // Never blocks, the frame shares the pushed buffer
+    auto push(const frame& frame) noexcept -> void;
+
+    [[nodiscard]] auto owns(const std::shared_ptr<network_receiver>& listener) const noexcept
+        -> bool;
+
+    [[nodiscard]] auto get_stats() const noexcept -> listener_stats;
+
+protected:
+    listener_channel(const listener_channel&) = delete;
+    listener_channel(listener_channel&&) = delete;
+
+    listener_channel& operator=(const listener_channel&) = delete;
+    listener_channel& operator=(listener_channel&&) = delete;
+
+private:
+    auto dispatch() noexcept -> void;
+
+    auto wait() noexcept -> void;
+
+    auto wake() noexcept -> void;
+
+private:
+    const std::weak_ptr<network_receiver> _listener;
+    const drop_policy _policy;
+
+    mpmc_queue<frame> _queue;
+
+    std::atomic<size_t> _delivered { 0 };
+    std::atomic<size_t> _dropped { 0 };
+
+    // Dispatch thread sleeps on the event only once it has found the queue empty
+    int _event_fd = -1;
+    std::atomic_bool _sleeping { false };
+
+    std::atomic_bool _running { true };
+    std::thread _thread;
+};
+
+} // namespace kaonic::comm::mesh
@@ -1,38 +1,77 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <stddef.h>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 extern "C" {
 #include "rfnet/rfnet.h"
 }
 
+#include "kaonic/comm/mesh/fragmentation.hpp"
+#include "kaonic/comm/mesh/frame_pool.hpp"
 #include "kaonic/comm/mesh/network_interface.hpp"
 #include "kaonic/comm/mesh/network_receiver.hpp"
+#include "kaonic/comm/mesh/router.hpp"
 #include "kaonic/comm/radio/radio.hpp"
 #include "kaonic/common/error.hpp"
+#include "kaonic/common/mpmc_queue.hpp"
 
 namespace kaonic::comm::mesh {
 
-constexpr static size_t peers_storage_size = 16;
-
 struct config final {
     uint16_t packet_pattern;
     uint64_t id_base = 0x00;
     std::chrono::milliseconds slot_duration;
     std::chrono::milliseconds gap_duration;
     std::chrono::milliseconds beacon_interval;
+
+    // Frames waiting for rfnet to free its TX slot
+    size_t tx_queue_size = 32;
+
+    // Entries of rfnet's peer storage, nodes heard beyond it aren't tracked by rfnet
+    size_t peer_capacity = 128;
+
+    routing_config routing;
+
+    fragmentation_config fragmentation;
 };
 
 struct context final {
     std::shared_ptr<network_interface> net_interface;
     std::shared_ptr<network_receiver> receiver;
+
+    // Called when a frame or a command is queued, so the update loop wakes up to handle it
+    std::function<void()> on_tx_queued;
+
+    // Buffers of copied frames waiting in the TX queue, the network makes its own if unset
+    std::shared_ptr<frame_pool> pool;
+};
+
+struct tx_result final {
+    error err;
+
+    // Time spent in the TX queue before rfnet took the frame
+    std::chrono::microseconds queue_time { 0 };
+    // Time from rfnet taking the frame until its TX slot was free again
+    std::chrono::microseconds send_time { 0 };
+
+    [[nodiscard]] auto latency() const noexcept -> std::chrono::microseconds {
+        return queue_time + send_time;
+    }
 };
 
+using tx_callback = std::function<void(const tx_result& result)>;
+
 struct stats final {
     size_t tx_speed;
     size_t rx_speed;
@@ -41,21 +80,92 @@ struct stats final {
     size_t tx_counter;
 };
 
+// rfnet, routing and reassembly state is owned by the thread calling update(). Other threads
+// queue frames and commands through lock-free rings and never wait for an update to finish.
 class network final {
 
 public:
+    // Time base of rfnet, all its slot, gap and beacon deadlines fall on its milliseconds
+    using clock = std::chrono::high_resolution_clock;
+
     explicit network(const config& config, const context& context) noexcept;
     ~network();
 
-    auto update() noexcept -> void;
+    // Runs queued commands and updates rfnet. The calling thread owns the network from its
+    // first update until release().
+    // Returns true when a frame was received, the radio may have more of them waiting.
+    auto update() noexcept -> bool;
+
+    // Earliest time the next update has something to do. Every tick of rfnet's clock while a
+    // frame is queued or in flight, otherwise the next beacon, route advertisement or route
+    // expiry. Called by the update thread after update().
+    [[nodiscard]] auto next_deadline() const noexcept -> clock::time_point;
+
+    // Update thread gives up the network once its loop is done, commands are run by the
+    // threads waiting for them from then on
+    auto release() noexcept -> void;
+
+    // Queues the task for the update thread, the future is ready once it ran between two
+    // updates. Waiting on it needs an update loop, execute() doesn't.
+    template <class F>
+    [[nodiscard]] auto post(F&& task) const -> std::future<std::invoke_result_t<F>>;
 
-    [[nodiscard]] auto transmit(const frame& frame) noexcept -> error;
+    // Runs the task on the thread that owns the network and waits for its result.
+    // Runs it on the calling thread when no update loop owns the network.
+    template <class F>
+    auto execute(F&& task) const -> std::invoke_result_t<F>;
+
+    // Queues the frame and waits until it's sent, payload is borrowed for the call
+    [[nodiscard]] auto transmit(const frame_view& frame) noexcept -> error;
+
+    [[nodiscard]] auto transmit(const frame_view& frame, tx_result& result) noexcept -> error;
+
+    // Queues a copy of the frame, callback is invoked from the update thread once it's sent.
+    // A fragmented frame needs room for all of its fragments in the queue.
+    [[nodiscard]] auto transmit_async(const frame_view& frame, tx_callback callback) noexcept
+        -> error;
+
+    // Completes every queued frame with an error, e.g. when updates are stopped
+    auto abort_transmits() noexcept -> void;
 
     [[nodiscard]] auto get_stats() noexcept -> stats;
 
+    [[nodiscard]] auto node_id() const noexcept -> uint64_t { return _node_id; }
+
+    [[nodiscard]] auto get_routes() const -> std::vector<route>;
+
+    [[nodiscard]] auto get_routing_stats() const noexcept -> routing_stats;
+
+    [[nodiscard]] auto get_fragmentation_stats() const noexcept -> fragmentation_stats;
+
 private:
+    using tx_clock = std::chrono::steady_clock;
+
+    using command = std::function<void()>;
+
+    enum class tx_payload {
+        // Blocking senders lend their buffer
+        borrowed,
+        copied,
+        // Copied, routing header is already in it (relayed frames, advertisements)
+        routed,
+    };
+
+    struct tx_request final {
+        frame_buffer storage;
+        frame_view frame;
+        bool routed = false;
+        // Set for fragments, the frame is the slice of the payload the fragment carries
+        std::optional<fragment_header> fragment;
+        tx_callback callback;
+        tx_clock::time_point queued_at;
+        tx_clock::time_point sent_at;
+    };
+
     [[nodiscard]] static auto generate_id() noexcept -> uint64_t;
 
+    [[nodiscard]] static auto make_node_id(const config& config) noexcept -> uint64_t;
+
     [[nodiscard]] static auto tx(void* ctx, void* data, size_t len) noexcept -> int;
 
     [[nodiscard]] static auto rx(void* ctx, void* data, size_t max_len) noexcept -> int;
@@ -68,6 +178,54 @@ private:
 
     static auto on_receive(void* ctx, const void* data, size_t len) noexcept -> void;
 
+    auto push_command(command&& task) const noexcept -> void;
+
+    // Runs the queued commands if the calling thread owns the network or no thread does.
+    // Returns false while the update loop of another thread owns it.
+    auto try_run_commands() const noexcept -> bool;
+
+    auto run_commands() const noexcept -> void;
+
+    [[nodiscard]] auto enqueue(const frame_view& frame,
+                               tx_callback callback,
+                               tx_payload payload) noexcept -> error;
+
+    // Queues the fragments of the frame, callback is invoked once all of them are sent
+    [[nodiscard]] auto enqueue_fragments(const frame_view& frame,
+                                         tx_callback callback,
+                                         tx_payload payload) noexcept -> error;
+
+    // Waits for room in the queue or checks there is room for 'count' frames.
+    // Returns false once transmits are stopped.
+    [[nodiscard]] auto wait_tx_queue(bool block, size_t count) noexcept -> bool;
+
+    [[nodiscard]] auto make_request(const frame_view& frame,
+                                    const std::optional<fragment_header>& fragment,
+                                    tx_callback callback,
+                                    tx_payload payload,
+                                    tx_request& request) noexcept -> error;
+
+    [[nodiscard]] auto push_request(tx_request& request, bool block) noexcept -> error;
+
+    // Hands the next queued frame to rfnet and completes the one it has sent
+    auto update_tx() noexcept -> void;
+
+    // Wakes senders blocked on a full queue, if there are any
+    auto notify_tx_waiters() noexcept -> void;
+
+    [[nodiscard]] auto send(const tx_request& request) noexcept -> error;
+
+    // Expires routes and stalled reassemblies and queues a route advertisement
+    // when it's due
+    auto update_routing() noexcept -> void;
+
+    auto receive_routed(const frame_view& frame) noexcept -> void;
+
+    // Hands a frame for this node to the receiver once all of its fragments are in
+    auto deliver(const frame_view& frame) noexcept -> void;
+
+    static auto complete(tx_request& request, const error& err) noexcept -> void;
+
 protected:
     network(const network&) = default;
     network(network&&) = default;
@@ -79,13 +237,90 @@ private:
     config _config;
     context _context;
 
-    rfnet_peer peers[peers_storage_size];
+    // Sized once from the config, rfnet keeps a pointer to it
+    std::vector<rfnet_peer> _rfnet_peers;
+
+    router::clock::time_point _expired_at;
+
+    const uint64_t _node_id;
+    router _router;
+
+    // Fragmenter is shared by the senders, reassembler is used from the update thread
+    fragmenter _fragmenter;
+    reassembler _reassembler;
+
+    // Headers and payload of an originated frame, relayed frames and advertisements
+    std::vector<uint8_t> _tx_buffer;
+    std::vector<uint8_t> _route_buffer;
 
     rfnet _rfnet;
 
-    frame net_frame {};
+    // Metadata of the last frame handed to rfnet, reported with the payload it decodes
+    frame_info _rx_info;
+    bool _rx_received = false;
 
-    mutable std::mutex _mut;
+    // Room for tx_queue_size frames or all fragments of the largest payload. Filled by the
+    // senders and the update thread, drained by the update thread.
+    mpmc_queue<tx_request> _tx_queue;
+    // Frame handed to rfnet and not yet reported back to its sender
+    std::optional<tx_request> _tx_inflight;
+
+    // First frame rfnet sent on its own once the previous beacon was due, i.e. the last beacon
+    std::optional<clock::time_point> _beacon_at;
+
+    // Set once transmits are aborted, cleared by the next update
+    std::atomic_bool _tx_stopped { false };
+
+    // Senders of fragmented frames take the fragmenter and the queue in turn.
+    // Never taken by the update thread.
+    mutable std::mutex _fragment_mut;
+
+    // Senders blocked on a full queue, the update thread only locks it to wake them
+    std::atomic<size_t> _tx_waiters { 0 };
+    std::mutex _tx_mut;
+    std::condition_variable _tx_cond;
+
+    // Queries, reconfiguration and aborts for the update thread
+    mutable mpmc_queue<command> _commands;
+    mutable std::atomic<std::thread::id> _owner {};
 };
 
+template <class F>
+auto network::post(F&& task) const -> std::future<std::invoke_result_t<F>> {
+    using result = std::invoke_result_t<F>;
+
+    auto promise = std::make_shared<std::promise<result>>();
+    auto future = promise->get_future();
+
+    push_command([promise, task = std::forward<F>(task)]() mutable {
+        if constexpr (std::is_void_v<result>) {
+            task();
+            promise->set_value();
+        } else {
+            promise->set_value(task());
+        }
+    });
+
+    return future;
+}
+
+template <class F>
+auto network::execute(F&& task) const -> std::invoke_result_t<F> {
+    // Update thread runs its own tasks right away, they'd wait for it otherwise
+    if (_owner.load() == std::this_thread::get_id()) {
+        return task();
+    }
+
+    auto future = post(std::forward<F>(task));
+
+    while (future.wait_for(std::chrono::seconds { 0 }) != std::future_status::ready) {
+        // Loop may have stopped after the task was queued, it's looked at again shortly
+        if (!try_run_commands()) {
+            future.wait_for(std::chrono::milliseconds { 10 });
+        }
+    }
+
+    return future.get();
+}
+
 } // namespace kaonic::comm::mesh
@@ -1,15 +1,55 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <stddef.h>
 #include <vector>
 
+#include "kaonic/comm/mesh/frame_pool.hpp"
 #include "kaonic/common/error.hpp"
+#include "kaonic/common/span.hpp"
 
 namespace kaonic::comm::mesh {
 
+// Destination of frames addressed to every node in range
+constexpr uint64_t broadcast_id = UINT64_MAX;
+
+// Link metadata of a received frame, default for frames that didn't come from a radio
+struct frame_info final {
+    // Received signal strength and detected energy, dBm (127 when not available)
+    int8_t rssi = 127;
+    int8_t edv = 127;
+    // IRQ time of the frame on the monotonic (steady_clock) timeline
+    std::chrono::nanoseconds timestamp { 0 };
+    // Radio module the frame was received on
+    uint8_t module = 0;
+    // Originating and final node of a routed frame, source is 0 when unknown
+    uint64_t source = 0;
+    uint64_t destination = broadcast_id;
+    // Sequence number of a routed frame at its source
+    uint32_t seq = 0;
+};
+
+// Frame kept past the call it was received in, the buffer comes from a frame_pool
 struct frame final {
-    std::vector<uint8_t> buffer;
+    frame_buffer buffer;
+    frame_info info;
+};
+
+// Borrowed frame payload, valid only for the duration of the call it's passed to
+struct frame_view final {
+    span<const uint8_t> buffer;
+    frame_info info;
+
+    constexpr frame_view() noexcept = default;
+
+    constexpr frame_view(span<const uint8_t> buffer, const frame_info& info = {}) noexcept
+        : buffer { buffer }
+        , info { info } {}
+
+    frame_view(const frame& frame) noexcept
+        : buffer { frame.buffer }
+        , info { frame.info } {}
 };
 
 class network_interface {
@@ -17,9 +57,11 @@ class network_interface {
 public:
     virtual ~network_interface() = default;
 
-    [[nodiscard]] virtual auto transmit(const frame& frame) -> error = 0;
+    [[nodiscard]] virtual auto transmit(span<const uint8_t> data) -> error = 0;
 
-    [[nodiscard]] virtual auto receive(frame& frame) -> error = 0;
+    // Receives straight into the caller's buffer, len is set to the frame size
+    [[nodiscard]] virtual auto receive(span<uint8_t> buffer, size_t& len, frame_info& info)
+        -> error = 0;
 
 protected:
     explicit network_interface() = default;
@@ -1,7 +1,12 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
+#include <vector>
 
+#include "kaonic/comm/mesh/dedup_cache.hpp"
+#include "kaonic/comm/mesh/frame_pool.hpp"
+#include "kaonic/comm/mesh/listener_channel.hpp"
 #include "kaonic/comm/mesh/network_interface.hpp"
 
 namespace kaonic::comm::mesh {
@@ -11,7 +16,10 @@ class network_receiver {
 public:
     virtual ~network_receiver() = default;
 
-    virtual auto on_receive(const frame& frame) -> void = 0;
+    virtual auto on_receive(const frame_view& frame) -> void = 0;
+
+    // Frame in a pooled buffer, listeners that keep frames take a reference instead of a copy
+    virtual auto on_receive_pooled(const frame& frame) -> void { on_receive(frame_view { frame }); }
 
 protected:
     explicit network_receiver() = default;
@@ -23,24 +31,52 @@ protected:
     network_receiver& operator=(network_receiver&&) = default;
 };
 
+// Hands every frame to all listeners once, copies heard again within the dedup window
+// (relayed over several paths or received by several radios) are dropped.
+// Frames are copied once into a pooled buffer shared by the listeners, each listener is called
+// from a dispatch thread of its own and never from the mesh update thread.
 class network_broadcast_receiver final : public network_receiver {
 
 public:
-    explicit network_broadcast_receiver() noexcept = default;
-    ~network_broadcast_receiver() final = default;
+    explicit network_broadcast_receiver(const dedup_config& dedup = {},
+                                        const std::shared_ptr<frame_pool>& pool = {}) noexcept;
+
+    // Duplicates are looked for across every broadcaster sharing the filter
+    explicit network_broadcast_receiver(const std::shared_ptr<dedup_filter>& dedup,
+                                        const std::shared_ptr<frame_pool>& pool = {}) noexcept;
+    ~network_broadcast_receiver() final;
+
+    // A listener that is already attached keeps its channel
+    auto attach_listener(const std::shared_ptr<network_receiver>& listener,
+                         const listener_config& config = {}) noexcept -> void;
+
+    auto on_receive(const frame_view& frame) -> void final;
+
+    auto on_receive_pooled(const frame& frame) -> void final;
 
-    network_broadcast_receiver(const network_broadcast_receiver&) = default;
-    network_broadcast_receiver(network_broadcast_receiver&&) = default;
+    [[nodiscard]] auto get_dedup_stats() const noexcept -> dedup_stats;
 
-    auto attach_listener(const std::shared_ptr<network_receiver>& listener) noexcept -> void;
+    // In the order listeners were attached
+    [[nodiscard]] auto get_listener_stats() const -> std::vector<listener_stats>;
 
-    auto on_receive(const frame& frame) -> void final;
+protected:
+    network_broadcast_receiver(const network_broadcast_receiver&) = delete;
+    network_broadcast_receiver(network_broadcast_receiver&&) = delete;
+
+    network_broadcast_receiver& operator=(const network_broadcast_receiver&) = delete;
+    network_broadcast_receiver& operator=(network_broadcast_receiver&&) = delete;
 
-    network_broadcast_receiver& operator=(const network_broadcast_receiver&) = default;
-    network_broadcast_receiver& operator=(network_broadcast_receiver&&) = default;
+private:
+    auto dispatch(const frame& frame) -> void;
 
 private:
-    std::vector<std::weak_ptr<network_receiver>> _listeners;
+    std::shared_ptr<frame_pool> _pool;
+    std::shared_ptr<dedup_filter> _dedup;
+
+    std::vector<std::unique_ptr<listener_channel>> _listeners;
+
+    // Listeners may be attached while frames are received
+    mutable std::mutex _mut;
 };
 
 } // namespace kaonic::comm::mesh
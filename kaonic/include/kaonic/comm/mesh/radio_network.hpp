@@ -8,6 +8,7 @@
 #include "kaonic/comm/mesh/network.hpp"
 #include "kaonic/comm/mesh/network_interface.hpp"
 #include "kaonic/comm/mesh/network_receiver.hpp"
+#include "kaonic/comm/mesh/update_scheduler.hpp"
 #include "kaonic/comm/radio/radio.hpp"
 
 namespace kaonic::comm::mesh {
@@ -18,9 +19,10 @@ public:
     explicit radio_network_interface(const std::shared_ptr<radio>& radio) noexcept;
     ~radio_network_interface() final = default;
 
-    [[nodiscard]] auto transmit(const frame& frame) -> error final;
+    [[nodiscard]] auto transmit(span<const uint8_t> data) -> error final;
 
-    [[nodiscard]] auto receive(frame& frame) -> error final;
+    [[nodiscard]] auto receive(span<uint8_t> buffer, size_t& len, frame_info& info)
+        -> error final;
 
 protected:
     radio_network_interface(const radio_network_interface&) = delete;
@@ -31,17 +33,16 @@ protected:
 
 private:
     const std::shared_ptr<radio> _radio;
-
-    radio_frame _tx_frame;
-    radio_frame _rx_frame;
 };
 
 class radio_network final {
 
 public:
+    // Network makes a pool of its own when none is shared with it
     explicit radio_network(const config& config,
                            const std::shared_ptr<radio>& radio,
-                           const std::shared_ptr<network_receiver>& receiver) noexcept;
+                           const std::shared_ptr<network_receiver>& receiver,
+                           const std::shared_ptr<frame_pool>& pool = {}) noexcept;
 
     radio_network(const radio_network&) = delete;
     radio_network(radio_network&&) = delete;
@@ -54,7 +55,19 @@ public:
 
     [[nodiscard]] auto configure(const radio_config& config) -> error;
 
-    [[nodiscard]] auto transmit(const frame& frame) -> error;
+    [[nodiscard]] auto transmit(const frame_view& frame) -> error;
+
+    [[nodiscard]] auto transmit(const frame_view& frame, tx_result& result) -> error;
+
+    [[nodiscard]] auto transmit_async(const frame_view& frame, tx_callback callback) -> error;
+
+    [[nodiscard]] auto get_stats() -> stats;
+
+    [[nodiscard]] auto node_id() const noexcept -> uint64_t;
+
+    [[nodiscard]] auto get_routes() const -> std::vector<route>;
+
+    [[nodiscard]] auto get_fragmentation_stats() const noexcept -> fragmentation_stats;
 
     radio_network& operator=(const radio_network&) = delete;
     radio_network& operator=(radio_network&&) = delete;
@@ -67,6 +80,9 @@ private:
     std::shared_ptr<network_interface> _network_interface;
     std::shared_ptr<network_receiver> _network_receiver;
 
+    // Constructed before the mesh, which notifies it about queued frames
+    update_scheduler _scheduler;
+
     network _network_mesh;
 
     std::thread _update_thread;
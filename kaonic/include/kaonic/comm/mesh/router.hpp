@@ -0,0 +1,141 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <stddef.h>
+#include <unordered_map>
+#include <vector>
+
+#include "kaonic/comm/mesh/network_interface.hpp"
+#include "kaonic/common/error.hpp"
+#include "kaonic/common/span.hpp"
+
+namespace kaonic::comm::mesh {
+
+struct routing_config final {
+    // Frames carry a routing header and are relayed towards their destination.
+    // Nodes without it see the header as part of the payload.
+    bool enabled = false;
+
+    // Route advertisements broadcast to neighbours, each one comes up to a quarter of the
+    // interval early so nodes started together don't keep advertising at the same time
+    std::chrono::milliseconds hello_interval { 1000 };
+
+    // Routes not refreshed by an advertisement for this long are dropped
+    std::chrono::milliseconds route_timeout { 5000 };
+
+    uint8_t max_hops = 8;
+    size_t max_routes = 256;
+};
+
+struct route final {
+    uint64_t destination = 0;
+    uint64_t next_hop = 0;
+    uint8_t hops = 0;
+
+    // Sum of the link costs along the route, lower is better
+    uint16_t metric = 0;
+
+    std::chrono::steady_clock::time_point updated;
+};
+
+struct routing_stats final {
+    size_t originated = 0;
+    size_t delivered = 0;
+    size_t forwarded = 0;
+
+    // Frames relayed through another node, or dropped for lack of a route or hops
+    size_t overheard = 0;
+    size_t no_route = 0;
+    size_t ttl_expired = 0;
+
+    size_t hellos_sent = 0;
+    size_t hellos_received = 0;
+};
+
+enum class route_action {
+    // Payload is for this node
+    deliver,
+    // Frame has to be sent on to its next hop
+    forward,
+    // Route advertisement of a neighbour, info.source is the neighbour
+    hello,
+    drop,
+};
+
+// Distance-vector routing over the single-hop mesh. Every node periodically broadcasts the
+// routes it knows, link costs come from the RSSI of those advertisements. Data frames name
+// their next hop, so only that neighbour relays them.
+class router final {
+
+public:
+    using clock = std::chrono::steady_clock;
+
+    // Header in front of the payload of every routed frame
+    constexpr static size_t header_size = 32;
+
+    explicit router(const routing_config& config, uint64_t node_id) noexcept;
+    ~router() = default;
+
+    router(const router&) = default;
+    router(router&&) = default;
+
+    [[nodiscard]] auto node_id() const noexcept -> uint64_t { return _node_id; }
+
+    // Writes the header of a frame sent from this node, not_ready when there is no route
+    [[nodiscard]] auto encode(uint64_t destination, span<uint8_t> header) noexcept -> error;
+
+    // Parses a received frame. For delivered frames 'payload' and the addresses in 'info'
+    // are set, frames to forward are copied to 'forward' with the header updated.
+    [[nodiscard]] auto receive(span<const uint8_t> frame,
+                               frame_info& info,
+                               span<const uint8_t>& payload,
+                               std::vector<uint8_t>& forward,
+                               clock::time_point now) noexcept -> route_action;
+
+    // Writes a route advertisement to 'hello' when one is due
+    [[nodiscard]] auto make_hello(clock::time_point now, std::vector<uint8_t>& hello) noexcept
+        -> bool;
+
+    // Time the next route advertisement is due
+    [[nodiscard]] auto next_hello() const noexcept -> clock::time_point { return _next_hello; }
+
+    // Drops routes older than route_timeout, returns how many were dropped
+    auto expire(clock::time_point now) noexcept -> size_t;
+
+    [[nodiscard]] auto find(uint64_t destination) const noexcept -> const route*;
+
+    [[nodiscard]] auto routes() const -> std::vector<route>;
+
+    [[nodiscard]] auto get_stats() const noexcept -> routing_stats { return _stats; }
+
+    router& operator=(const router&) = default;
+    router& operator=(router&&) = default;
+
+private:
+    auto learn(uint64_t neighbour,
+               const frame_info& info,
+               span<const uint8_t> hello,
+               clock::time_point now) noexcept -> void;
+
+    auto consider(const route& candidate) noexcept -> void;
+
+    [[nodiscard]] auto is_expired(const route& route, clock::time_point now) const noexcept
+        -> bool;
+
+private:
+    routing_config _config;
+    uint64_t _node_id;
+
+    std::unordered_map<uint64_t, route> _routes;
+
+    uint32_t _seq = 0;
+    clock::time_point _next_hello;
+
+    std::mt19937_64 _jitter;
+
+    routing_stats _stats;
+};
+
+} // namespace kaonic::comm::mesh
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+
+#include "kaonic/comm/mesh/network.hpp"
+
+namespace kaonic::comm::mesh {
+
+enum class update_wakeup {
+    tick,
+    rx,
+    notify,
+};
+
+// Puts the mesh update loop to sleep on a timerfd until the network's next deadline, a receive
+// event of the radio or an explicit notification (queued frame, stop request)
+class update_scheduler final {
+
+public:
+    explicit update_scheduler(std::chrono::microseconds tick) noexcept;
+    ~update_scheduler();
+
+    // Safe to call from any thread
+    auto notify() noexcept -> void;
+
+    // Waits for the first tick at or past the deadline or another wakeup, a deadline already
+    // passed is the next tick. rx_event_fd is only polled and may be -1.
+    auto wait(network::clock::time_point deadline, int rx_event_fd) noexcept -> update_wakeup;
+
+protected:
+    update_scheduler(const update_scheduler&) = delete;
+    update_scheduler(update_scheduler&&) = delete;
+
+    update_scheduler& operator=(const update_scheduler&) = delete;
+    update_scheduler& operator=(update_scheduler&&) = delete;
+
+private:
+    // Time left until the first multiple of the tick on rfnet's clock at or past the deadline
+    [[nodiscard]] auto next_tick(network::clock::time_point deadline) const noexcept
+        -> std::chrono::nanoseconds;
+
+private:
+    const std::chrono::nanoseconds _tick;
+
+    int _timer_fd = -1;
+    int _notify_fd = -1;
+};
+
+} // namespace kaonic::comm::mesh
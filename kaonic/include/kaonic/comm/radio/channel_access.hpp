@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <random>
+
+namespace kaonic::comm {
+
+struct channel_access_config final {
+    // Energy above this level makes CCA report a busy channel, dBm. Default is the chip's reset
+    // value of AMEDT.
+    int8_t cca_threshold = -75;
+
+    // CCA attempts per frame before it's dropped
+    size_t max_attempts = 5;
+
+    // Backoff exponent range, the n-th retry waits a random number of
+    // [0, 2^min(min_be + n - 1, max_be) - 1] backoff periods
+    uint8_t min_be = 3;
+    uint8_t max_be = 5;
+
+    std::chrono::microseconds backoff_period { 320 };
+
+    // Frame is dropped when it can't go out within this time (0 - no deadline)
+    std::chrono::milliseconds deadline { 0 };
+
+    // Seed for the backoff generator (0 - random seed)
+    uint64_t seed = 0;
+};
+
+struct channel_access_stats final {
+    // CCA attempts and how many of them found the channel busy
+    size_t attempts = 0;
+    size_t busy = 0;
+
+    // Frames sent, dropped after max attempts and dropped at the deadline
+    size_t success = 0;
+    size_t failed = 0;
+    size_t expired = 0;
+
+    std::chrono::microseconds backoff_time { 0 };
+};
+
+// Decides how long a transmitter backs off after CCA found the channel busy
+class channel_access_policy {
+
+public:
+    virtual ~channel_access_policy() = default;
+
+    // Delay before the next attempt after 'attempt' busy CCAs, nullopt drops the frame
+    [[nodiscard]] virtual auto backoff(size_t attempt) noexcept
+        -> std::optional<std::chrono::microseconds> = 0;
+
+protected:
+    explicit channel_access_policy() = default;
+
+    channel_access_policy(const channel_access_policy&) = default;
+    channel_access_policy(channel_access_policy&&) = default;
+
+    channel_access_policy& operator=(const channel_access_policy&) = default;
+    channel_access_policy& operator=(channel_access_policy&&) = default;
+};
+
+// Randomized binary exponential backoff (IEEE 802.15.4 unslotted CSMA-CA)
+class csma_backoff_policy final : public channel_access_policy {
+
+public:
+    explicit csma_backoff_policy(const channel_access_config& config) noexcept;
+    ~csma_backoff_policy() final = default;
+
+    [[nodiscard]] auto backoff(size_t attempt) noexcept
+        -> std::optional<std::chrono::microseconds> final;
+
+protected:
+    csma_backoff_policy(const csma_backoff_policy&) = delete;
+    csma_backoff_policy(csma_backoff_policy&&) = delete;
+
+    csma_backoff_policy& operator=(const csma_backoff_policy&) = delete;
+    csma_backoff_policy& operator=(csma_backoff_policy&&) = delete;
+
+private:
+    const channel_access_config _config;
+
+    std::mt19937 _generator;
+};
+
+} // namespace kaonic::comm
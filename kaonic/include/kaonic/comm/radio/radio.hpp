@@ -5,14 +5,30 @@
 #include <variant>
 
 #include "kaonic/comm/mesh/network_interface.hpp"
+#include "kaonic/comm/radio/channel_access.hpp"
 #include "kaonic/common/error.hpp"
+#include "kaonic/common/span.hpp"
 
 constexpr auto data_max_size = 2048u;
 
 namespace kaonic::comm {
 
+// RSSI and EDV registers read 127 when there is no valid measurement
+constexpr int8_t radio_rssi_invalid = 127;
+
+// Link metadata captured with every received frame
+struct radio_rx_info final {
+    // Received signal strength, dBm
+    int8_t rssi = radio_rssi_invalid;
+    // Energy detected during the frame, dBm
+    int8_t edv = radio_rssi_invalid;
+    // IRQ time of the frame on the monotonic (steady_clock) timeline
+    std::chrono::nanoseconds timestamp { 0 };
+};
+
 struct radio_frame final {
     uint16_t len;
+    radio_rx_info info;
     uint8_t data[data_max_size];
 };
 
@@ -113,9 +129,21 @@ public:
 
     virtual auto configure(const radio_config& config) -> error = 0;
 
-    virtual auto transmit(const radio_frame& frame) -> error = 0;
+    // Payload is borrowed for the duration of the call
+    virtual auto transmit(span<const uint8_t> data) -> error = 0;
+
+    // Frame is written straight into the caller's buffer, len is set to its size
+    virtual auto receive(span<uint8_t> buffer,
+                         size_t& len,
+                         radio_rx_info& info,
+                         const std::chrono::milliseconds& timeout) -> error = 0;
+
+    // Readable while a received frame may be waiting, -1 when the radio has no such event.
+    // Callers only poll it, receive() clears it.
+    [[nodiscard]] virtual auto rx_event_fd() const noexcept -> int { return -1; }
 
-    virtual auto receive(radio_frame& frame, const std::chrono::milliseconds& timeout) -> error = 0;
+    // Counters of the clear channel assessment before transmits, zero for radios without it
+    [[nodiscard]] virtual auto get_channel_access_stats() -> channel_access_stats { return {}; }
 
 protected:
     explicit radio() = default;
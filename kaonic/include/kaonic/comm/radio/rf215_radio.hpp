@@ -1,12 +1,19 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <bitset>
 #include <memory>
 #include <mutex>
+#include <thread>
 
 #include "kaonic/comm/drivers/gpio.hpp"
+#include "kaonic/comm/drivers/irq_line.hpp"
 #include "kaonic/comm/drivers/spi.hpp"
 #include "kaonic/comm/mesh/network_interface.hpp"
+#include "kaonic/comm/radio/channel_access.hpp"
 #include "kaonic/comm/radio/radio.hpp"
+#include "kaonic/common/spsc_queue.hpp"
 
 #include <gpiod.hpp>
 
@@ -27,22 +34,100 @@ struct rf215_radio_config {
     drivers::gpio_spec flt_sel_v1_gpio;
     drivers::gpio_spec flt_sel_v2_gpio;
     drivers::gpio_spec flt_sel_24_gpio;
+
+    channel_access_config channel_access;
+};
+
+// Last value written to every RF215 register, so writes which don't change it can be skipped
+struct rf215_register_shadow final {
+    // Common, RF09, RF24, BBC0 and BBC1 register blocks (frame buffers are not cached)
+    constexpr static size_t size = 0x0500;
+
+    std::array<uint8_t, size> values {};
+    std::bitset<size> valid;
+    // Command and trigger registers which are written every time
+    std::bitset<size> uncached;
+    // Chip reset and transceiver command registers, writing RESET to them puts registers back
+    // to their defaults so nothing cached is valid anymore
+    std::bitset<size> resets;
+
+    size_t writes = 0;
+    size_t skipped = 0;
+
+    [[nodiscard]] auto is_cached(rf215_reg_t addr, const uint8_t* data, size_t len) const noexcept
+        -> bool;
+
+    auto update(rf215_reg_t addr, const uint8_t* data, size_t len) noexcept -> void;
+
+    auto invalidate(rf215_reg_t addr, size_t len) noexcept -> void;
+
+    auto invalidate() noexcept -> void;
+};
+
+// Per-transceiver state, RF09 (sub-GHz) and RF24 (2.4GHz) run independently on one chip
+struct rf215_trx_state final {
+    rf215_trx* trx = nullptr;
+
+    // Last configuration applied to the transceiver, receiver is serviced only when set
+    radio_config applied_config;
+    std::atomic_bool applied { false };
+
+    size_t tx_counter = 0;
+    size_t rx_counter = 0;
+    size_t rx_dropped = 0;
+
+    std::unique_ptr<channel_access_policy> access_policy;
+    channel_access_stats access_stats;
+
+    // Frames drained by the IRQ thread, consumed by receive()
+    spsc_queue<radio_frame, 16> rx_queue;
+    radio_frame rx_overflow_frame;
+    int rx_event_fd = -1;
 };
 
+// IRQ status bytes read from the chip but not yet handed to the transceiver they belong to
+struct rf215_irq_state final {
+    std::array<uint8_t, sizeof(rf215_irq_data_t)> pending {};
+
+    // Edge time of the last IRQ of each transceiver (RF09, RF24)
+    std::array<std::chrono::nanoseconds, 2> timestamp {};
+
+    // Transceiver the rf215 library is currently waiting for
+    rf215_trx_type owner = RF215_TRX_TYPE_RF09;
+};
+
+class rf215_trx_radio;
+
 class rf215_radio final : public radio {
 
+    friend class rf215_trx_radio;
+
 public:
     explicit rf215_radio(const rf215_radio_config& config) noexcept;
-    ~rf215_radio() = default;
+    ~rf215_radio();
 
     [[nodiscard]] auto init() -> error;
 
     [[nodiscard]] auto configure(const radio_config& config) -> error final;
 
-    [[nodiscard]] auto transmit(const radio_frame& frame) -> error final;
+    [[nodiscard]] auto transmit(span<const uint8_t> data) -> error final;
+
+    [[nodiscard]] auto receive(span<uint8_t> buffer,
+                               size_t& len,
+                               radio_rx_info& info,
+                               const std::chrono::milliseconds& timeout) -> error final;
+
+    [[nodiscard]] auto rx_event_fd() const noexcept -> int final;
+
+    // Replaces the default CSMA backoff of the transceiver
+    [[nodiscard]] auto set_channel_access_policy(rf215_trx_type type,
+                                                 std::unique_ptr<channel_access_policy> policy)
+        -> error;
 
-    [[nodiscard]] auto receive(radio_frame& frame, const std::chrono::milliseconds& timeout)
-        -> error final;
+    [[nodiscard]] auto get_channel_access_stats(rf215_trx_type type) -> channel_access_stats;
+
+    // Counters of the active transceiver
+    [[nodiscard]] auto get_channel_access_stats() -> channel_access_stats final;
 
 private:
     [[nodiscard]] static auto
@@ -60,8 +145,58 @@ private:
 
     static auto sleep(const void* ctx, rf215_millis_t delay) noexcept -> void;
 
+    [[nodiscard]] auto trx_state(rf215_trx_type type) noexcept -> rf215_trx_state&;
+
+    [[nodiscard]] auto configure_trx(rf215_trx_type type, const radio_config& config) -> error;
+
+    [[nodiscard]] auto transmit_trx(rf215_trx_type type, span<const uint8_t> data) -> error;
+
+    [[nodiscard]] auto receive_trx(rf215_trx_type type,
+                                   span<uint8_t> buffer,
+                                   size_t& len,
+                                   radio_rx_info& info,
+                                   const std::chrono::milliseconds& timeout) -> error;
+
+    [[nodiscard]] auto trx_rx_event_fd(rf215_trx_type type) const noexcept -> int;
+
+    [[nodiscard]] auto configure_locked(rf215_trx_state& state, const radio_config& config)
+        -> error;
+
+    // Runs CCA and backoff, the device lock is only held for each attempt
+    [[nodiscard]] auto transmit_frame(rf215_trx_state& state, span<const uint8_t> data) -> error;
+
+    [[nodiscard]] auto receive_from(rf215_trx_state& state,
+                                    span<uint8_t> buffer,
+                                    size_t& len,
+                                    radio_rx_info& info,
+                                    const std::chrono::milliseconds& timeout) -> error;
+
+    auto mask_irqs(rf215_trx* trx) noexcept -> void;
+
     auto select_filter(const radio_config& config) noexcept -> void;
 
+    // Reads the IRQ status of both transceivers into the pending set
+    [[nodiscard]] auto read_irq_status() const noexcept -> bool;
+
+    [[nodiscard]] auto take_irq_status(rf215_trx_type type, rf215_irq_data_t* irq) const noexcept
+        -> bool;
+
+    auto irq_loop() noexcept -> void;
+
+    auto service_rx(rf215_trx_state& state) noexcept -> void;
+
+    // Link quality of the frame just received by the transceiver
+    auto read_rx_info(const rf215_trx_state& state, radio_rx_info& info) noexcept -> void;
+
+    // Register writes are queued until commit and submitted with as few ioctls as possible
+    auto begin_write_batch() noexcept -> void;
+
+    [[nodiscard]] auto commit_write_batch() noexcept -> error;
+
+    [[nodiscard]] auto flush_write_batch() const noexcept -> error;
+
+    auto stop_irq_thread() noexcept -> void;
+
 protected:
     rf215_radio(const rf215_radio&) = delete;
     rf215_radio(rf215_radio&&) = delete;
@@ -73,21 +208,66 @@ private:
     rf215_radio_config _config;
 
     std::unique_ptr<drivers::spi> _spi;
+    std::unique_ptr<drivers::spi_batch> _spi_batch;
+    bool _spi_batching = false;
+
+    std::unique_ptr<rf215_register_shadow> _shadow;
     std::unique_ptr<gpiod::line_request> _rst_gpio_req;
     std::unique_ptr<gpiod::line_request> _irq_gpio_req;
     std::unique_ptr<gpiod::line_request> _flt_sel_v1_gpio_req;
     std::unique_ptr<gpiod::line_request> _flt_sel_v2_gpio_req;
     std::unique_ptr<gpiod::line_request> _flt_sel_24_gpio_req;
 
-    std::unique_ptr<gpiod::edge_event_buffer> _irq_buffer;
+    std::unique_ptr<drivers::irq_line> _irq_line;
 
     rf215_device _dev;
-    rf215_trx* _active_trx = nullptr;
+    // Transceiver selected by frequency when the chip is used as a single radio, read without
+    // the lock by receive() and rx_event_fd()
+    std::atomic<rf215_trx*> _active_trx { nullptr };
+
+    std::array<std::unique_ptr<rf215_trx_state>, 2> _trx;
+
+    std::unique_ptr<rf215_irq_state> _irq_state;
+    // Wakes the IRQ thread when another thread stashed IRQs of an idle transceiver
+    int _irq_kick_fd = -1;
 
-    size_t _tx_counter = 0;
-    size_t _rx_counter = 0;
+    std::thread _irq_thread;
+    std::atomic_bool _irq_running { false };
 
     mutable std::mutex _mut;
 };
 
+// One transceiver of a shared RF215 chip, so RF09 and RF24 can run concurrently
+class rf215_trx_radio final : public radio {
+
+public:
+    explicit rf215_trx_radio(const std::shared_ptr<rf215_radio>& chip,
+                             rf215_trx_type type) noexcept;
+    ~rf215_trx_radio() = default;
+
+    [[nodiscard]] auto configure(const radio_config& config) -> error final;
+
+    [[nodiscard]] auto transmit(span<const uint8_t> data) -> error final;
+
+    [[nodiscard]] auto receive(span<uint8_t> buffer,
+                               size_t& len,
+                               radio_rx_info& info,
+                               const std::chrono::milliseconds& timeout) -> error final;
+
+    [[nodiscard]] auto rx_event_fd() const noexcept -> int final;
+
+    [[nodiscard]] auto get_channel_access_stats() -> channel_access_stats final;
+
+protected:
+    rf215_trx_radio(const rf215_trx_radio&) = delete;
+    rf215_trx_radio(rf215_trx_radio&&) = delete;
+
+    rf215_trx_radio& operator=(const rf215_trx_radio&) = delete;
+    rf215_trx_radio& operator=(rf215_trx_radio&&) = delete;
+
+private:
+    const std::shared_ptr<rf215_radio> _chip;
+    const rf215_trx_type _type;
+};
+
 } // namespace kaonic::comm
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "kaonic/comm/radio/radio.hpp"
+#include "kaonic/common/ring_buffer.hpp"
+
+namespace kaonic::comm {
+
+class sim_radio;
+
+struct sim_radio_config final {
+    std::string name;
+
+    // Probability [0.0 - 1.0] that a frame on the medium is not delivered to this radio
+    double loss_rate = 0.0;
+
+    // Maximum number of frames waiting in the receive queue
+    size_t rx_queue_size = 32;
+
+    // Seed for the loss generator (0 - random seed)
+    uint64_t seed = 0;
+};
+
+struct sim_link final {
+    // Probability [0.0 - 1.0] that a frame is lost on the link
+    double loss_rate = 0.0;
+
+    std::chrono::microseconds propagation_delay { 0 };
+
+    // Signal strength reported by the receiving radio, dBm
+    int8_t rssi = -60;
+};
+
+struct sim_medium_config final {
+    // Link parameters used for every pair of radios without an explicit link
+    sim_link default_link;
+
+    // Overlapping transmissions on the same channel corrupt each other
+    bool collisions = true;
+
+    uint64_t seed = 0;
+};
+
+struct sim_medium_stats final {
+    size_t transmissions = 0;
+    size_t collisions = 0;
+    size_t delivered = 0;
+    size_t lost = 0;
+
+    // Time with at least one frame on air
+    std::chrono::microseconds busy_time { 0 };
+};
+
+// Shared in-memory medium which links several simulated radios in one process.
+// A frame transmitted by one radio is delivered to every other radio tuned to the same
+// frequency, channel and PHY once its airtime and the link propagation delay have elapsed.
+class sim_medium final {
+
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit sim_medium(const sim_medium_config& config = {}) noexcept;
+    ~sim_medium() = default;
+
+    auto attach(sim_radio* radio) noexcept -> void;
+
+    auto detach(sim_radio* radio) noexcept -> void;
+
+    // Overrides link parameters for frames sent by 'from' and heard by 'to'
+    auto set_link(const sim_radio& from, const sim_radio& to, const sim_link& link) noexcept
+        -> void;
+
+    [[nodiscard]] auto get_stats() const noexcept -> sim_medium_stats;
+
+private:
+    friend class sim_radio;
+
+    struct transmission final {
+        const sim_radio* source;
+        radio_config config;
+        clock::time_point start;
+        clock::time_point end;
+        bool collided = false;
+    };
+
+    using transmission_id = std::list<transmission>::iterator;
+
+    [[nodiscard]] auto begin_transmit(const sim_radio* source,
+                                      const radio_config& config,
+                                      std::chrono::microseconds airtime) noexcept
+        -> transmission_id;
+
+    auto end_transmit(transmission_id id, span<const uint8_t> data) noexcept -> void;
+
+    [[nodiscard]] auto link(const sim_radio* from, const sim_radio* to) const noexcept
+        -> const sim_link&;
+
+protected:
+    sim_medium(const sim_medium&) = delete;
+    sim_medium(sim_medium&&) = delete;
+
+    sim_medium& operator=(const sim_medium&) = delete;
+    sim_medium& operator=(sim_medium&&) = delete;
+
+private:
+    sim_medium_config _config;
+
+    std::vector<sim_radio*> _radios;
+    std::map<std::pair<const sim_radio*, const sim_radio*>, sim_link> _links;
+
+    std::list<transmission> _transmissions;
+    // Nodes of finished transmissions, spliced back in so sending doesn't allocate
+    std::list<transmission> _free_transmissions;
+    clock::time_point _busy_until;
+
+    sim_medium_stats _stats;
+
+    std::mt19937_64 _loss_generator;
+    std::uniform_real_distribution<double> _loss_distribution { 0.0, 1.0 };
+
+    mutable std::mutex _mut;
+};
+
+class sim_radio final : public radio {
+
+public:
+    explicit sim_radio(const sim_radio_config& config,
+                       const std::shared_ptr<sim_medium>& medium) noexcept;
+    ~sim_radio() final;
+
+    [[nodiscard]] auto configure(const radio_config& config) -> error final;
+
+    [[nodiscard]] auto transmit(span<const uint8_t> data) -> error final;
+
+    [[nodiscard]] auto receive(span<uint8_t> buffer,
+                               size_t& len,
+                               radio_rx_info& info,
+                               const std::chrono::milliseconds& timeout) -> error final;
+
+    [[nodiscard]] auto rx_event_fd() const noexcept -> int final;
+
+    // Time on air of a frame with 'len' bytes of payload for the PHY configuration
+    [[nodiscard]] static auto airtime(const radio_phy_config_t& phy_config, size_t len) noexcept
+        -> std::chrono::microseconds;
+
+private:
+    friend class sim_medium;
+
+    [[nodiscard]] auto is_compatible(const radio_config& config) const noexcept -> bool;
+
+    // Keeps the RX event set while the first queued frame can be received
+    auto update_rx_event() noexcept -> void;
+
+    auto deliver(const radio_config& config,
+                 span<const uint8_t> data,
+                 const sim_link& link,
+                 sim_medium::clock::time_point available_at) noexcept -> bool;
+
+protected:
+    sim_radio(const sim_radio&) = delete;
+    sim_radio(sim_radio&&) = delete;
+
+    sim_radio& operator=(const sim_radio&) = delete;
+    sim_radio& operator=(sim_radio&&) = delete;
+
+private:
+    sim_radio_config _config;
+
+    std::shared_ptr<sim_medium> _medium;
+
+    radio_config _radio_config;
+    bool _configured = false;
+
+    struct rx_entry final {
+        sim_medium::clock::time_point available_at;
+        radio_frame frame;
+    };
+
+    // Slots are allocated once, like the transceiver's frame buffers
+    ring_buffer<rx_entry> _rx_queue;
+    std::condition_variable _rx_cond;
+
+    int _rx_event_fd = -1;
+    bool _rx_event_set = false;
+
+    std::mt19937_64 _loss_generator;
+    std::uniform_real_distribution<double> _loss_distribution { 0.0, 1.0 };
+
+    size_t _tx_counter = 0;
+    size_t _rx_counter = 0;
+    size_t _rx_dropped = 0;
+
+    mutable std::mutex _mut;
+};
+
+} // namespace kaonic::comm
@@ -2,6 +2,8 @@
 
 #include <variant>
 
+#include "kaonic/common/span.hpp"
+
 #include <kaonic.grpc.pb.h>
 
 namespace kaonic::comm::serial {
@@ -18,6 +20,9 @@ public:
     static auto decode(const buffer_t& buffer, payload_t& payload) noexcept -> void;
 
     static auto encode(const payload_t& payload, buffer_t& buffer) noexcept -> void;
+
+    // Packet of a ReceiveResponse that is already serialized
+    static auto encode_receive(span<const uint8_t> response, buffer_t& buffer) noexcept -> void;
 };
 
 } // namespace kaonic::comm::serial
@@ -1,73 +1,132 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <shared_mutex>
+#include <string>
 #include <string_view>
+#include <thread>
+#include <vector>
 
+#include "kaonic/comm/mesh/frame_ring.hpp"
 #include "kaonic/comm/services/radio_service.hpp"
+#include "kaonic/comm/services/response_publisher.hpp"
+#include "kaonic/common/error.hpp"
 
 #include <kaonic.grpc.pb.h>
 
 #include <grpc/grpc.h>
+#include <grpcpp/server.h>
 
 namespace kaonic::comm {
 
-class grpc_service final : public Radio::Service {
+struct grpc_config final {
+    // Port 0 picks any free port, see grpc_service::port()
+    std::string address = "0.0.0.0:8080";
+
+    // Completion queues and the threads serving them, clients don't add any threads
+    size_t threads = 2;
+
+    // Every receive stream reads the frames of its module with the same depth and policy, the
+    // depth is bounded by the ring size of the response publisher
+    mesh::subscriber_config stream;
+};
+
+// Radio service on asynchronous completion queues. Every call is a state machine advanced by
+// the queue threads, an idle receive stream is woken by the frames published for it.
+class grpc_service final {
 
 public:
+    // Receive streams read the responses serialized by the publisher
     explicit grpc_service(const std::shared_ptr<radio_service>& service,
-                          std::string_view version) noexcept;
+                          const std::shared_ptr<response_publisher>& publisher,
+                          std::string_view version,
+                          const grpc_config& config = {}) noexcept;
+    ~grpc_service();
 
-    grpc_service(const grpc_service&) = delete;
-    grpc_service(grpc_service&&) noexcept = delete;
+    [[nodiscard]] auto start() -> error;
 
-    [[nodiscard]] auto Configure(::grpc::ServerContext* context,
-                                 const ConfigurationRequest* request,
-                                 Empty* response) -> ::grpc::Status final;
+    // Cancels the calls in progress and joins the queue threads
+    auto stop() -> void;
 
-    [[nodiscard]] auto Transmit(::grpc::ServerContext* context,
-                                const TransmitRequest* request,
-                                TransmitResponse* response) -> ::grpc::Status final;
+    // Blocks until the service is stopped
+    auto wait() -> void;
 
-    [[nodiscard]] auto ReceiveStream(::grpc::ServerContext* context,
-                                     const ReceiveRequest* request,
-                                     ::grpc::ServerWriter<ReceiveResponse>* writer)
-        -> ::grpc::Status final;
+    [[nodiscard]] auto port() const noexcept -> int { return _port; }
 
-    auto receive_frame(const mesh::frame& frame) -> void;
+protected:
+    grpc_service(const grpc_service&) = delete;
+    grpc_service(grpc_service&&) = delete;
 
     grpc_service& operator=(const grpc_service&) = delete;
-    grpc_service& operator=(grpc_service&&) noexcept = delete;
+    grpc_service& operator=(grpc_service&&) = delete;
 
 private:
-    auto pop_frame(mesh::frame& frame, std::chrono::milliseconds timeout) -> bool;
+    // ReceiveStream is raw, its responses are written as the bytes serialized for the stream's
+    // encoding
+    using async_service = Radio::WithAsyncMethod_Configure<Radio::WithAsyncMethod_Transmit<
+        Radio::WithRawMethod_ReceiveStream<Radio::WithAsyncMethod_TransmitStream<Radio::Service>>>>;
+
+    class call;
+    class configure_call;
+    class transmit_call;
+    class receive_call;
+    class transmit_stream_call;
+
+    auto serve(::grpc::ServerCompletionQueue* queue) -> void;
+
+    // Runs 'start' unless the queues are shut down, operations are only started through it
+    template <class F>
+    auto start_operation(F&& start) -> bool;
+
+    [[nodiscard]] auto configure(const ConfigurationRequest& request) -> ::grpc::Status;
+
+    // Callback is invoked once the frame is sent, only when no error is returned
+    [[nodiscard]] auto transmit(const TransmitRequest& request, mesh::tx_callback callback)
+        -> error;
 
 private:
     std::shared_ptr<radio_service> _radio_service;
+    std::shared_ptr<response_publisher> _publisher;
 
     std::string_view _version;
 
-    std::queue<mesh::frame> _frame_queue;
-    mutable std::mutex _mut;
-    std::condition_variable _frame_queue_cond;
+    const grpc_config _config;
+
+    async_service _service;
+    std::unique_ptr<::grpc::Server> _server;
+    int _port = 0;
+
+    std::vector<std::unique_ptr<::grpc::ServerCompletionQueue>> _queues;
+    std::vector<std::thread> _threads;
 
-    mesh::frame _tx_frame;
-    mesh::frame _rx_frame;
+    // Taken shared to start an operation, frames wake streams from the listener threads
+    std::shared_mutex _queue_mut;
+    bool _queues_open = false;
+
+    // Frames handed to the radio whose calls are still to be finished, none are taken once
+    // the service is stopping
+    size_t _transmits = 0;
+    bool _accepting = false;
+    bool _running = false;
+    std::mutex _state_mut;
+    std::condition_variable _state_cond;
 };
 
-class grpc_radio_listener final : public mesh::network_receiver {
+template <class F>
+auto grpc_service::start_operation(F&& start) -> bool {
+    std::shared_lock lock { _queue_mut };
 
-public:
-    explicit grpc_radio_listener(const std::shared_ptr<grpc_service>& service) noexcept;
-    ~grpc_radio_listener() final = default;
+    if (!_queues_open) {
+        return false;
+    }
 
-    auto on_receive(const mesh::frame& frame) -> void final;
+    start();
 
-private:
-    std::shared_ptr<grpc_service> _grpc_service;
-};
+    return true;
+}
 
 } // namespace kaonic::comm
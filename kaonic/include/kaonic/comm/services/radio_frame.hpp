@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+#include "kaonic/comm/mesh/network_interface.hpp"
+#include "kaonic/common/span.hpp"
+
+#include <kaonic.pb.h>
+
+namespace kaonic::comm {
+
+// Payload of the frame in either encoding, borrowed from the message and valid while it's
+// alive and unchanged
+[[nodiscard]] auto radio_frame_view(const RadioFrame& frame) -> mesh::frame_view;
+
+// Copies the payload into the frame, a reused frame keeps the capacity of its fields
+auto radio_frame_pack(span<const uint8_t> payload, FrameEncoding encoding, RadioFrame& frame)
+    -> void;
+
+// Response every consumer of a received frame sends, its latency runs up to now
+auto radio_frame_response(const mesh::frame_view& frame,
+                          FrameEncoding encoding,
+                          ReceiveResponse& response) -> void;
+
+} // namespace kaonic::comm
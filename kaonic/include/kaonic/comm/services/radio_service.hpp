@@ -1,5 +1,9 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "kaonic/comm/mesh/radio_network.hpp"
@@ -7,22 +11,84 @@
 
 namespace kaonic::comm {
 
+// Tags received frames with the index of the module they came from
+class radio_module_receiver final : public mesh::network_receiver {
+
+public:
+    explicit radio_module_receiver(uint8_t module,
+                                   const std::shared_ptr<mesh::network_receiver>& receiver) noexcept;
+    ~radio_module_receiver() final = default;
+
+    auto on_receive(const mesh::frame_view& frame) -> void final;
+
+    auto on_receive_pooled(const mesh::frame& frame) -> void final;
+
+private:
+    const uint8_t _module;
+    const std::shared_ptr<mesh::network_receiver> _receiver;
+};
+
 class radio_service {
 
 public:
+    // Frames of all radios and the client services share one pool of 'pool_size' buffers.
+    // Counters of every module are logged each 'stats_interval' (0 - never).
     explicit radio_service(const mesh::config& config,
-                           const std::vector<std::shared_ptr<radio>>& radios) noexcept;
+                           const std::vector<std::shared_ptr<radio>>& radios,
+                           size_t pool_size = 256,
+                           std::chrono::seconds stats_interval = {}) noexcept;
+
+    // Stops the update threads of the networks
+    ~radio_service();
+
+    // Logs the mesh and channel access counters of every module
+    auto log_stats() -> void;
 
     [[nodiscard]] auto configure(uint8_t module, const radio_config& config) -> error;
 
-    [[nodiscard]] auto transmit(uint8_t module, const mesh::frame& frame) -> error;
+    [[nodiscard]] auto transmit(uint8_t module, const mesh::frame_view& frame) -> error;
 
+    [[nodiscard]] auto transmit(uint8_t module,
+                                const mesh::frame_view& frame,
+                                mesh::tx_result& result) -> error;
+
+    // Callback is invoked from the network's update thread once the frame is sent
+    [[nodiscard]] auto transmit_async(uint8_t module,
+                                      const mesh::frame_view& frame,
+                                      mesh::tx_callback callback) -> error;
+
+    // Listener gets the frames of every module, each of them through its own queue
     auto attach_listener(const std::shared_ptr<mesh::network_receiver>& listener) noexcept -> void;
 
+    [[nodiscard]] auto attach_listener(uint8_t module,
+                                       const std::shared_ptr<mesh::network_receiver>& listener,
+                                       const mesh::listener_config& config = {}) noexcept
+        -> error;
+
+    [[nodiscard]] auto module_count() const noexcept -> size_t { return _radios.size(); }
+
+    [[nodiscard]] auto get_frame_pool() const noexcept -> const std::shared_ptr<mesh::frame_pool>& {
+        return _frame_pool;
+    }
+
 private:
+    auto stats_loop(std::chrono::seconds interval) noexcept -> void;
+
+private:
+    // Destroyed last, networks and listeners may still hold its buffers
+    std::shared_ptr<mesh::frame_pool> _frame_pool;
+
     std::vector<std::shared_ptr<radio>> _radios;
+
+    // One per module, a frame heard by several radios is delivered once by the first of them
+    std::shared_ptr<mesh::dedup_filter> _dedup_filter;
     std::vector<std::shared_ptr<mesh::network_broadcast_receiver>> _radio_broadcasters;
     std::vector<std::shared_ptr<mesh::radio_network>> _radio_networks;
+
+    std::thread _stats_thread;
+    std::mutex _stats_mut;
+    std::condition_variable _stats_cond;
+    bool _stopping = false;
 };
 
 } // namespace kaonic::comm
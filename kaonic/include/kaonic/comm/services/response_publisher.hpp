@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "kaonic/comm/mesh/frame_pool.hpp"
+#include "kaonic/comm/mesh/frame_ring.hpp"
+#include "kaonic/comm/mesh/network_receiver.hpp"
+
+#include <kaonic.pb.h>
+
+namespace kaonic::comm {
+
+// Serializes the received frames of every module once for each encoding somebody reads them
+// in. gRPC streams and the serial port of a module share the same pooled bytes.
+class response_publisher final : public mesh::network_receiver {
+
+public:
+    // Frames kept for the consumers of a module, bounds their depth
+    constexpr static size_t default_ring_size = 64;
+
+    explicit response_publisher(size_t modules, size_t ring_size = default_ring_size) noexcept;
+    ~response_publisher() final = default;
+
+    // Serialized responses of the module's frames, nullptr for an unknown module. Encodings
+    // unknown to the service read words.
+    [[nodiscard]] auto ring(size_t module, FrameEncoding encoding) noexcept -> mesh::frame_ring*;
+
+    [[nodiscard]] auto module_count() const noexcept -> size_t { return _modules.size(); }
+
+    // Called from the module's dispatch thread, the only producer of its rings
+    auto on_receive(const mesh::frame_view& frame) -> void final;
+
+    auto on_receive_pooled(const mesh::frame& frame) -> void final;
+
+protected:
+    response_publisher(const response_publisher&) = delete;
+    response_publisher(response_publisher&&) = delete;
+
+    response_publisher& operator=(const response_publisher&) = delete;
+    response_publisher& operator=(response_publisher&&) = delete;
+
+private:
+    // One ring per encoding, so every consumer of an encoding reads the same bytes
+    struct module_rx final {
+        std::array<std::unique_ptr<mesh::frame_ring>, 2> rings;
+        ReceiveResponse response;
+    };
+
+private:
+    // Serialized responses wait in pooled buffers until every consumer has written them
+    std::unique_ptr<mesh::frame_pool> _pool;
+    std::vector<std::unique_ptr<module_rx>> _modules;
+};
+
+} // namespace kaonic::comm
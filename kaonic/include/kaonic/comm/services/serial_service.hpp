@@ -1,26 +1,31 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <filesystem>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
-#include "kaonic/comm/mesh/network_interface.hpp"
+#include "kaonic/comm/mesh/frame_ring.hpp"
 #include "kaonic/comm/serial/hdlc.hpp"
 #include "kaonic/comm/serial/packet.hpp"
 #include "kaonic/comm/serial/serial.hpp"
 #include "kaonic/comm/services/radio_service.hpp"
+#include "kaonic/comm/services/response_publisher.hpp"
 
 namespace kaonic::comm {
 
 class serial_service final {
 
 public:
+    // Received frames are written as the responses serialized by the publisher
     explicit serial_service(const std::shared_ptr<serial::serial> serial,
-                            const std::shared_ptr<radio_service>& service) noexcept;
+                            const std::shared_ptr<radio_service>& service,
+                            const std::shared_ptr<response_publisher>& publisher) noexcept;
     ~serial_service();
 
     serial_service(const serial_service&) = delete;
@@ -30,7 +35,10 @@ public:
 
     [[nodiscard]] auto stop_tx() -> error;
 
-    auto receive_frame(const mesh::frame& frame) -> void;
+    // Writes the received frames of every module to the port from a thread of its own
+    [[nodiscard]] auto start_rx() -> error;
+
+    [[nodiscard]] auto stop_rx() -> error;
 
     serial_service& operator=(const serial_service&) = delete;
     serial_service& operator=(serial_service&&) = delete;
@@ -40,11 +48,17 @@ private:
 
     auto handle_packet(serial::payload_t& payload) noexcept -> void;
 
+    auto rx() -> void;
+
+    auto write_frame(const mesh::frame& frame) noexcept -> void;
+
 private:
     std::shared_ptr<serial::serial> _serial;
     std::shared_ptr<radio_service> _radio_service;
+    std::shared_ptr<response_publisher> _publisher;
 
     std::thread _rx_thread;
+    std::thread _write_thread;
 
     std::atomic_bool _is_active { false };
 
@@ -56,21 +70,14 @@ private:
 
     serial::payload_t _tx_payload;
 
-    ReceiveResponse _rx_response;
-    std::vector<uint8_t> _rx_protobuf;
-    mesh::frame _frame;
-};
-
-class serial_radio_listener final : public mesh::network_receiver {
+    // Words responses of every module, the publisher wakes the write thread
+    std::vector<std::unique_ptr<mesh::frame_subscriber>> _rx_subscribers;
+    std::mutex _rx_mut;
+    std::condition_variable _rx_cond;
+    bool _rx_pending = false;
+    bool _rx_active = false;
 
-public:
-    explicit serial_radio_listener(const std::shared_ptr<serial_service>& service) noexcept;
-    ~serial_radio_listener() final = default;
-
-    auto on_receive(const mesh::frame& frame) -> void final;
-
-private:
-    std::shared_ptr<serial_service> _serial_service;
+    std::vector<uint8_t> _rx_packet;
 };
 
 } // namespace kaonic::comm
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace kaonic {
+
+// Payload bytes copied on the frame path between the client and the radio
+struct copy_stats final {
+    size_t tx_copies;
+    size_t tx_bytes;
+
+    size_t rx_copies;
+    size_t rx_bytes;
+};
+
+class copy_counter final {
+
+public:
+    static auto count_tx(size_t len) noexcept -> void {
+        instance()._tx_copies.fetch_add(1, std::memory_order_relaxed);
+        instance()._tx_bytes.fetch_add(len, std::memory_order_relaxed);
+    }
+
+    static auto count_rx(size_t len) noexcept -> void {
+        instance()._rx_copies.fetch_add(1, std::memory_order_relaxed);
+        instance()._rx_bytes.fetch_add(len, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] static auto get_stats() noexcept -> copy_stats {
+        auto& self = instance();
+        return copy_stats {
+            .tx_copies = self._tx_copies.load(std::memory_order_relaxed),
+            .tx_bytes = self._tx_bytes.load(std::memory_order_relaxed),
+            .rx_copies = self._rx_copies.load(std::memory_order_relaxed),
+            .rx_bytes = self._rx_bytes.load(std::memory_order_relaxed),
+        };
+    }
+
+    static auto reset() noexcept -> void {
+        auto& self = instance();
+        self._tx_copies = 0;
+        self._tx_bytes = 0;
+        self._rx_copies = 0;
+        self._rx_bytes = 0;
+    }
+
+private:
+    explicit copy_counter() noexcept = default;
+
+    [[nodiscard]] static auto instance() noexcept -> copy_counter& {
+        static copy_counter counter;
+        return counter;
+    }
+
+private:
+    std::atomic<size_t> _tx_copies { 0 };
+    std::atomic<size_t> _tx_bytes { 0 };
+
+    std::atomic<size_t> _rx_copies { 0 };
+    std::atomic<size_t> _rx_bytes { 0 };
+};
+
+} // namespace kaonic
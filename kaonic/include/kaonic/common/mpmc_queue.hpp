@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace kaonic {
+
+// Bounded lock-free multi-producer multi-consumer ring (Vyukov's sequence-numbered slots).
+// Capacity is rounded up to a power of two. Producers may pop too, e.g. to drop the oldest
+// element when the ring is full.
+template <class T>
+class mpmc_queue final {
+
+public:
+    explicit mpmc_queue(size_t capacity)
+        : _mask { round_up(capacity) - 1 }
+        , _slots { std::make_unique<slot[]>(_mask + 1) } {
+        for (size_t i = 0; i <= _mask; ++i) {
+            _slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~mpmc_queue() = default;
+
+    // Moves the value in, false when the ring is full
+    [[nodiscard]] auto try_push(T&& value) noexcept -> bool {
+        auto pos = _head.load(std::memory_order_relaxed);
+
+        for (;;) {
+            auto& slot = _slots[pos & _mask];
+            const auto seq = slot.seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+
+            if (diff == 0) {
+                if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = _head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Moves the oldest value out, false when the ring is empty
+    [[nodiscard]] auto try_pop(T& value) noexcept -> bool {
+        auto pos = _tail.load(std::memory_order_relaxed);
+
+        for (;;) {
+            auto& slot = _slots[pos & _mask];
+            const auto seq = slot.seq.load(std::memory_order_acquire);
+            const auto diff =
+                static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+
+            if (diff == 0) {
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(slot.value);
+                    // Slot is reset, resources of the element aren't held until it's reused
+                    slot.value = T {};
+                    slot.seq.store(pos + _mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Approximate while producers and consumers are running
+    [[nodiscard]] auto size() const noexcept -> size_t {
+        const auto head = _head.load(std::memory_order_acquire);
+        const auto tail = _tail.load(std::memory_order_acquire);
+        return head > tail ? head - tail : 0;
+    }
+
+    [[nodiscard]] auto empty() const noexcept -> bool { return size() == 0; }
+
+    [[nodiscard]] auto capacity() const noexcept -> size_t { return _mask + 1; }
+
+protected:
+    mpmc_queue(const mpmc_queue&) = delete;
+    mpmc_queue(mpmc_queue&&) = delete;
+
+    mpmc_queue& operator=(const mpmc_queue&) = delete;
+    mpmc_queue& operator=(mpmc_queue&&) = delete;
+
+private:
+    struct slot final {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    [[nodiscard]] static auto round_up(size_t capacity) noexcept -> size_t {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+private:
+    const size_t _mask;
+    std::unique_ptr<slot[]> _slots;
+
+    alignas(64) std::atomic<size_t> _head { 0 };
+    alignas(64) std::atomic<size_t> _tail { 0 };
+};
+
+} // namespace kaonic
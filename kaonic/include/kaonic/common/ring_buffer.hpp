@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace kaonic {
+
+// Bounded FIFO over slots allocated once, not thread-safe.
+// Popped slots are reset, so the resources of their elements are released right away.
+template <class T>
+class ring_buffer final {
+
+public:
+    explicit ring_buffer(size_t capacity)
+        : _slots(capacity ? capacity : 1) {}
+
+    ~ring_buffer() = default;
+
+    ring_buffer(ring_buffer&&) noexcept = default;
+    ring_buffer& operator=(ring_buffer&&) noexcept = default;
+
+    // Slot at the back, the caller checks the ring isn't full
+    auto emplace_back() noexcept -> T& {
+        auto& slot = _slots[(_head + _size) % _slots.size()];
+        ++_size;
+        return slot;
+    }
+
+    auto push_back(T&& value) noexcept -> void { emplace_back() = std::move(value); }
+
+    [[nodiscard]] auto front() noexcept -> T& { return _slots[_head]; }
+
+    auto pop_front() noexcept -> void {
+        _slots[_head] = T {};
+        _head = (_head + 1) % _slots.size();
+        --_size;
+    }
+
+    auto clear() noexcept -> void {
+        while (!empty()) {
+            pop_front();
+        }
+    }
+
+    [[nodiscard]] auto size() const noexcept -> size_t { return _size; }
+
+    [[nodiscard]] auto empty() const noexcept -> bool { return _size == 0; }
+
+    [[nodiscard]] auto full() const noexcept -> bool { return _size == _slots.size(); }
+
+    [[nodiscard]] auto capacity() const noexcept -> size_t { return _slots.size(); }
+
+protected:
+    ring_buffer(const ring_buffer&) = delete;
+    ring_buffer& operator=(const ring_buffer&) = delete;
+
+private:
+    std::vector<T> _slots;
+
+    size_t _head = 0;
+    size_t _size = 0;
+};
+
+} // namespace kaonic
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+namespace kaonic {
+
+// Non-owning view of a contiguous sequence (C++17 stand-in for std::span)
+template <class T>
+class span final {
+
+public:
+    using element_type = T;
+    using value_type = std::remove_cv_t<T>;
+    using pointer = T*;
+    using iterator = T*;
+
+    constexpr span() noexcept = default;
+
+    constexpr span(T* data, size_t size) noexcept
+        : _data { data }
+        , _size { size } {}
+
+    template <size_t N>
+    constexpr span(T (&array)[N]) noexcept
+        : _data { array }
+        , _size { N } {}
+
+    // Any contiguous container with data() and size(), e.g. std::vector or std::array
+    template <class Container,
+              class = std::enable_if_t<
+                  std::is_convertible_v<decltype(std::declval<Container&>().data()), T*>>>
+    constexpr span(Container& container) noexcept
+        : _data { container.data() }
+        , _size { container.size() } {}
+
+    // Mutable view converts to a read-only one
+    template <class U, class = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+    constexpr span(const span<U>& other) noexcept
+        : _data { other.data() }
+        , _size { other.size() } {}
+
+    [[nodiscard]] constexpr auto data() const noexcept -> T* { return _data; }
+
+    [[nodiscard]] constexpr auto size() const noexcept -> size_t { return _size; }
+
+    [[nodiscard]] constexpr auto empty() const noexcept -> bool { return _size == 0; }
+
+    [[nodiscard]] constexpr auto begin() const noexcept -> iterator { return _data; }
+
+    [[nodiscard]] constexpr auto end() const noexcept -> iterator { return _data + _size; }
+
+    [[nodiscard]] constexpr auto operator[](size_t index) const noexcept -> T& {
+        return _data[index];
+    }
+
+    [[nodiscard]] constexpr auto first(size_t count) const noexcept -> span {
+        return span { _data, count < _size ? count : _size };
+    }
+
+    [[nodiscard]] constexpr auto subspan(size_t offset) const noexcept -> span {
+        return offset < _size ? span { _data + offset, _size - offset } : span {};
+    }
+
+private:
+    T* _data = nullptr;
+    size_t _size = 0;
+};
+
+} // namespace kaonic
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace kaonic {
+
+// Bounded lock-free single-producer single-consumer ring.
+// Slots are filled and consumed in place to avoid copying large elements twice.
+template <class T, size_t Capacity>
+class spsc_queue final {
+
+    static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0,
+                  "spsc_queue capacity must be a power of two");
+
+public:
+    explicit spsc_queue() noexcept = default;
+    ~spsc_queue() = default;
+
+    // Producer: slot to fill or nullptr if the queue is full
+    [[nodiscard]] auto producer_slot() noexcept -> T* {
+        const auto head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= Capacity) {
+            return nullptr;
+        }
+        return &_slots[head & (Capacity - 1)];
+    }
+
+    // Producer: publish the slot returned by producer_slot()
+    auto push() noexcept -> void {
+        _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer: oldest element or nullptr if the queue is empty
+    [[nodiscard]] auto consumer_slot() noexcept -> T* {
+        const auto tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &_slots[tail & (Capacity - 1)];
+    }
+
+    // Consumer: release the slot returned by consumer_slot()
+    auto pop() noexcept -> void {
+        _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    [[nodiscard]] auto size() const noexcept -> size_t {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] auto empty() const noexcept -> bool { return size() == 0; }
+
+    [[nodiscard]] constexpr static auto capacity() noexcept -> size_t { return Capacity; }
+
+protected:
+    spsc_queue(const spsc_queue&) = delete;
+    spsc_queue(spsc_queue&&) = delete;
+
+    spsc_queue& operator=(const spsc_queue&) = delete;
+    spsc_queue& operator=(spsc_queue&&) = delete;
+
+private:
+    std::array<T, Capacity> _slots;
+
+    alignas(64) std::atomic<size_t> _head { 0 };
+    alignas(64) std::atomic<size_t> _tail { 0 };
+};
+
+} // namespace kaonic
@@ -0,0 +1,77 @@
+#include "kaonic/comm/drivers/irq_line.hpp"
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "kaonic/common/logging.hpp"
+
+namespace kaonic::drivers {
+
+// Edges queued by the kernel are drained with a few reads at most
+constexpr static size_t max_read_events = 16;
+
+auto irq_line::open(int fd) -> error {
+
+    const auto flags = ::fcntl(fd, F_GETFL);
+    if (flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        log::error("irq: can't make line non-blocking: {}", strerror(errno));
+        return error::fail();
+    }
+
+    _fd = fd;
+
+    return error::ok();
+}
+
+auto irq_line::wait(std::chrono::nanoseconds timeout) const noexcept -> bool {
+
+    const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    const timespec ts {
+        .tv_sec = static_cast<time_t>(seconds.count()),
+        .tv_nsec = static_cast<long>((timeout - seconds).count()),
+    };
+
+    pollfd fd { .fd = _fd, .events = POLLIN, .revents = 0 };
+
+    int rc = 0;
+    do {
+        rc = ::ppoll(&fd, 1, &ts, nullptr);
+    } while (rc < 0 && errno == EINTR);
+
+    return rc > 0 && (fd.revents & POLLIN);
+}
+
+auto irq_line::take(std::chrono::nanoseconds& timestamp) const noexcept -> bool {
+
+    std::array<gpio_v2_line_event, max_read_events> events;
+
+    bool taken = false;
+    while (true) {
+        const auto len = ::read(_fd, events.data(), sizeof(events));
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+
+        // EAGAIN once the edges are gone, possibly taken by another thread since the last poll
+        if (len < static_cast<ssize_t>(sizeof(gpio_v2_line_event))) {
+            break;
+        }
+
+        const auto& last = events[static_cast<size_t>(len) / sizeof(gpio_v2_line_event) - 1];
+        timestamp = std::chrono::nanoseconds { static_cast<int64_t>(last.timestamp_ns) };
+        taken = true;
+
+        if (static_cast<size_t>(len) < sizeof(events)) {
+            break;
+        }
+    }
+
+    return taken;
+}
+
+} // namespace kaonic::drivers
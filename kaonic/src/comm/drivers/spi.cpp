@@ -10,6 +10,38 @@
 
 namespace kaonic::drivers {
 
+// spidev rejects messages larger than its 'bufsiz' (4096 bytes by default)
+constexpr static size_t max_message_size = 4096;
+constexpr static size_t max_message_transfers = 128;
+
+auto spi_batch::write(const uint16_t addr, const uint8_t* buffer, size_t length) -> void {
+    if (!buffer || length == 0) {
+        return;
+    }
+
+    if (!_bursts.empty()) {
+        auto& last = _bursts.back();
+        if (static_cast<size_t>(last.addr) + last.length == addr) {
+            _data.insert(_data.end(), buffer, buffer + length);
+            last.length += length;
+            return;
+        }
+    }
+
+    _bursts.push_back(burst {
+        .addr = addr,
+        .header = htobe16(addr),
+        .offset = _data.size(),
+        .length = length,
+    });
+    _data.insert(_data.end(), buffer, buffer + length);
+}
+
+auto spi_batch::clear() noexcept -> void {
+    _bursts.clear();
+    _data.clear();
+}
+
 auto spi::open(const spi_config& config) -> error {
 
     log::debug("spi: open '{}' device", config.dev);
@@ -109,6 +141,67 @@ auto spi::write_buffer(const uint16_t addr, const uint8_t* buffer, size_t length
     return error::ok();
 }
 
+auto spi::submit(spi_batch& batch) -> error {
+
+    auto err = error::ok();
+
+    size_t message_size = 0;
+    _xfers.clear();
+
+    const auto flush = [&]() {
+        if (_xfers.empty()) {
+            return;
+        }
+
+        // Chip select is released after the message, not between its last transfers
+        _xfers.back().cs_change = 0;
+
+        if (ioctl(_device_fd, SPI_IOC_MESSAGE(_xfers.size()), _xfers.data()) < 0) {
+            log::error("[SPI] Error {} from ioctl (submit batch): {}", errno, strerror(errno));
+            err = error::fail();
+        }
+
+        message_size = 0;
+        _xfers.clear();
+    };
+
+    for (const auto& burst : batch._bursts) {
+
+        const auto burst_size = sizeof(burst.header) + burst.length;
+
+        if ((message_size + burst_size) > max_message_size
+            || (_xfers.size() + 2) > max_message_transfers) {
+            flush();
+        }
+
+        struct spi_ioc_transfer xfer[2];
+        memset(xfer, 0x00, sizeof(xfer));
+
+        xfer[0].tx_buf = reinterpret_cast<__u64>(&burst.header);
+        xfer[0].len = sizeof(burst.header);
+        xfer[0].speed_hz = _config.speed;
+        xfer[0].bits_per_word = _config.bits_per_word;
+
+        xfer[1].tx_buf = reinterpret_cast<__u64>(batch._data.data() + burst.offset);
+        xfer[1].len = burst.length;
+        xfer[1].speed_hz = _config.speed;
+        xfer[1].bits_per_word = _config.bits_per_word;
+        // Toggle chip select so the next burst starts with a new address
+        xfer[1].cs_change = 1;
+
+        _xfers.push_back(xfer[0]);
+        _xfers.push_back(xfer[1]);
+
+        message_size += burst_size;
+    }
+
+    flush();
+
+    batch.clear();
+
+    return err;
+}
+
 auto spi::close() noexcept -> void {
     ::close(_device_fd);
 }
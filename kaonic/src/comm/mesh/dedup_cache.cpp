@@ -0,0 +1,125 @@
+#include "kaonic/comm/mesh/dedup_cache.hpp"
+
+#include <algorithm>
+
+namespace kaonic::comm::mesh {
+
+// Slots looked at for a key before the oldest of them is replaced
+constexpr static size_t max_probes = 8;
+
+constexpr static uint64_t fnv_offset = 0xCBF29CE484222325ull;
+constexpr static uint64_t fnv_prime = 0x100000001B3ull;
+
+static auto fnv1a(span<const uint8_t> data, uint64_t hash) noexcept -> uint64_t {
+    for (const auto byte : data) {
+        hash = (hash ^ byte) * fnv_prime;
+    }
+    return hash;
+}
+
+static auto mix(uint64_t value) noexcept -> uint64_t {
+    value += 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+dedup_cache::dedup_cache(const dedup_config& config) noexcept
+    : _window { std::chrono::duration_cast<std::chrono::nanoseconds>(config.window).count() } {
+
+    size_t capacity = max_probes;
+    while (capacity < config.capacity) {
+        capacity <<= 1;
+    }
+
+    _entries.resize(capacity);
+    _mask = capacity - 1;
+}
+
+auto dedup_cache::check(const frame_view& frame, clock::time_point now) noexcept -> bool {
+    const auto time = std::max<int64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count(), 1);
+
+    const auto payload_hash = fnv1a(frame.buffer, fnv_offset);
+    const auto routed = frame.info.source != 0;
+    const auto key =
+        routed ? mix(frame.info.source ^ mix(frame.info.seq)) : mix(payload_hash);
+    // Independent of the key for both kinds of frames
+    const auto fingerprint = static_cast<uint32_t>(mix(payload_hash ^ frame.buffer.size()) >> 32);
+
+    const auto make_entry = [&] {
+        return entry {
+            .key = key,
+            .fingerprint = fingerprint,
+            .module = frame.info.module,
+            .seen = time,
+        };
+    };
+
+    ++_stats.lookups;
+
+    entry* free = nullptr;
+    entry* oldest = nullptr;
+
+    for (size_t i = 0; i < max_probes; ++i) {
+        auto& slot = _entries[(key + i) & _mask];
+
+        if (!is_live(slot, time)) {
+            if (!free) {
+                free = &slot;
+            }
+            continue;
+        }
+
+        if (slot.key == key) {
+            if (slot.fingerprint != fingerprint) {
+                // Different frame under the same key, the newer one takes the slot
+                ++_stats.false_positives;
+            } else if (routed || slot.module != frame.info.module) {
+                ++_stats.duplicates;
+                return true;
+            }
+
+            slot = make_entry();
+            return false;
+        }
+
+        if (!oldest || slot.seen < oldest->seen) {
+            oldest = &slot;
+        }
+    }
+
+    if (!free) {
+        free = oldest;
+        ++_stats.evictions;
+    }
+
+    *free = make_entry();
+
+    return false;
+}
+
+auto dedup_cache::clear() noexcept -> void {
+    std::fill(_entries.begin(), _entries.end(), entry {});
+}
+
+auto dedup_cache::is_live(const entry& entry, int64_t now) const noexcept -> bool {
+    return entry.seen != 0 && now - entry.seen <= _window;
+}
+
+dedup_filter::dedup_filter(const dedup_config& config) noexcept
+    : _cache { config } {}
+
+auto dedup_filter::check(const frame_view& frame) noexcept -> bool {
+    std::lock_guard lock { _mut };
+
+    return _cache.check(frame, dedup_cache::clock::now());
+}
+
+auto dedup_filter::get_stats() const noexcept -> dedup_stats {
+    std::lock_guard lock { _mut };
+
+    return _cache.get_stats();
+}
+
+} // namespace kaonic::comm::mesh
@@ -0,0 +1,296 @@
+#include "kaonic/comm/mesh/fragmentation.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace kaonic::comm::mesh {
+
+constexpr static uint16_t fragment_magic = 0x464B;
+
+// Header layout, little-endian
+constexpr static size_t magic_offset = 0;
+constexpr static size_t index_offset = 2;
+constexpr static size_t count_offset = 3;
+constexpr static size_t id_offset = 4;
+constexpr static size_t offset_offset = 8;
+constexpr static size_t total_offset = 12;
+
+template <typename T>
+static auto put(uint8_t* dst, T value) noexcept -> void {
+    std::memcpy(dst, &value, sizeof(value));
+}
+
+template <typename T>
+static auto get(const uint8_t* src) noexcept -> T {
+    T value;
+    std::memcpy(&value, src, sizeof(value));
+    return value;
+}
+
+fragmenter::fragmenter(const fragmentation_config& config, size_t overhead) noexcept
+    : _fragment_size { std::max<size_t>(config.mtu, overhead + header_size + 1) - overhead
+                       - header_size }
+    , _max_payload { std::min(config.max_payload, _fragment_size * max_fragments) }
+    // Random first id, so a restarted node doesn't resume the ids of its last run
+    , _id { static_cast<uint32_t>(std::random_device {}()) } {}
+
+auto fragmenter::count(size_t size) const noexcept -> size_t {
+    if (size > _max_payload) {
+        return 0;
+    }
+
+    return std::max<size_t>((size + _fragment_size - 1) / _fragment_size, 1);
+}
+
+auto fragmenter::start(size_t size, fragment_header& header) noexcept -> error {
+    const auto fragments = count(size);
+    if (fragments == 0) {
+        return error::invalid_arg();
+    }
+
+    header = fragment_header {
+        .id = ++_id,
+        .index = 0,
+        .count = static_cast<uint8_t>(fragments),
+        .offset = 0,
+        .total = static_cast<uint32_t>(size),
+    };
+
+    ++_stats.messages_sent;
+    _stats.fragments_sent += fragments;
+
+    return error::ok();
+}
+
+auto fragmenter::fragment(const fragment_header& first, size_t index) const noexcept
+    -> fragment_header {
+    auto header = first;
+
+    header.index = static_cast<uint8_t>(index);
+    header.offset = static_cast<uint32_t>(index * _fragment_size);
+
+    return header;
+}
+
+auto fragmenter::length(const fragment_header& header) const noexcept -> size_t {
+    return std::min<size_t>(_fragment_size, header.total - header.offset);
+}
+
+auto fragmenter::encode(const fragment_header& header, span<uint8_t> buffer) noexcept -> void {
+    if (buffer.size() < header_size) {
+        return;
+    }
+
+    put(buffer.data() + magic_offset, fragment_magic);
+    put(buffer.data() + index_offset, header.index);
+    put(buffer.data() + count_offset, header.count);
+    put(buffer.data() + id_offset, header.id);
+    put(buffer.data() + offset_offset, header.offset);
+    put(buffer.data() + total_offset, header.total);
+}
+
+auto fragmenter::decode(span<const uint8_t> frame,
+                        fragment_header& header,
+                        span<const uint8_t>& payload) noexcept -> bool {
+    if (frame.size() < header_size
+        || get<uint16_t>(frame.data() + magic_offset) != fragment_magic) {
+        return false;
+    }
+
+    header = fragment_header {
+        .id = get<uint32_t>(frame.data() + id_offset),
+        .index = frame[index_offset],
+        .count = frame[count_offset],
+        .offset = get<uint32_t>(frame.data() + offset_offset),
+        .total = get<uint32_t>(frame.data() + total_offset),
+    };
+
+    payload = span<const uint8_t> { frame.data() + header_size, frame.size() - header_size };
+
+    return true;
+}
+
+reassembler::reassembler(const fragmentation_config& config) noexcept
+    : _config { config }
+    , _slots(std::max<size_t>(config.max_messages, 1)) {}
+
+auto reassembler::receive(const frame_view& frame,
+                          clock::time_point now,
+                          frame_view& message) noexcept -> bool {
+    fragment_header header;
+    span<const uint8_t> payload;
+
+    // Frames of nodes without fragmentation are delivered as they are
+    if (!fragmenter::decode(frame.buffer, header, payload)) {
+        message = frame;
+        return true;
+    }
+
+    ++_stats.fragments_received;
+
+    const auto total = static_cast<size_t>(header.total);
+
+    if (header.count == 0 || header.index >= header.count || total > _config.max_payload
+        || total > _config.max_memory || header.offset + payload.size() > total) {
+        ++_stats.rejected;
+        return false;
+    }
+
+    // Nothing to collect, the payload is passed on without a copy
+    if (header.count == 1) {
+        if (payload.size() != total) {
+            ++_stats.rejected;
+            return false;
+        }
+
+        ++_stats.reassembled;
+        message = frame_view { payload, frame.info };
+        return true;
+    }
+
+    auto slot = find(frame.info, header.id);
+
+    if (slot && (slot->count != header.count || slot->buffer.size() != total)) {
+        ++_stats.rejected;
+        return false;
+    }
+
+    if (!slot) {
+        if (slot = allocate(total); !slot) {
+            ++_stats.rejected;
+            return false;
+        }
+
+        slot->active = true;
+        slot->source = frame.info.source;
+        slot->module = frame.info.module;
+        slot->id = header.id;
+        slot->count = header.count;
+        slot->received = 0;
+        slot->stride = 0;
+        slot->fragments.reset();
+        slot->info = frame.info;
+    }
+
+    if (slot->fragments.test(header.index)) {
+        ++_stats.duplicates;
+        return false;
+    }
+
+    if (!fits(*slot, header, payload.size())) {
+        ++_stats.rejected;
+        return false;
+    }
+
+    std::copy(payload.begin(), payload.end(), slot->buffer.begin() + header.offset);
+
+    slot->fragments.set(header.index);
+    slot->updated = now;
+
+    if (header.index == 0) {
+        slot->info = frame.info;
+    }
+
+    if (++slot->received < slot->count) {
+        return false;
+    }
+
+    // Buffer stays as it is until the slot is taken again
+    release(*slot);
+
+    ++_stats.reassembled;
+    message = frame_view { slot->buffer, slot->info };
+
+    return true;
+}
+
+auto reassembler::expire(clock::time_point now) noexcept -> size_t {
+    size_t expired = 0;
+
+    for (auto& slot : _slots) {
+        if (slot.active && now - slot.updated > _config.timeout) {
+            release(slot);
+            ++expired;
+        }
+    }
+
+    _stats.timed_out += expired;
+
+    return expired;
+}
+
+auto reassembler::fits(slot& slot, const fragment_header& header, size_t size) noexcept -> bool {
+    const auto total = slot.buffer.size();
+    const auto last = header.index + 1 == slot.count;
+
+    auto stride = slot.stride;
+    if (stride == 0) {
+        // Last fragment may be shorter, its offset still tells the size of the others
+        stride = last ? header.offset / header.index : size;
+
+        if (stride == 0 || (slot.count - 1) * stride >= total || slot.count * stride < total) {
+            return false;
+        }
+    }
+
+    const auto offset = header.index * stride;
+    const auto length = last ? total - offset : stride;
+
+    if (header.offset != offset || size != length) {
+        return false;
+    }
+
+    slot.stride = stride;
+
+    return true;
+}
+
+auto reassembler::find(const frame_info& info, uint32_t id) noexcept -> slot* {
+    const auto found = std::find_if(_slots.begin(), _slots.end(), [&](const slot& slot) {
+        return slot.active && slot.id == id && slot.source == info.source
+               && slot.module == info.module;
+    });
+
+    return found != _slots.end() ? &*found : nullptr;
+}
+
+auto reassembler::allocate(size_t size) noexcept -> slot* {
+    if (size > _config.max_memory) {
+        return nullptr;
+    }
+
+    for (;;) {
+        const auto free = std::find_if(
+            _slots.begin(), _slots.end(), [](const slot& slot) { return !slot.active; });
+
+        if (free != _slots.end() && _memory + size <= _config.max_memory) {
+            free->buffer.resize(size);
+            _memory += size;
+            return &*free;
+        }
+
+        // Message that made progress last the longest ago is the least likely to complete
+        const auto oldest =
+            std::min_element(_slots.begin(), _slots.end(), [](const slot& a, const slot& b) {
+                if (a.active != b.active) {
+                    return a.active;
+                }
+                return a.updated < b.updated;
+            });
+
+        if (oldest == _slots.end() || !oldest->active) {
+            return nullptr;
+        }
+
+        release(*oldest);
+        ++_stats.evicted;
+    }
+}
+
+auto reassembler::release(slot& slot) noexcept -> void {
+    slot.active = false;
+    _memory -= slot.buffer.size();
+}
+
+} // namespace kaonic::comm::mesh
@@ -0,0 +1,177 @@
+#include "kaonic/comm/mesh/frame_pool.hpp"
+
+#include <algorithm>
+#include <new>
+
+#include "kaonic/comm/radio/radio.hpp"
+
+namespace kaonic::comm::mesh {
+
+static_assert(frame_pool::slot_size == data_max_size, "a pool slot has to fit any radio frame");
+
+frame_buffer::frame_buffer(frame_slot* slot) noexcept
+    : _slot { slot } {}
+
+frame_buffer::~frame_buffer() {
+    reset();
+}
+
+frame_buffer::frame_buffer(const frame_buffer& other) noexcept
+    : _slot { other._slot } {
+    if (_slot) {
+        _slot->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+frame_buffer::frame_buffer(frame_buffer&& other) noexcept
+    : _slot { other._slot } {
+    other._slot = nullptr;
+}
+
+frame_buffer& frame_buffer::operator=(const frame_buffer& other) noexcept {
+    if (this != &other) {
+        reset();
+
+        if (_slot = other._slot; _slot) {
+            _slot->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    return *this;
+}
+
+frame_buffer& frame_buffer::operator=(frame_buffer&& other) noexcept {
+    if (this != &other) {
+        reset();
+
+        _slot = other._slot;
+        other._slot = nullptr;
+    }
+
+    return *this;
+}
+
+auto frame_buffer::resize(size_t size) noexcept -> bool {
+    if (!_slot || size > _slot->capacity) {
+        return false;
+    }
+
+    _slot->size = size;
+
+    return true;
+}
+
+auto frame_buffer::reset() noexcept -> void {
+    if (_slot && _slot->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        frame_pool::release(_slot);
+    }
+
+    _slot = nullptr;
+}
+
+frame_pool::frame_pool(size_t count, size_t slot_capacity) noexcept
+    : _count { count }
+    , _slot_capacity { slot_capacity }
+    , _storage { new (std::nothrow) uint8_t[count * slot_capacity] }
+    , _slots { new (std::nothrow) frame_slot[count] } {
+
+    if (!_storage || !_slots) {
+        return;
+    }
+
+    for (size_t i = 0; i < _count; ++i) {
+        auto& slot = _slots[i];
+
+        slot.data = _storage.get() + i * _slot_capacity;
+        slot.capacity = _slot_capacity;
+        slot.pool = this;
+        slot.next = _free;
+
+        _free = &slot;
+    }
+
+    _available = _count;
+    _stats.capacity = _count;
+}
+
+auto frame_pool::allocate(size_t size) noexcept -> frame_buffer {
+    frame_slot* slot = nullptr;
+
+    {
+        std::lock_guard lock { _mut };
+
+        ++_stats.allocated;
+
+        if (size > _slot_capacity) {
+            ++_stats.oversized;
+        } else if (!_free) {
+            ++_stats.exhausted;
+        } else {
+            slot = _free;
+            _free = slot->next;
+            --_available;
+        }
+    }
+
+    if (!slot) {
+        slot = new (std::nothrow) frame_slot {};
+        if (!slot) {
+            return frame_buffer {};
+        }
+
+        slot->data = new (std::nothrow) uint8_t[std::max<size_t>(size, 1)];
+        if (!slot->data) {
+            delete slot;
+            return frame_buffer {};
+        }
+
+        slot->capacity = size;
+    }
+
+    slot->refs.store(1, std::memory_order_relaxed);
+    slot->size = size;
+    slot->next = nullptr;
+
+    return frame_buffer { slot };
+}
+
+auto frame_pool::copy(span<const uint8_t> data) noexcept -> frame_buffer {
+    auto buffer = allocate(data.size());
+
+    if (buffer) {
+        std::copy(data.begin(), data.end(), buffer.data());
+    }
+
+    return buffer;
+}
+
+auto frame_pool::get_stats() const noexcept -> frame_pool_stats {
+    std::lock_guard lock { _mut };
+
+    auto stats = _stats;
+    stats.available = _available;
+
+    return stats;
+}
+
+auto frame_pool::release(frame_slot* slot) noexcept -> void {
+    if (slot->pool) {
+        slot->pool->recycle(slot);
+        return;
+    }
+
+    delete[] slot->data;
+    delete slot;
+}
+
+auto frame_pool::recycle(frame_slot* slot) noexcept -> void {
+    std::lock_guard lock { _mut };
+
+    slot->size = 0;
+    slot->next = _free;
+
+    _free = slot;
+    ++_available;
+}
+
+} // namespace kaonic::comm::mesh
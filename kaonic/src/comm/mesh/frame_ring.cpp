@@ -0,0 +1,167 @@
+#include "kaonic/comm/mesh/frame_ring.hpp"
+
+#include <algorithm>
+
+namespace kaonic::comm::mesh {
+
+frame_ring::frame_ring(size_t capacity) noexcept {
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    _slots.resize(size);
+    _mask = size - 1;
+}
+
+auto frame_ring::publish(const frame& frame) noexcept -> void {
+    {
+        std::lock_guard lock { _mut };
+
+        if (_subscribers.empty()) {
+            return;
+        }
+
+        const auto seq = _head;
+        for (auto* subscriber : _subscribers) {
+            account(*subscriber, seq);
+        }
+
+        // Replaces the reference to the frame 'capacity' behind, no subscriber can reach it
+        _slots[seq & _mask] = frame;
+        _head = seq + 1;
+
+        for (auto* subscriber : _subscribers) {
+            if (subscriber->_on_publish) {
+                subscriber->_on_publish();
+            }
+        }
+    }
+
+    _cond.notify_all();
+}
+
+auto frame_ring::subscriber_count() const noexcept -> size_t {
+    std::lock_guard lock { _mut };
+
+    return _subscribers.size();
+}
+
+auto frame_ring::subscribe(frame_subscriber* subscriber) noexcept -> void {
+    std::lock_guard lock { _mut };
+
+    subscriber->_next = _head;
+    _subscribers.push_back(subscriber);
+}
+
+auto frame_ring::unsubscribe(frame_subscriber* subscriber) noexcept -> void {
+    std::lock_guard lock { _mut };
+
+    _subscribers.erase(std::remove(_subscribers.begin(), _subscribers.end(), subscriber),
+                       _subscribers.end());
+
+    // Buffers go back to the pool while nobody listens
+    if (_subscribers.empty()) {
+        std::fill(_slots.begin(), _slots.end(), frame {});
+    }
+}
+
+auto frame_ring::account(frame_subscriber& subscriber, uint64_t seq) noexcept -> void {
+    if (subscriber._disconnected) {
+        return;
+    }
+
+    if (subscriber._stop) {
+        // Ring wrapped around the backlog, its stalest frame is about to be replaced
+        if (seq - subscriber._next >= _slots.size()) {
+            ++subscriber._next;
+            ++subscriber._dropped;
+        }
+
+        // Nothing left of the backlog, the subscriber picks up from this frame
+        if (subscriber._next == *subscriber._stop) {
+            subscriber._dropped += seq - *subscriber._stop;
+            subscriber._next = seq;
+            subscriber._stop.reset();
+        }
+        return;
+    }
+
+    if (seq - subscriber._next < subscriber._depth) {
+        return;
+    }
+
+    switch (subscriber._policy) {
+        case overflow_policy::drop_oldest:
+            ++subscriber._next;
+            ++subscriber._dropped;
+            break;
+        case overflow_policy::drop_newest:
+            subscriber._stop = seq;
+            break;
+        case overflow_policy::disconnect:
+            subscriber._disconnected = true;
+            break;
+    }
+}
+
+frame_subscriber::frame_subscriber(frame_ring& ring,
+                                   const subscriber_config& config,
+                                   publish_callback on_publish) noexcept
+    : _ring { ring }
+    , _depth { std::clamp<size_t>(config.depth, 1, ring.capacity()) }
+    , _policy { config.policy }
+    , _on_publish { std::move(on_publish) } {
+    _ring.subscribe(this);
+}
+
+frame_subscriber::~frame_subscriber() {
+    _ring.unsubscribe(this);
+}
+
+auto frame_subscriber::pop(frame& frame, std::chrono::milliseconds timeout) noexcept -> bool {
+    std::unique_lock lock { _ring._mut };
+
+    if (!_ring._cond.wait_for(lock, timeout, [this] { return _disconnected || ready(); })) {
+        return false;
+    }
+
+    if (_disconnected) {
+        return false;
+    }
+
+    frame = _ring._slots[_next & _ring._mask];
+    ++_next;
+    ++_delivered;
+
+    return true;
+}
+
+auto frame_subscriber::is_disconnected() const noexcept -> bool {
+    std::lock_guard lock { _ring._mut };
+
+    return _disconnected;
+}
+
+auto frame_subscriber::get_stats() const noexcept -> subscriber_stats {
+    std::lock_guard lock { _ring._mut };
+
+    return subscriber_stats {
+        .delivered = _delivered,
+        .dropped = _dropped,
+        .lag = static_cast<size_t>(_stop.value_or(_ring._head) - _next),
+        .disconnected = _disconnected,
+    };
+}
+
+auto frame_subscriber::ready() noexcept -> bool {
+    if (_stop && _next == *_stop) {
+        _dropped += _ring._head - *_stop;
+        _next = _ring._head;
+        _stop.reset();
+    }
+
+    return _next != _ring._head;
+}
+
+} // namespace kaonic::comm::mesh
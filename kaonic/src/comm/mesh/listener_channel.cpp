@@ -0,0 +1,143 @@
+#include "kaonic/comm/mesh/listener_channel.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "kaonic/comm/mesh/network_receiver.hpp"
+#include "kaonic/common/logging.hpp"
+
+namespace kaonic::comm::mesh {
+
+using namespace std::chrono_literals;
+
+// Dispatch thread polls instead when there is no event to sleep on
+constexpr static auto fallback_poll_interval = 1ms;
+
+listener_channel::listener_channel(const std::shared_ptr<network_receiver>& listener,
+                                   const listener_config& config) noexcept
+    : _listener { listener }
+    , _policy { config.policy }
+    , _queue { config.queue_size } {
+
+    _event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_event_fd < 0) {
+        log::warn("[Listener Channel] can't create event, falling back to polling");
+    }
+
+    _thread = std::thread(&listener_channel::dispatch, this);
+}
+
+listener_channel::~listener_channel() {
+    _running.store(false);
+    _sleeping.store(true);
+    wake();
+
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+
+    if (_event_fd >= 0) {
+        ::close(_event_fd);
+    }
+}
+
+auto listener_channel::push(const frame& frame) noexcept -> void {
+    auto queued = frame;
+
+    while (!_queue.try_push(std::move(queued))) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+
+        if (_policy == drop_policy::newest) {
+            return;
+        }
+
+        // Oldest frame is taken from the consumer's end, its buffer goes back to the pool
+        mesh::frame oldest;
+        if (!_queue.try_pop(oldest)) {
+            _dropped.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Pairs with the fence in wait(), either the consumer sees the frame or it's woken
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    wake();
+}
+
+auto listener_channel::owns(const std::shared_ptr<network_receiver>& listener) const noexcept
+    -> bool {
+    return _listener.lock() == listener;
+}
+
+auto listener_channel::get_stats() const noexcept -> listener_stats {
+    return listener_stats {
+        .delivered = _delivered.load(std::memory_order_relaxed),
+        .dropped = _dropped.load(std::memory_order_relaxed),
+        .queued = _queue.size(),
+    };
+}
+
+auto listener_channel::dispatch() noexcept -> void {
+    frame frame;
+
+    while (_running.load()) {
+        while (_queue.try_pop(frame)) {
+            if (auto listener = _listener.lock()) {
+                listener->on_receive_pooled(frame);
+                _delivered.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // Buffer goes back to the pool before the next frame is waited for
+            frame.buffer.reset();
+        }
+
+        wait();
+    }
+}
+
+auto listener_channel::wait() noexcept -> void {
+    if (_event_fd < 0) {
+        std::this_thread::sleep_for(fallback_poll_interval);
+        return;
+    }
+
+    _sleeping.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // Frame pushed before the flag was seen
+    if (!_queue.empty() || !_running.load()) {
+        _sleeping.store(false);
+        return;
+    }
+
+    pollfd fd { .fd = _event_fd, .events = POLLIN, .revents = 0 };
+    while (::poll(&fd, 1, -1) < 0) {
+        if (errno != EINTR) {
+            log::warn("[Listener Channel] poll failed");
+            break;
+        }
+    }
+
+    uint64_t events = 0;
+    if (::read(_event_fd, &events, sizeof(events)) < 0 && errno != EAGAIN) {
+        log::warn("[Listener Channel] can't clear event");
+    }
+
+    _sleeping.store(false);
+}
+
+auto listener_channel::wake() noexcept -> void {
+    // Only a sleeping dispatch thread costs the producer a syscall
+    if (_event_fd < 0 || !_sleeping.exchange(false)) {
+        return;
+    }
+
+    const uint64_t event = 1;
+    if (::write(_event_fd, &event, sizeof(event)) < 0) {
+        log::warn("[Listener Channel] can't signal event");
+    }
+}
+
+} // namespace kaonic::comm::mesh
@@ -11,6 +11,7 @@
 #include <thread>
 #include <vector>
 
+#include "kaonic/common/copy_stats.hpp"
 #include "kaonic/common/logging.hpp"
 
 namespace kaonic::comm::mesh {
@@ -19,9 +20,72 @@ using namespace std::chrono_literals;
 
 constexpr auto nvmem_path = "/sys/bus/nvmem/devices/stm32-romem0/nvmem";
 
+// Aged routes and reassemblies are looked for this often, not on every update
+constexpr auto expire_interval = 100ms;
+
+// Frames in flight through the TX queue and the receive path of one network
+constexpr auto default_pool_size = 64;
+
+// Commands waiting for the update thread, posting waits for room past it
+constexpr auto command_queue_size = 64;
+constexpr auto command_retry_interval = 100us;
+
+// Reports a fragmented frame once, with the result of its last fragment or its first error
+static auto join_fragments(size_t count, tx_callback callback) -> tx_callback {
+    if (!callback) {
+        return {};
+    }
+
+    struct joined final {
+        std::mutex mut;
+        size_t remaining;
+        error err;
+        tx_callback callback;
+    };
+
+    auto state = std::make_shared<joined>();
+    state->remaining = count;
+    state->callback = std::move(callback);
+
+    return [state](const tx_result& result) {
+        tx_result joined_result;
+
+        {
+            std::lock_guard lock { state->mut };
+
+            if (!result.err.is_ok() && state->err.is_ok()) {
+                state->err = result.err;
+            }
+
+            if (--state->remaining > 0) {
+                return;
+            }
+
+            joined_result = result;
+            joined_result.err = state->err;
+        }
+
+        state->callback(joined_result);
+    };
+}
+
 network::network(const config& config, const context& context) noexcept
     : _config { config }
-    , _context { context } {
+    , _context { context }
+    , _rfnet_peers(std::max<size_t>(config.peer_capacity, 1))
+    , _node_id { make_node_id(config) }
+    , _router { config.routing, _node_id }
+    , _fragmenter { config.fragmentation, config.routing.enabled ? router::header_size : 0 }
+    , _reassembler { config.fragmentation }
+    , _tx_queue { std::max(config.tx_queue_size,
+                           config.fragmentation.enabled
+                               ? _fragmenter.count(_fragmenter.max_payload())
+                               : size_t { 1 }) }
+    , _commands { command_queue_size } {
+    if (!_context.pool) {
+        _context.pool = std::make_shared<frame_pool>(default_pool_size);
+    }
+
     if (!_context.net_interface) {
         log::error("[Network Mesh] net_interface wasn't initialized");
         return;
@@ -44,8 +108,8 @@ network::network(const config& config, const context& context) noexcept
             .on_receive = on_receive,
         },
         .peer_storage = {
-            .peers = peers,
-            .count = peers_storage_size,
+            .peers = _rfnet_peers.data(),
+            .count = _rfnet_peers.size(),
         },
         .mode = RFNET_MODE_TDD,
         .beacon_interval = static_cast<uint16_t>(config.beacon_interval.count()),
@@ -57,45 +121,533 @@ network::network(const config& config, const context& context) noexcept
 }
 
 network::~network() {
+    abort_transmits();
+
     rfnet_reset(&_rfnet);
 }
 
-auto network::update() noexcept -> void {
-    std::lock_guard lock { _mut };
+auto network::update() noexcept -> bool {
+    const auto self = std::this_thread::get_id();
 
+    // Waits out a caller that runs commands while no loop owned the network
+    for (auto owner = _owner.load(); owner != self; owner = _owner.load()) {
+        auto none = std::thread::id {};
+        if (_owner.compare_exchange_weak(none, self)) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+
+    run_commands();
+
+    _rx_received = false;
     rfnet_update(&_rfnet);
+
+    update_routing();
+    update_tx();
+
+    return _rx_received;
+}
+
+auto network::next_deadline() const noexcept -> clock::time_point {
+    const auto now = clock::now();
+
+    // rfnet's slot start and gap end aren't known outside of it, a queued frame is handed on
+    // every tick until it's sent. Same until the first beacon shows when the next one is due.
+    if (_tx_inflight || !_tx_queue.empty() || !_beacon_at) {
+        return now;
+    }
+
+    // Routing timers run on the steady clock, rfnet's clock may be stepped
+    const auto steady_now = router::clock::now();
+    auto routing_due = _expired_at + expire_interval - steady_now;
+    if (_config.routing.enabled) {
+        routing_due = std::min(routing_due, _router.next_hello() - steady_now);
+    }
+
+    return std::min(*_beacon_at + _config.beacon_interval,
+                    now + std::chrono::duration_cast<clock::duration>(routing_due));
+}
+
+auto network::release() noexcept -> void {
+    auto self = std::this_thread::get_id();
+    _owner.compare_exchange_strong(self, std::thread::id {});
+}
+
+auto network::push_command(command&& task) const noexcept -> void {
+    // Commands are rare, a full queue is waited out rather than failing a query
+    while (!_commands.try_push(std::move(task))) {
+        std::this_thread::sleep_for(command_retry_interval);
+    }
+
+    if (_context.on_tx_queued) {
+        _context.on_tx_queued();
+    }
+}
+
+auto network::try_run_commands() const noexcept -> bool {
+    const auto self = std::this_thread::get_id();
+
+    if (_owner.load() == self) {
+        run_commands();
+        return true;
+    }
+
+    auto none = std::thread::id {};
+    if (!_owner.compare_exchange_strong(none, self)) {
+        return false;
+    }
+
+    run_commands();
+
+    _owner.store(std::thread::id {});
+
+    return true;
+}
+
+auto network::run_commands() const noexcept -> void {
+    command task;
+    while (_commands.try_pop(task)) {
+        task();
+    }
+}
+
+auto network::transmit(const frame_view& frame) noexcept -> error {
+    tx_result result;
+    return transmit(frame, result);
+}
+
+auto network::transmit(const frame_view& frame, tx_result& result) noexcept -> error {
+    struct tx_waiter final {
+        std::mutex mut;
+        std::condition_variable cond;
+        bool done = false;
+        tx_result result;
+    };
+
+    tx_waiter waiter;
+
+    // Caller is blocked until the update thread is done with its payload, so it's not copied.
+    // Notified under the lock, the waiter may be gone as soon as it's released.
+    auto err = enqueue(
+        frame,
+        [&waiter](const tx_result& result) {
+            std::lock_guard lock { waiter.mut };
+            waiter.result = result;
+            waiter.done = true;
+            waiter.cond.notify_one();
+        },
+        tx_payload::borrowed);
+
+    if (!err.is_ok()) {
+        return err;
+    }
+
+    std::unique_lock lock { waiter.mut };
+    waiter.cond.wait(lock, [&waiter] { return waiter.done; });
+
+    result = waiter.result;
+
+    return result.err;
+}
+
+auto network::transmit_async(const frame_view& frame, tx_callback callback) noexcept -> error {
+    return enqueue(frame, std::move(callback), tx_payload::copied);
+}
+
+auto network::abort_transmits() noexcept -> void {
+    {
+        std::lock_guard lock { _tx_mut };
+        _tx_stopped = true;
+    }
+
+    _tx_cond.notify_all();
+
+    // Frame in flight belongs to the update thread
+    execute([this] {
+        if (_tx_inflight) {
+            complete(*_tx_inflight, error::fail());
+            _tx_inflight.reset();
+        }
+
+        tx_request request;
+        while (_tx_queue.try_pop(request)) {
+            complete(request, error::fail());
+        }
+    });
+}
+
+auto network::enqueue(const frame_view& frame,
+                      tx_callback callback,
+                      tx_payload payload) noexcept -> error {
+    // Relayed frames and advertisements already fit a frame
+    if (_config.fragmentation.enabled && payload != tx_payload::routed) {
+        return enqueue_fragments(frame, std::move(callback), payload);
+    }
+
+    tx_request request;
+
+    if (auto err = make_request(frame, std::nullopt, std::move(callback), payload, request);
+        !err.is_ok()) {
+        return err;
+    }
+
+    if (auto err = push_request(request, payload == tx_payload::borrowed); !err.is_ok()) {
+        return err;
+    }
+
+    if (_context.on_tx_queued) {
+        _context.on_tx_queued();
+    }
+
+    return error::ok();
+}
+
+auto network::enqueue_fragments(const frame_view& frame,
+                                tx_callback callback,
+                                tx_payload payload) noexcept -> error {
+    std::unique_lock lock { _fragment_mut };
+
+    const auto count = _fragmenter.count(frame.buffer.size());
+    if (count == 0) {
+        log::error("net: frame of {}B is too large to be fragmented", frame.buffer.size());
+        return error::invalid_arg();
+    }
+
+    // Copied fragments are queued all at once or not at all
+    const auto copy = payload != tx_payload::borrowed;
+    if (copy && !wait_tx_queue(false, count)) {
+        return error::not_ready();
+    }
+
+    fragment_header first;
+    if (auto err = _fragmenter.start(frame.buffer.size(), first); !err.is_ok()) {
+        return err;
+    }
+
+    auto done = count == 1 ? std::move(callback) : join_fragments(count, std::move(callback));
+
+    for (size_t i = 0; i < count; ++i) {
+
+        // Blocking senders take the queue a fragment at a time, it's drained as it fills
+        if (!copy && !wait_tx_queue(true, 1)) {
+            if (i == 0) {
+                return error::not_ready();
+            }
+
+            lock.unlock();
+
+            // Fragments already queued are completed by the abort, the rest fail here
+            for (; i < count && done; ++i) {
+                done(tx_result { .err = error::not_ready() });
+            }
+
+            return error::ok();
+        }
+
+        const auto header = _fragmenter.fragment(first, i);
+        const frame_view fragment {
+            span<const uint8_t> { frame.buffer.data() + header.offset, _fragmenter.length(header) },
+            frame.info,
+        };
+
+        tx_request request;
+
+        // Room for copied fragments was checked up front, senders of other frames may
+        // still take it in the meantime
+        auto err = make_request(fragment, header, done, payload, request);
+        if (err.is_ok()) {
+            err = push_request(request, !copy);
+        }
+
+        if (!err.is_ok()) {
+            if (i == 0) {
+                return err;
+            }
+
+            lock.unlock();
+
+            for (; i < count && done; ++i) {
+                done(tx_result { .err = err });
+            }
+
+            return error::ok();
+        }
+
+        if (_context.on_tx_queued) {
+            _context.on_tx_queued();
+        }
+    }
+
+    return error::ok();
+}
+
+auto network::wait_tx_queue(bool block, size_t count) noexcept -> bool {
+    // Frame with more fragments than the queue holds only fits into an empty queue
+    const auto limit = std::max({ _config.tx_queue_size, count, size_t { 1 } });
+
+    const auto has_room = [&] { return _tx_queue.size() + count <= limit; };
+
+    if (!block || _tx_stopped) {
+        return !_tx_stopped && has_room();
+    }
+
+    if (has_room()) {
+        return true;
+    }
+
+    std::unique_lock lock { _tx_mut };
+
+    // Pairs with the fence in notify_tx_waiters(), either the update thread sees the waiter
+    // or the waiter sees the room it made
+    _tx_waiters.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    _tx_cond.wait(lock, [&] { return _tx_stopped || has_room(); });
+
+    _tx_waiters.fetch_sub(1);
+
+    return !_tx_stopped;
+}
+
+auto network::make_request(const frame_view& frame,
+                           const std::optional<fragment_header>& fragment,
+                           tx_callback callback,
+                           tx_payload payload,
+                           tx_request& request) noexcept -> error {
+    frame_buffer storage;
+
+    if (payload != tx_payload::borrowed) {
+        if (storage = _context.pool->copy(frame.buffer); !storage) {
+            log::error("net: no buffer for a {}B frame", frame.buffer.size());
+            return error::fail();
+        }
+    }
+
+    request.routed = payload == tx_payload::routed;
+    request.fragment = fragment;
+    request.callback = std::move(callback);
+    request.queued_at = tx_clock::now();
+
+    if (storage) {
+        request.storage = std::move(storage);
+        request.frame = frame_view { request.storage, frame.info };
+    } else {
+        request.frame = frame;
+    }
+
+    return error::ok();
+}
+
+auto network::push_request(tx_request& request, bool block) noexcept -> error {
+    // Left as it is when the queue is full, a blocking sender tries again once there's room
+    while (wait_tx_queue(block, 1)) {
+        if (_tx_queue.try_push(std::move(request))) {
+            return error::ok();
+        }
+
+        if (!block) {
+            break;
+        }
+
+        std::this_thread::yield();
+    }
+
+    return error::not_ready();
+}
+
+auto network::update_tx() noexcept -> void {
+    _tx_stopped = false;
+
+    // rfnet frees its TX slot once the previous frame went out
+    if (rfnet_is_tx_free(&_rfnet) != 0) {
+        return;
+    }
+
+    std::optional<tx_request> sent;
+    sent.swap(_tx_inflight);
+
+    tx_request request;
+    if (_tx_queue.try_pop(request)) {
+        notify_tx_waiters();
+
+        request.sent_at = tx_clock::now();
+
+        if (auto err = send(request); !err.is_ok()) {
+            complete(request, err);
+        } else {
+            _tx_inflight.emplace(std::move(request));
+        }
+    }
+
+    // Next frame is with rfnet before the sender of the last one is called back
+    if (sent) {
+        complete(*sent, error::ok());
+    }
 }
 
-auto network::transmit(const frame& frame) noexcept -> error {
-    std::unique_lock lock { _mut };
+auto network::notify_tx_waiters() noexcept -> void {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (_tx_waiters.load() == 0) {
+        return;
+    }
+
+    // Taken only so a waiter can't miss the notification between its check and its wait
+    { std::lock_guard lock { _tx_mut }; }
+
+    _tx_cond.notify_all();
+}
+
+auto network::send(const tx_request& request) noexcept -> error {
+    auto buffer = request.frame.buffer;
+
+    const auto routed = _config.routing.enabled && !request.routed;
+
+    if (routed || request.fragment) {
+        // Routing header goes first, relays don't look past it
+        const auto route_size = routed ? router::header_size : 0;
+        const auto header_size = route_size + (request.fragment ? fragmenter::header_size : 0);
+
+        _tx_buffer.resize(header_size + buffer.size());
 
-    while (rfnet_is_tx_free(&_rfnet) != 0) {
-        lock.unlock();
-        std::this_thread::sleep_for(2ms);
-        lock.lock();
+        if (routed) {
+            const span<uint8_t> header { _tx_buffer.data(), router::header_size };
+            if (auto err = _router.encode(request.frame.info.destination, header); !err.is_ok()) {
+                log::warn("net: no route to {:016x}", request.frame.info.destination);
+                return err;
+            }
+        }
+
+        if (request.fragment) {
+            fragmenter::encode(
+                *request.fragment,
+                span<uint8_t> { _tx_buffer.data() + route_size, fragmenter::header_size });
+        }
+
+        std::copy(buffer.begin(), buffer.end(), _tx_buffer.begin() + header_size);
+        copy_counter::count_tx(buffer.size());
+
+        buffer = _tx_buffer;
     }
 
-    if (auto rc = rfnet_send(&_rfnet, frame.buffer.data(), frame.buffer.size()); rc != 0) {
+    // rfnet keeps its own copy of the payload until the slot to send it comes
+    if (auto rc = rfnet_send(&_rfnet, buffer.data(), buffer.size()); rc != 0) {
         log::error("net: tx not ready");
         return error::not_ready();
     }
 
+    copy_counter::count_tx(buffer.size());
+
     return error::ok();
 }
 
-auto network::get_stats() noexcept -> stats {
-    std::lock_guard lock { _mut };
+auto network::update_routing() noexcept -> void {
+    const auto now = router::clock::now();
 
-    rfnet_stats stat;
+    if (now - _expired_at >= expire_interval) {
+        _router.expire(now);
+        _reassembler.expire(now);
+        _expired_at = now;
+    }
 
-    rfnet_get_stats(&_rfnet, &stat);
+    if (_config.routing.enabled && _router.make_hello(now, _route_buffer)) {
+        if (auto err = enqueue(frame_view { _route_buffer }, {}, tx_payload::routed);
+            !err.is_ok()) {
+            log::warn("net: route advertisement dropped, tx queue is full");
+        }
+    }
+}
 
-    return stats {
-        .tx_speed = stat.tx_speed,
-        .rx_speed = stat.rx_speed,
-        .rx_counter = stat.rx_counter,
-        .tx_counter = stat.tx_counter,
-    };
+auto network::receive_routed(const frame_view& frame) noexcept -> void {
+    const auto now = router::clock::now();
+
+    auto info = frame.info;
+    span<const uint8_t> payload;
+
+    switch (_router.receive(frame.buffer, info, payload, _route_buffer, now)) {
+    case route_action::deliver:
+        deliver(frame_view { payload, info });
+        break;
+    case route_action::forward:
+        // Relayed straight from the receive path, nothing is handed to the clients
+        if (auto err = enqueue(frame_view { _route_buffer }, {}, tx_payload::routed);
+            !err.is_ok()) {
+            log::warn("net: relayed frame dropped, tx queue is full");
+        }
+        break;
+    case route_action::hello:
+        // Advertised routes are taken in by the router itself
+    case route_action::drop:
+        break;
+    }
+}
+
+auto network::deliver(const frame_view& frame) noexcept -> void {
+    if (!_config.fragmentation.enabled) {
+        _context.receiver->on_receive(frame);
+        return;
+    }
+
+    frame_view message;
+    if (_reassembler.receive(frame, reassembler::clock::now(), message)) {
+        _context.receiver->on_receive(message);
+    }
+}
+
+auto network::get_routes() const -> std::vector<route> {
+    return execute([this] { return _router.routes(); });
+}
+
+auto network::get_routing_stats() const noexcept -> routing_stats {
+    return execute([this] { return _router.get_stats(); });
+}
+
+auto network::get_fragmentation_stats() const noexcept -> fragmentation_stats {
+    auto stats = execute([this] { return _reassembler.get_stats(); });
+
+    // Sender side, the update thread is never kept waiting for it
+    std::lock_guard lock { _fragment_mut };
+    const auto sent = _fragmenter.get_stats();
+
+    stats.messages_sent = sent.messages_sent;
+    stats.fragments_sent = sent.fragments_sent;
+
+    return stats;
+}
+
+auto network::complete(tx_request& request, const error& err) noexcept -> void {
+    using namespace std::chrono;
+
+    const auto now = tx_clock::now();
+
+    tx_result result { .err = err };
+
+    if (request.sent_at != tx_clock::time_point {}) {
+        result.queue_time = duration_cast<microseconds>(request.sent_at - request.queued_at);
+        result.send_time = duration_cast<microseconds>(now - request.sent_at);
+    } else {
+        result.queue_time = duration_cast<microseconds>(now - request.queued_at);
+    }
+
+    if (request.callback) {
+        request.callback(result);
+    }
+}
+
+auto network::get_stats() noexcept -> stats {
+    return execute([this] {
+        rfnet_stats stat;
+
+        rfnet_get_stats(&_rfnet, &stat);
+
+        return stats {
+            .tx_speed = stat.tx_speed,
+            .rx_speed = stat.rx_speed,
+            .rx_counter = stat.rx_counter,
+            .tx_counter = stat.tx_counter,
+        };
+    });
 }
 
 auto network::generate_id() noexcept -> uint64_t {
@@ -123,39 +675,51 @@ auto network::generate_id() noexcept -> uint64_t {
     return uid;
 }
 
-auto network::tx(void* ctx, void* data, size_t len) noexcept -> int {
-    auto& self = *reinterpret_cast<network*>(ctx);
+auto network::make_node_id(const config& config) noexcept -> uint64_t {
+    auto id = generate_id();
+
+    id &= ~(static_cast<rfnet_node_id_t>(0x0F));
+    id |= static_cast<rfnet_node_id_t>(config.id_base);
 
-    auto data_ptr = reinterpret_cast<uint8_t*>(data);
+    return id;
+}
 
-    self.net_frame.buffer.resize(len);
+auto network::tx(void* ctx, void* data, size_t len) noexcept -> int {
+    auto& self = *reinterpret_cast<network*>(ctx);
 
-    std::copy(data_ptr, data_ptr + len, self.net_frame.buffer.begin());
+    const span<const uint8_t> buffer { reinterpret_cast<const uint8_t*>(data), len };
 
-    if (auto err = self._context.net_interface->transmit(self.net_frame); !err.is_ok()) {
+    if (auto err = self._context.net_interface->transmit(buffer); !err.is_ok()) {
         log::error("net: transmit failed");
         return -1;
     }
 
+    // Nothing of ours is with rfnet, so it's rfnet's own frame. Only the first one past the
+    // due time is taken for the beacon, anything else it sends doesn't push the deadline out.
+    const auto now = clock::now();
+    if (!self._tx_inflight
+        && (!self._beacon_at || now >= *self._beacon_at + self._config.beacon_interval)) {
+        self._beacon_at = now;
+    }
+
     return 0;
 }
 
 auto network::rx(void* ctx, void* data, size_t max_len) noexcept -> int {
     auto& self = *reinterpret_cast<network*>(ctx);
 
-    auto data_ptr = reinterpret_cast<uint8_t*>(data);
+    const span<uint8_t> buffer { reinterpret_cast<uint8_t*>(data), max_len };
 
-    if (auto err = self._context.net_interface->receive(self.net_frame); !err.is_ok()) {
+    // Radio fills rfnet's receive buffer directly
+    size_t len = 0;
+    if (auto err = self._context.net_interface->receive(buffer, len, self._rx_info);
+        !err.is_ok()) {
         return -1;
     }
 
-    if (self.net_frame.buffer.size() > max_len) {
-        return -1;
-    }
+    self._rx_received = true;
 
-    std::copy(self.net_frame.buffer.begin(), self.net_frame.buffer.end(), data_ptr);
-
-    return self.net_frame.buffer.size();
+    return static_cast<int>(len);
 }
 
 auto network::time(void* ctx) noexcept -> rfnet_time_t {
@@ -163,17 +727,14 @@ auto network::time(void* ctx) noexcept -> rfnet_time_t {
     // clock_gettime(CLOCK_MONOTONIC, &ts);
     // return static_cast<rfnet_time_t>(ts.tv_sec * 1000LLU + ts.tv_nsec / 1000000LLU);
     return static_cast<rfnet_time_t>(
-        std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::high_resolution_clock::now().time_since_epoch())
+        std::chrono::duration_cast<std::chrono::milliseconds>(clock::now().time_since_epoch())
             .count());
 }
 
 auto network::gen_id(void* ctx, rfnet_node_id_t* id) noexcept -> void {
     if (id) {
-        auto& self = *reinterpret_cast<network*>(ctx);
-        *id = generate_id();
-        *id &= ~(static_cast<rfnet_node_id_t>(0x0F));
-        *id |= static_cast<rfnet_node_id_t>(self._config.id_base);
+        // Same id as the routing layer uses
+        *id = reinterpret_cast<network*>(ctx)->_node_id;
     }
 }
 
@@ -182,14 +743,22 @@ auto network::on_send(void* ctx) noexcept -> void {}
 auto network::on_receive(void* ctx, const void* data, size_t len) noexcept -> void {
     auto& self = *reinterpret_cast<network*>(ctx);
 
-    auto data_ptr = reinterpret_cast<const uint8_t*>(data);
+    // Receivers borrow the payload from rfnet's buffer and copy it only if they keep it
+    const frame_view frame {
+        span<const uint8_t> { reinterpret_cast<const uint8_t*>(data), len },
+        self._rx_info,
+    };
 
-    self.net_frame.buffer.resize(len);
-    std::copy(data_ptr, data_ptr + len, self.net_frame.buffer.begin());
+    if (!self._context.receiver) {
+        return;
+    }
 
-    if (self._context.receiver) {
-        self._context.receiver->on_receive(self.net_frame);
+    if (self._config.routing.enabled) {
+        self.receive_routed(frame);
+        return;
     }
+
+    self.deliver(frame);
 }
 
 } // namespace kaonic::comm::mesh
@@ -1,26 +1,106 @@
 #include "kaonic/comm/mesh/network_receiver.hpp"
 
+#include "kaonic/common/copy_stats.hpp"
 #include "kaonic/common/logging.hpp"
 
 namespace kaonic::comm::mesh {
 
+// Frames in flight to listeners when the broadcaster isn't given the service's pool
+constexpr static size_t default_pool_size = 64;
+
+network_broadcast_receiver::network_broadcast_receiver(
+    const dedup_config& dedup, const std::shared_ptr<frame_pool>& pool) noexcept
+    : network_broadcast_receiver { std::make_shared<dedup_filter>(dedup), pool } {}
+
+network_broadcast_receiver::network_broadcast_receiver(
+    const std::shared_ptr<dedup_filter>& dedup, const std::shared_ptr<frame_pool>& pool) noexcept
+    : _pool { pool ? pool : std::make_shared<frame_pool>(default_pool_size) }
+    , _dedup { dedup ? dedup : std::make_shared<dedup_filter>(dedup_config {}) } {}
+
+network_broadcast_receiver::~network_broadcast_receiver() {
+    std::lock_guard lock { _mut };
+
+    // Dispatch threads are joined before the listeners and the pool go away
+    _listeners.clear();
+}
+
 auto network_broadcast_receiver::attach_listener(
-    const std::shared_ptr<network_receiver>& listener) noexcept -> void {
-    if (listener) {
-        _listeners.push_back(listener);
+    const std::shared_ptr<network_receiver>& listener, const listener_config& config) noexcept
+    -> void {
+    if (!listener) {
+        return;
     }
-}
 
-auto network_broadcast_receiver::on_receive(const frame& frame) -> void {
-    for (auto& listener_ptr : _listeners) {
-        auto listener = listener_ptr.lock();
+    std::lock_guard lock { _mut };
 
-        if (!listener) {
-            log::error("[Radio Broadcaster] Listener is not initialized");
-            continue;
+    for (const auto& channel : _listeners) {
+        if (channel->owns(listener)) {
+            return;
         }
+    }
+
+    _listeners.push_back(std::make_unique<listener_channel>(listener, config));
+}
+
+auto network_broadcast_receiver::on_receive(const frame_view& frame) -> void {
+    // Dropped before any listener copies the payload
+    if (_dedup->check(frame)) {
+        return;
+    }
+
+    std::lock_guard lock { _mut };
+
+    if (_listeners.empty()) {
+        return;
+    }
+
+    // The only copy of the payload on its way to the listeners
+    mesh::frame pooled { _pool->copy(frame.buffer), frame.info };
+    if (!pooled.buffer) {
+        log::error("[Radio Broadcaster] No buffer for a {}B frame", frame.buffer.size());
+        return;
+    }
+
+    copy_counter::count_rx(frame.buffer.size());
+
+    dispatch(pooled);
+}
+
+auto network_broadcast_receiver::on_receive_pooled(const frame& frame) -> void {
+    if (_dedup->check(frame)) {
+        return;
+    }
+
+    std::lock_guard lock { _mut };
+
+    if (_listeners.empty()) {
+        return;
+    }
+
+    dispatch(frame);
+}
+
+auto network_broadcast_receiver::get_dedup_stats() const noexcept -> dedup_stats {
+    return _dedup->get_stats();
+}
+
+auto network_broadcast_receiver::get_listener_stats() const -> std::vector<listener_stats> {
+    std::lock_guard lock { _mut };
+
+    std::vector<listener_stats> stats;
+    stats.reserve(_listeners.size());
+
+    for (const auto& channel : _listeners) {
+        stats.push_back(channel->get_stats());
+    }
+
+    return stats;
+}
 
-        listener->on_receive(frame);
+auto network_broadcast_receiver::dispatch(const frame& frame) -> void {
+    // Queued without blocking, a listener that can't keep up drops frames of its own
+    for (const auto& channel : _listeners) {
+        channel->push(frame);
     }
 }
 
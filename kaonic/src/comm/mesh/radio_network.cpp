@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <chrono>
+#include <sys/prctl.h>
 #include <unistd.h>
 
 #include "kaonic/common/logging.hpp"
@@ -10,7 +11,14 @@ using namespace std::chrono_literals;
 
 namespace kaonic::comm::mesh {
 
-constexpr static auto rx_timeout = 1ms;
+// Update loop sleeps until there's something to receive, so the radio isn't waited on
+constexpr static auto rx_timeout = 0ms;
+
+// rfnet's clock has millisecond resolution, every one of its deadlines is on a tick
+constexpr static auto update_tick = 1ms;
+
+// Lets the kernel fire the update timer this late, the default slack is 50us
+constexpr static auto update_timer_slack = std::chrono::nanoseconds { 1000 };
 
 radio_network_interface::radio_network_interface(const std::shared_ptr<radio>& radio) noexcept
     : _radio { radio } {
@@ -19,47 +27,50 @@ radio_network_interface::radio_network_interface(const std::shared_ptr<radio>& r
     }
 }
 
-auto radio_network_interface::transmit(const frame& frame) -> error {
-    if (frame.buffer.size() > sizeof(_tx_frame.data)) {
+auto radio_network_interface::transmit(span<const uint8_t> data) -> error {
+    if (data.size() > data_max_size) {
         log::error("[Radio Network Interface] Unable to transmit: max frame size is {}",
-                   sizeof(_tx_frame.data));
+                   data_max_size);
         return error::invalid_arg();
     }
 
-    std::copy(frame.buffer.begin(), frame.buffer.end(), _tx_frame.data);
-    _tx_frame.len = frame.buffer.size();
-
-    if (auto err = _radio->transmit(_tx_frame); !err.is_ok()) {
+    if (auto err = _radio->transmit(data); !err.is_ok()) {
         return err;
     }
 
     return error::ok();
 }
 
-auto radio_network_interface::receive(frame& frame) -> error {
+auto radio_network_interface::receive(span<uint8_t> buffer, size_t& len, frame_info& info)
+    -> error {
 
-    if (auto err = _radio->receive(_rx_frame, rx_timeout); !err.is_ok()) {
+    radio_rx_info rx_info;
+    if (auto err = _radio->receive(buffer, len, rx_info, rx_timeout); !err.is_ok()) {
         return error::timeout();
     }
 
-    frame.buffer.resize(_rx_frame.len);
-
-    std::copy(_rx_frame.data, _rx_frame.data + _rx_frame.len, frame.buffer.begin());
+    info.rssi = rx_info.rssi;
+    info.edv = rx_info.edv;
+    info.timestamp = rx_info.timestamp;
 
     return error::ok();
 }
 
 radio_network::radio_network(const config& config,
                              const std::shared_ptr<radio>& radio,
-                             const std::shared_ptr<network_receiver>& receiver) noexcept
+                             const std::shared_ptr<network_receiver>& receiver,
+                             const std::shared_ptr<frame_pool>& pool) noexcept
     : _radio { radio }
     , _network_interface { std::make_shared<radio_network_interface>(radio) }
     , _network_receiver { receiver }
+    , _scheduler { update_tick }
     , _network_mesh {
         config,
         context {
             std::make_shared<radio_network_interface>(_radio),
             _network_receiver,
+            [this]() { _scheduler.notify(); },
+            pool,
         },
     } {
     if (!_radio) {
@@ -78,8 +89,9 @@ auto radio_network::start() -> error {
         return error::precondition_failed();
     }
 
-    _update_thread = std::thread(&radio_network::update, this);
+    // Set before the thread starts so its loop doesn't exit right away
     _running.store(true);
+    _update_thread = std::thread(&radio_network::update, this);
 
     return error::ok();
 }
@@ -90,37 +102,81 @@ auto radio_network::stop() -> error {
     }
 
     _running.store(false);
+    _scheduler.notify();
 
     if (_update_thread.joinable()) {
         _update_thread.join();
     }
 
+    // Nothing drains the TX queue anymore
+    _network_mesh.abort_transmits();
+
     return error::ok();
 }
 
 auto radio_network::configure(const radio_config& config) -> error {
-    return _radio->configure(config);
+    // Applied between two updates, the radio isn't reconfigured in the middle of a slot
+    return _network_mesh.execute([this, &config] { return _radio->configure(config); });
 }
 
-auto radio_network::transmit(const frame& frame) -> error {
+auto radio_network::transmit(const frame_view& frame) -> error {
     return _network_mesh.transmit(frame);
 }
 
+auto radio_network::transmit(const frame_view& frame, tx_result& result) -> error {
+    return _network_mesh.transmit(frame, result);
+}
+
+auto radio_network::transmit_async(const frame_view& frame, tx_callback callback) -> error {
+    return _network_mesh.transmit_async(frame, std::move(callback));
+}
+
+auto radio_network::get_stats() -> stats {
+    return _network_mesh.get_stats();
+}
+
+auto radio_network::node_id() const noexcept -> uint64_t {
+    return _network_mesh.node_id();
+}
+
+auto radio_network::get_routes() const -> std::vector<route> {
+    return _network_mesh.get_routes();
+}
+
+auto radio_network::get_fragmentation_stats() const noexcept -> fragmentation_stats {
+    return _network_mesh.get_fragmentation_stats();
+}
+
 auto radio_network::update() noexcept -> void {
 
-    auto report_time = std::chrono::system_clock::now();
+    if (prctl(PR_SET_TIMERSLACK, update_timer_slack.count()) != 0) {
+        log::warn("[Radio Network] can't set timer slack");
+    }
+
+    // rfnet doesn't read the radio in every update, a frame it left waiting keeps the RX event
+    // set. The event isn't polled again before the next tick, the loop would spin on it.
+    bool poll_rx = true;
 
     while (_running) {
 
-        _network_mesh.update();
+        // More received frames may be waiting without a fresh RX event
+        if (_network_mesh.update()) {
+            poll_rx = true;
+            continue;
+        }
 
-        {
-            struct timespec ts;
-            ts.tv_sec = 0;
-            ts.tv_nsec = 10000;
-            clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, nullptr);
+        auto wakeup = update_wakeup::tick;
+        if (poll_rx) {
+            wakeup = _scheduler.wait(_network_mesh.next_deadline(), _radio->rx_event_fd());
+        } else {
+            wakeup = _scheduler.wait(network::clock::now(), -1);
         }
+
+        poll_rx = wakeup != update_wakeup::rx;
     }
+
+    // Queries and aborts are run by the threads posting them from now on
+    _network_mesh.release();
 }
 
 } // namespace kaonic::comm::mesh
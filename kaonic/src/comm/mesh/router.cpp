@@ -0,0 +1,327 @@
+#include "kaonic/comm/mesh/router.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace kaonic::comm::mesh {
+
+constexpr static uint16_t route_magic = 0x524B;
+
+enum class route_frame_type : uint8_t {
+    data = 1,
+    hello = 2,
+};
+
+// Header layout, little-endian
+constexpr static size_t magic_offset = 0;
+constexpr static size_t type_offset = 2;
+constexpr static size_t ttl_offset = 3;
+constexpr static size_t seq_offset = 4;
+constexpr static size_t source_offset = 8;
+constexpr static size_t destination_offset = 16;
+constexpr static size_t next_hop_offset = 24;
+
+// Advertised route: destination, advertiser's next hop, hops, metric
+constexpr static size_t hello_entry_size = 19;
+constexpr static size_t hello_max_entries = 64;
+
+// Cost of a link heard at -70 dBm or better, weaker links cost 1 more per dB
+constexpr static uint16_t link_cost_base = 10;
+constexpr static uint16_t link_cost_max = 60;
+constexpr static uint16_t link_cost_unknown = 20;
+
+template <typename T>
+static auto put(uint8_t* dst, T value) noexcept -> void {
+    std::memcpy(dst, &value, sizeof(value));
+}
+
+template <typename T>
+static auto get(const uint8_t* src) noexcept -> T {
+    T value;
+    std::memcpy(&value, src, sizeof(value));
+    return value;
+}
+
+static auto link_cost(const frame_info& info) noexcept -> uint16_t {
+    if (info.rssi == 127) {
+        return link_cost_unknown;
+    }
+
+    const auto penalty = std::max(0, -70 - static_cast<int>(info.rssi));
+    return static_cast<uint16_t>(std::min<int>(link_cost_base + penalty, link_cost_max));
+}
+
+static auto write_header(uint8_t* header,
+                         route_frame_type type,
+                         uint8_t ttl,
+                         uint32_t seq,
+                         uint64_t source,
+                         uint64_t destination,
+                         uint64_t next_hop) noexcept -> void {
+    put(header + magic_offset, route_magic);
+    put(header + type_offset, static_cast<uint8_t>(type));
+    put(header + ttl_offset, ttl);
+    put(header + seq_offset, seq);
+    put(header + source_offset, source);
+    put(header + destination_offset, destination);
+    put(header + next_hop_offset, next_hop);
+}
+
+router::router(const routing_config& config, uint64_t node_id) noexcept
+    : _config { config }
+    , _node_id { node_id }
+    , _jitter { node_id } {
+    _routes.reserve(_config.max_routes);
+}
+
+auto router::encode(uint64_t destination, span<uint8_t> header) noexcept -> error {
+    if (header.size() < header_size) {
+        return error::invalid_arg();
+    }
+
+    auto next_hop = broadcast_id;
+    uint8_t ttl = 1;
+
+    if (destination != broadcast_id) {
+        const auto route = find(destination);
+        if (!route) {
+            ++_stats.no_route;
+            return error::not_ready();
+        }
+
+        next_hop = route->next_hop;
+        ttl = _config.max_hops;
+    }
+
+    write_header(
+        header.data(), route_frame_type::data, ttl, ++_seq, _node_id, destination, next_hop);
+
+    ++_stats.originated;
+
+    return error::ok();
+}
+
+auto router::receive(span<const uint8_t> frame,
+                     frame_info& info,
+                     span<const uint8_t>& payload,
+                     std::vector<uint8_t>& forward,
+                     clock::time_point now) noexcept -> route_action {
+
+    // Frames of nodes without routing are delivered as they are
+    if (frame.size() < header_size || get<uint16_t>(frame.data() + magic_offset) != route_magic) {
+        payload = frame;
+        return route_action::deliver;
+    }
+
+    const auto type = static_cast<route_frame_type>(frame[type_offset]);
+    const auto ttl = frame[ttl_offset];
+    const auto seq = get<uint32_t>(frame.data() + seq_offset);
+    const auto source = get<uint64_t>(frame.data() + source_offset);
+    const auto destination = get<uint64_t>(frame.data() + destination_offset);
+    const auto next_hop = get<uint64_t>(frame.data() + next_hop_offset);
+
+    if (source == _node_id) {
+        return route_action::drop;
+    }
+
+    info.source = source;
+    info.destination = destination;
+    info.seq = seq;
+
+    if (type == route_frame_type::hello) {
+        ++_stats.hellos_received;
+        learn(source, info, frame.subspan(header_size), now);
+        return route_action::hello;
+    }
+
+    if (type != route_frame_type::data) {
+        return route_action::drop;
+    }
+
+    // Unicast frames are only taken by the neighbour they were sent to
+    if (next_hop != _node_id && next_hop != broadcast_id) {
+        ++_stats.overheard;
+        return route_action::drop;
+    }
+
+    if (destination == _node_id || destination == broadcast_id) {
+        payload = frame.subspan(header_size);
+        ++_stats.delivered;
+        return route_action::deliver;
+    }
+
+    if (ttl <= 1) {
+        ++_stats.ttl_expired;
+        return route_action::drop;
+    }
+
+    const auto route = find(destination);
+    if (!route || is_expired(*route, now)) {
+        ++_stats.no_route;
+        return route_action::drop;
+    }
+
+    forward.assign(frame.begin(), frame.end());
+    put(forward.data() + ttl_offset, static_cast<uint8_t>(ttl - 1));
+    put(forward.data() + next_hop_offset, route->next_hop);
+
+    ++_stats.forwarded;
+
+    return route_action::forward;
+}
+
+auto router::make_hello(clock::time_point now, std::vector<uint8_t>& hello) noexcept -> bool {
+    if (now < _next_hello) {
+        return false;
+    }
+
+    const auto jitter_range = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(_config.hello_interval).count() / 4);
+    const auto jitter =
+        std::chrono::microseconds { jitter_range ? _jitter() % jitter_range : 0 };
+
+    _next_hello = now + _config.hello_interval - jitter;
+
+    const auto entries = std::min(_routes.size(), hello_max_entries);
+
+    hello.resize(header_size + sizeof(uint16_t) + entries * hello_entry_size);
+
+    write_header(hello.data(),
+                 route_frame_type::hello,
+                 1,
+                 ++_seq,
+                 _node_id,
+                 broadcast_id,
+                 broadcast_id);
+
+    auto entry = hello.data() + header_size;
+    put(entry, static_cast<uint16_t>(entries));
+    entry += sizeof(uint16_t);
+
+    // Table is larger than one advertisement only with hundreds of nodes, the nearest go first
+    std::vector<const route*> advertised;
+    advertised.reserve(_routes.size());
+    for (const auto& [destination, route] : _routes) {
+        advertised.push_back(&route);
+    }
+
+    std::partial_sort(advertised.begin(),
+                      advertised.begin() + entries,
+                      advertised.end(),
+                      [](const route* lhs, const route* rhs) { return lhs->hops < rhs->hops; });
+
+    for (size_t i = 0; i < entries; ++i) {
+        const auto& route = *advertised[i];
+        put(entry, route.destination);
+        put(entry + 8, route.next_hop);
+        put(entry + 16, route.hops);
+        put(entry + 17, route.metric);
+        entry += hello_entry_size;
+    }
+
+    ++_stats.hellos_sent;
+
+    return true;
+}
+
+auto router::expire(clock::time_point now) noexcept -> size_t {
+    size_t expired = 0;
+
+    for (auto it = _routes.begin(); it != _routes.end();) {
+        if (is_expired(it->second, now)) {
+            it = _routes.erase(it);
+            ++expired;
+        } else {
+            ++it;
+        }
+    }
+
+    return expired;
+}
+
+auto router::find(uint64_t destination) const noexcept -> const route* {
+    const auto it = _routes.find(destination);
+
+    return it != _routes.end() ? &it->second : nullptr;
+}
+
+auto router::routes() const -> std::vector<route> {
+    std::vector<route> routes;
+    routes.reserve(_routes.size());
+
+    for (const auto& [destination, route] : _routes) {
+        routes.push_back(route);
+    }
+
+    return routes;
+}
+
+auto router::learn(uint64_t neighbour,
+                   const frame_info& info,
+                   span<const uint8_t> hello,
+                   clock::time_point now) noexcept -> void {
+
+    const auto cost = link_cost(info);
+
+    consider(route {
+        .destination = neighbour,
+        .next_hop = neighbour,
+        .hops = 1,
+        .metric = cost,
+        .updated = now,
+    });
+
+    if (hello.size() < sizeof(uint16_t)) {
+        return;
+    }
+
+    const auto count = std::min<size_t>(get<uint16_t>(hello.data()),
+                                        (hello.size() - sizeof(uint16_t)) / hello_entry_size);
+
+    auto entry = hello.data() + sizeof(uint16_t);
+
+    for (size_t i = 0; i < count; ++i, entry += hello_entry_size) {
+        const auto destination = get<uint64_t>(entry);
+        const auto next_hop = get<uint64_t>(entry + 8);
+        const auto hops = get<uint8_t>(entry + 16);
+        const auto metric = get<uint16_t>(entry + 17);
+
+        // Routes through this node would only lead back here
+        if (destination == _node_id || next_hop == _node_id || hops >= _config.max_hops) {
+            continue;
+        }
+
+        consider(route {
+            .destination = destination,
+            .next_hop = neighbour,
+            .hops = static_cast<uint8_t>(hops + 1),
+            .metric = static_cast<uint16_t>(std::min<uint32_t>(metric + cost, UINT16_MAX)),
+            .updated = now,
+        });
+    }
+}
+
+auto router::consider(const route& candidate) noexcept -> void {
+    const auto it = _routes.find(candidate.destination);
+
+    if (it == _routes.end()) {
+        if (_routes.size() < _config.max_routes) {
+            _routes.emplace(candidate.destination, candidate);
+        }
+        return;
+    }
+
+    auto& current = it->second;
+
+    // Current next hop always refreshes its route, others have to offer a better one
+    if (current.next_hop == candidate.next_hop || candidate.metric < current.metric
+        || is_expired(current, candidate.updated)) {
+        current = candidate;
+    }
+}
+
+auto router::is_expired(const route& route, clock::time_point now) const noexcept -> bool {
+    return now - route.updated > _config.route_timeout;
+}
+
+} // namespace kaonic::comm::mesh
@@ -0,0 +1,120 @@
+#include "kaonic/comm/mesh/update_scheduler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <thread>
+#include <unistd.h>
+
+#include "kaonic/common/logging.hpp"
+
+namespace kaonic::comm::mesh {
+
+using namespace std::chrono_literals;
+
+update_scheduler::update_scheduler(std::chrono::microseconds tick) noexcept
+    : _tick { std::max<std::chrono::nanoseconds>(tick, 1us) } {
+
+    _timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (_timer_fd < 0) {
+        log::warn("[Update Scheduler] can't create timer, falling back to sleep");
+    }
+
+    _notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_notify_fd < 0) {
+        log::warn("[Update Scheduler] can't create notify event");
+    }
+}
+
+update_scheduler::~update_scheduler() {
+    if (_timer_fd >= 0) {
+        ::close(_timer_fd);
+    }
+
+    if (_notify_fd >= 0) {
+        ::close(_notify_fd);
+    }
+}
+
+auto update_scheduler::notify() noexcept -> void {
+    if (_notify_fd < 0) {
+        return;
+    }
+
+    const uint64_t event = 1;
+    if (::write(_notify_fd, &event, sizeof(event)) < 0) {
+        log::warn("[Update Scheduler] can't signal notify event");
+    }
+}
+
+auto update_scheduler::wait(network::clock::time_point deadline, int rx_event_fd) noexcept
+    -> update_wakeup {
+    const auto delay = next_tick(deadline);
+
+    if (_timer_fd < 0) {
+        std::this_thread::sleep_for(delay);
+        return update_wakeup::tick;
+    }
+
+    // Relative to the monotonic clock, rfnet's clock may be stepped
+    itimerspec spec {};
+    spec.it_value.tv_sec = static_cast<time_t>(delay.count() / 1000000000);
+    spec.it_value.tv_nsec = static_cast<long>(delay.count() % 1000000000);
+
+    if (timerfd_settime(_timer_fd, 0, &spec, nullptr) < 0) {
+        log::warn("[Update Scheduler] can't arm timer");
+        std::this_thread::sleep_for(delay);
+        return update_wakeup::tick;
+    }
+
+    // Negative descriptors are ignored by poll
+    std::array<pollfd, 3> fds = {
+        pollfd { .fd = _notify_fd, .events = POLLIN, .revents = 0 },
+        pollfd { .fd = rx_event_fd, .events = POLLIN, .revents = 0 },
+        pollfd { .fd = _timer_fd, .events = POLLIN, .revents = 0 },
+    };
+
+    while (::poll(fds.data(), fds.size(), -1) < 0) {
+        if (errno != EINTR) {
+            log::warn("[Update Scheduler] poll failed");
+            break;
+        }
+    }
+
+    uint64_t events = 0;
+
+    if (fds[0].revents & POLLIN) {
+        if (::read(_notify_fd, &events, sizeof(events)) < 0) {
+            log::warn("[Update Scheduler] can't clear notify event");
+        }
+        return update_wakeup::notify;
+    }
+
+    // Receive event belongs to the radio, it's cleared once the frame is received
+    if (fds[1].revents & POLLIN) {
+        return update_wakeup::rx;
+    }
+
+    if (::read(_timer_fd, &events, sizeof(events)) < 0 && errno != EAGAIN) {
+        log::warn("[Update Scheduler] can't read timer");
+    }
+
+    return update_wakeup::tick;
+}
+
+auto update_scheduler::next_tick(network::clock::time_point deadline) const noexcept
+    -> std::chrono::nanoseconds {
+    const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        network::clock::now().time_since_epoch());
+
+    const auto at = std::max(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()),
+        now + std::chrono::nanoseconds { 1 });
+
+    return ((at - std::chrono::nanoseconds { 1 }) / _tick + 1) * _tick - now;
+}
+
+} // namespace kaonic::comm::mesh
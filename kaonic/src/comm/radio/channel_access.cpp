@@ -0,0 +1,28 @@
+#include "kaonic/comm/radio/channel_access.hpp"
+
+#include <algorithm>
+
+namespace kaonic::comm {
+
+csma_backoff_policy::csma_backoff_policy(const channel_access_config& config) noexcept
+    : _config { config }
+    , _generator { static_cast<std::mt19937::result_type>(
+          config.seed ? config.seed : std::random_device {}()) } {}
+
+auto csma_backoff_policy::backoff(size_t attempt) noexcept
+    -> std::optional<std::chrono::microseconds> {
+
+    if (attempt >= _config.max_attempts) {
+        return std::nullopt;
+    }
+
+    const auto min_be = std::min(_config.min_be, _config.max_be);
+    const auto exponent =
+        std::min<size_t>(min_be + (attempt > 0 ? attempt - 1 : 0), _config.max_be);
+
+    std::uniform_int_distribution<uint32_t> periods { 0, (1u << exponent) - 1u };
+
+    return _config.backoff_period * periods(_generator);
+}
+
+} // namespace kaonic::comm
@@ -1,9 +1,16 @@
 #include "kaonic/comm/radio/rf215_radio.hpp"
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <optional>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <type_traits>
+#include <unistd.h>
 #include <variant>
 
+#include "kaonic/common/copy_stats.hpp"
 #include "kaonic/common/logging.hpp"
 
 extern "C" {
@@ -18,10 +25,95 @@ namespace kaonic::comm {
 
 constexpr static bool rf215_log_verbose = false;
 
+// IRQ thread re-arms the receiver at least this often when the line stays idle
+constexpr static auto irq_idle_timeout = 50ms;
+// Time given to the baseband to finish the frame once the IRQ line fired
+constexpr static auto rx_irq_timeout = 1ms;
+
+// Register address without the SPI command bits
+constexpr static rf215_reg_t rf215_addr_mask = 0x3FFF;
+
+// RESET value of RG_RF_RST and RESET command of RG_CMD
+constexpr static uint8_t rf215_reset = 0x07;
+
+// IRQ status bytes (RF09_IRQS, RF24_IRQS, BBC0_IRQS, BBC1_IRQS) owned by each transceiver
+constexpr static std::array<size_t, 2> rf09_irq_bytes = { 0, 2 };
+constexpr static std::array<size_t, 2> rf24_irq_bytes = { 1, 3 };
+
+static auto irq_bytes(rf215_trx_type type) noexcept -> const std::array<size_t, 2>& {
+    return type == RF215_TRX_TYPE_RF09 ? rf09_irq_bytes : rf24_irq_bytes;
+}
+
+static auto trx_index(rf215_trx_type type) noexcept -> size_t {
+    return type == RF215_TRX_TYPE_RF09 ? 0 : 1;
+}
+
+static auto signal_event(int fd) noexcept -> bool {
+    const uint64_t event = 1;
+    return ::write(fd, &event, sizeof(event)) >= 0;
+}
+
+auto rf215_register_shadow::is_cached(rf215_reg_t addr, const uint8_t* data, size_t len) const
+    noexcept -> bool {
+    addr &= rf215_addr_mask;
+
+    if ((addr + len) > size) {
+        return false;
+    }
+
+    for (size_t i = 0; i < len; ++i) {
+        if (!valid[addr + i] || uncached[addr + i] || values[addr + i] != data[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+auto rf215_register_shadow::update(rf215_reg_t addr, const uint8_t* data, size_t len) noexcept
+    -> void {
+    addr &= rf215_addr_mask;
+
+    for (size_t i = 0; i < len && (addr + i) < size; ++i) {
+        values[addr + i] = data[i];
+        valid[addr + i] = true;
+    }
+
+    for (size_t i = 0; i < len && (addr + i) < size; ++i) {
+        if (resets[addr + i] && data[i] == rf215_reset) {
+            invalidate();
+            return;
+        }
+    }
+}
+
+auto rf215_register_shadow::invalidate(rf215_reg_t addr, size_t len) noexcept -> void {
+    addr &= rf215_addr_mask;
+
+    for (size_t i = 0; i < len && (addr + i) < size; ++i) {
+        valid[addr + i] = false;
+    }
+}
+
+auto rf215_register_shadow::invalidate() noexcept -> void {
+    valid.reset();
+}
+
 rf215_radio::rf215_radio(const rf215_radio_config& config) noexcept
     : _config { config }
     , _spi { std::make_unique<drivers::spi>() }
-    , _irq_buffer { std::make_unique<gpiod::edge_event_buffer>(1) } {
+    , _spi_batch { std::make_unique<drivers::spi_batch>() }
+    , _shadow { std::make_unique<rf215_register_shadow>() }
+    , _irq_line { std::make_unique<drivers::irq_line>() }
+    , _trx { std::make_unique<rf215_trx_state>(), std::make_unique<rf215_trx_state>() }
+    , _irq_state { std::make_unique<rf215_irq_state>() } {
+
+    _trx[0]->trx = &_dev.rf09;
+    _trx[1]->trx = &_dev.rf24;
+
+    for (auto& state : _trx) {
+        state->access_policy = std::make_unique<csma_backoff_policy>(_config.channel_access);
+    }
 
     _dev.iface = rf215_iface {
         .ctx = this,
@@ -34,6 +126,20 @@ rf215_radio::rf215_radio(const rf215_radio_config& config) noexcept
     };
 }
 
+rf215_radio::~rf215_radio() {
+    stop_irq_thread();
+
+    for (const auto& state : _trx) {
+        if (state->rx_event_fd >= 0) {
+            ::close(state->rx_event_fd);
+        }
+    }
+
+    if (_irq_kick_fd >= 0) {
+        ::close(_irq_kick_fd);
+    }
+}
+
 static auto init_gpio_output(const drivers::gpio_spec& spec,
                              std::string_view gpio_name,
                              bool active_low = false) noexcept
@@ -89,7 +195,7 @@ auto rf215_radio::init() -> error {
     err += _spi->open(_config.spi);
 
     _irq_gpio_req = init_gpio_input(_config.irq_gpio, _config.name + "-irq");
-    if (!_irq_gpio_req) {
+    if (!_irq_gpio_req || !_irq_line->open(_irq_gpio_req->fd()).is_ok()) {
         return error::fail();
     }
 
@@ -118,6 +224,21 @@ auto rf215_radio::init() -> error {
         return error::fail();
     }
 
+    for (auto& state : _trx) {
+        state->applied = false;
+    }
+
+    // Wake-up IRQs of the reset sequence are not a frame event
+    _irq_state->pending.fill(0);
+
+    for (const auto trx : { &_dev.rf09, &_dev.rf24 }) {
+        _shadow->uncached.set(trx->radio_regs->RG_CMD & rf215_addr_mask);
+        _shadow->uncached.set(trx->radio_regs->RG_CNM & rf215_addr_mask);
+        _shadow->resets.set(trx->radio_regs->RG_CMD & rf215_addr_mask);
+    }
+    _shadow->uncached.set(_dev.common_regs->RG_RF_RST & rf215_addr_mask);
+    _shadow->resets.set(_dev.common_regs->RG_RF_RST & rf215_addr_mask);
+
     const auto rf215_pn = rf215_probe(&_dev);
 
     if (rf215_pn != 0x00) {
@@ -127,9 +248,137 @@ auto rf215_radio::init() -> error {
         return error::fail();
     }
 
+    for (auto& state : _trx) {
+        state->rx_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (state->rx_event_fd < 0) {
+            log::error("rf215: can't create rx event: {}", strerror(errno));
+            return error::fail();
+        }
+    }
+
+    _irq_kick_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_irq_kick_fd < 0) {
+        log::error("rf215: can't create irq event: {}", strerror(errno));
+        return error::fail();
+    }
+
+    _irq_running.store(true);
+    _irq_thread = std::thread(&rf215_radio::irq_loop, this);
+
     return error::ok();
 }
 
+auto rf215_radio::stop_irq_thread() noexcept -> void {
+    _irq_running.store(false);
+
+    if (_irq_thread.joinable()) {
+        _irq_thread.join();
+    }
+}
+
+auto rf215_radio::trx_state(rf215_trx_type type) noexcept -> rf215_trx_state& {
+    return *_trx[trx_index(type)];
+}
+
+auto rf215_radio::irq_loop() noexcept -> void {
+
+    log::debug("rf215: {} irq thread started", _config.name);
+
+    std::array<pollfd, 2> fds = {
+        pollfd { .fd = _irq_line->fd(), .events = POLLIN, .revents = 0 },
+        pollfd { .fd = _irq_kick_fd, .events = POLLIN, .revents = 0 },
+    };
+
+    while (_irq_running) {
+
+        // Wait for the IRQ line without the device lock so an idle receiver doesn't block transmit
+        const auto rc =
+            ::poll(fds.data(), fds.size(), static_cast<int>(irq_idle_timeout.count()));
+
+        if (rc > 0 && (fds[1].revents & POLLIN)) {
+            uint64_t events = 0;
+            if (::read(_irq_kick_fd, &events, sizeof(events)) < 0) {
+                log::warn("rf215: {} can't clear irq event", _config.name);
+            }
+        }
+
+        std::lock_guard lock { _mut };
+
+        // Status of both transceivers is read once, each receiver then takes its own bits
+        if (rc > 0 && (fds[0].revents & POLLIN) && !read_irq_status()) {
+            log::warn("rf215: {} can't read irq status", _config.name);
+        }
+
+        for (auto& state : _trx) {
+            if (state->applied) {
+                service_rx(*state);
+            }
+        }
+    }
+
+    log::debug("rf215: {} irq thread stopped", _config.name);
+}
+
+auto rf215_radio::service_rx(rf215_trx_state& state) noexcept -> void {
+
+    const auto type = state.trx->type;
+    _irq_state->owner = type;
+
+    const auto& bytes = irq_bytes(type);
+    const bool pending = std::any_of(
+        bytes.begin(), bytes.end(), [this](size_t i) { return _irq_state->pending[i] != 0; });
+
+    // Frame is still drained from the chip when the queue is full, so the receiver is re-armed
+    auto slot = state.rx_queue.producer_slot();
+    auto& frame = slot ? *slot : state.rx_overflow_frame;
+
+    uint16_t len = sizeof(frame.data);
+
+    const auto timeout = pending ? rx_irq_timeout : 0ms;
+    const int rc = rf215_baseband_rx(
+        state.trx, static_cast<rf215_millis_t>(timeout.count()), frame.data, &len);
+
+    if ((rc != 0) || (len == 0)) {
+        return;
+    }
+
+    frame.len = len;
+    read_rx_info(state, frame.info);
+    ++state.rx_counter;
+
+    if (!slot) {
+        ++state.rx_dropped;
+        log::warn("rf215: {} rx queue is full, dropped {} frames", _config.name, state.rx_dropped);
+        return;
+    }
+
+    state.rx_queue.push();
+
+    if (!signal_event(state.rx_event_fd)) {
+        log::warn("rf215: {} can't signal rx event", _config.name);
+    }
+}
+
+auto rf215_radio::read_rx_info(const rf215_trx_state& state, radio_rx_info& info) noexcept
+    -> void {
+
+    uint8_t rssi = static_cast<uint8_t>(radio_rssi_invalid);
+    uint8_t edv = static_cast<uint8_t>(radio_rssi_invalid);
+
+    // Both registers hold signed dBm values, EDV is measured over the received frame
+    if (rf215_read_reg(&_dev, state.trx->radio_regs->RG_RSSI, &rssi) != 0) {
+        rssi = static_cast<uint8_t>(radio_rssi_invalid);
+    }
+
+    if (rf215_read_reg(&_dev, state.trx->radio_regs->RG_EDV, &edv) != 0) {
+        edv = static_cast<uint8_t>(radio_rssi_invalid);
+    }
+
+    info.rssi = static_cast<int8_t>(rssi);
+    info.edv = static_cast<int8_t>(edv);
+    info.timestamp = _irq_state->timestamp[trx_index(state.trx->type)];
+}
+
 auto rf215_radio::select_filter(const radio_config& config) noexcept -> void {
     // Filter selection
     // TODO: Allow external configuration of filter
@@ -160,18 +409,68 @@ auto rf215_radio::select_filter(const radio_config& config) noexcept -> void {
     }
 }
 
+auto rf215_radio::mask_irqs(rf215_trx* trx) noexcept -> void {
+    rf215_write_reg(&_dev, trx->radio_regs->RG_IRQM, 0x00);
+    rf215_write_reg(&_dev, trx->baseband_regs->RG_IRQM, 0x00);
+}
+
 auto rf215_radio::configure(const radio_config& config) -> error {
 
-    log::debug("rf215: configure to {}kHz {}ch {}kHz spacing",
+    std::lock_guard lock { _mut };
+
+    const auto trx = rf215_get_trx_by_freq(&_dev, config.freq);
+
+    // Single radio mode keeps only the transceiver of the requested band active
+    for (auto& state : _trx) {
+        if (state->trx != trx && (state->applied || !_active_trx.load())) {
+            state->applied = false;
+            mask_irqs(state->trx);
+        }
+    }
+
+    _active_trx.store(trx);
+
+    return configure_locked(trx_state(trx->type), config);
+}
+
+auto rf215_radio::configure_trx(rf215_trx_type type, const radio_config& config) -> error {
+
+    std::lock_guard lock { _mut };
+
+    auto& state = trx_state(type);
+
+    if (rf215_get_trx_by_freq(&_dev, config.freq) != state.trx) {
+        log::error("rf215: {}kHz is out of the {} band",
+                   config.freq,
+                   type == RF215_TRX_TYPE_RF09 ? "RF09" : "RF24");
+        return error::invalid_arg();
+    }
+
+    return configure_locked(state, config);
+}
+
+auto rf215_radio::configure_locked(rf215_trx_state& state, const radio_config& config) -> error {
+
+    const auto trx = state.trx;
+    const auto trx_type = trx->type;
+
+    log::debug("rf215: configure {} to {}kHz {}ch {}kHz spacing",
+               trx_type == RF215_TRX_TYPE_RF09 ? "RF09" : "RF24",
                config.freq,
                config.channel,
                config.channel_spacing);
 
-    select_filter(config);
+    // Filter and PLL are only touched when the channel actually changes
+    const bool freq_changed = !state.applied || (config.freq != state.applied_config.freq)
+                           || (config.channel != state.applied_config.channel)
+                           || (config.channel_spacing != state.applied_config.channel_spacing);
 
-    _active_trx = rf215_get_trx_by_freq(&_dev, config.freq);
+    // Sub-GHz filter bank is in front of RF09 only
+    if (freq_changed && trx_type == RF215_TRX_TYPE_RF09) {
+        select_filter(config);
+    }
 
-    const auto trx_type = _active_trx->type;
+    const auto skipped = _shadow->skipped;
 
     auto rf = &_dev;
 
@@ -179,6 +478,8 @@ auto rf215_radio::configure(const radio_config& config) -> error {
 
     auto err = error::ok();
 
+    begin_write_batch();
+
     err += std::visit(
         [&](auto&& phy_config) {
             using T = std::decay_t<decltype(phy_config)>;
@@ -188,26 +489,27 @@ auto rf215_radio::configure(const radio_config& config) -> error {
             // Common registers
             {
                 rf215_write_reg(rf, rf->common_regs->RG_RF_CLKO, 0x02);
-                rf215_write_reg(rf, _active_trx->radio_regs->RG_CMD, 0x02);
-                rf215_write_reg(rf, rf->rf24.radio_regs->RG_IRQM, 0x00);
-                rf215_write_reg(rf, rf->rf09.radio_regs->RG_IRQM, 0x00);
-                rf215_write_reg(rf, _active_trx->radio_regs->RG_IRQM, 0x1F);
+                rf215_write_reg(rf, trx->radio_regs->RG_CMD, 0x02);
+                rf215_write_reg(rf, trx->radio_regs->RG_IRQM, 0x1F);
                 // 7 6 5   4 3 2 1 0
                 // – PACUR TXPWR
                 rf215_write_reg(rf,
-                                _active_trx->radio_regs->RG_PAC,
+                                trx->radio_regs->RG_PAC,
                                 static_cast<uint8_t>(0b01100000 | tx_power));
                 // 7 6   5 4 3 2 1 0
                 // PADFE – – – – – –
-                rf215_write_reg(rf, _active_trx->radio_regs->RG_PADFE, 0b10000000);
+                rf215_write_reg(rf, trx->radio_regs->RG_PADFE, 0b10000000);
 
                 // 7          6 5    4     3    2   1 0
                 // EXTLNAB YP AGCMAP AVEXT AVEN AVS PAVC
-                rf215_write_reg(rf, _active_trx->radio_regs->RG_AUXS, 0b01000010);
+                rf215_write_reg(rf, trx->radio_regs->RG_AUXS, 0b01000010);
 
-                rf215_write_reg(rf, rf->rf24.baseband_regs->RG_IRQM, 0x00);
-                rf215_write_reg(rf, rf->rf09.baseband_regs->RG_IRQM, 0x00);
-                rf215_write_reg(rf, _active_trx->baseband_regs->RG_IRQM, 0x12);
+                rf215_write_reg(rf, trx->baseband_regs->RG_IRQM, 0x12);
+
+                // CCA before transmit reports busy above this energy level
+                rf215_write_reg(rf,
+                                trx->baseband_regs->RG_AMEDT,
+                                static_cast<uint8_t>(_config.channel_access.cca_threshold));
             }
 
             if constexpr (std::is_same_v<T, radio_phy_config_ofdm>) {
@@ -292,19 +594,19 @@ auto rf215_radio::configure(const radio_config& config) -> error {
                 const struct rf215_reg_value mod_values[] = {
 
                     // Radio
-                    { _active_trx->radio_regs->RG_RXBWC, rxbwc },
-                    { _active_trx->radio_regs->RG_RXDFE, rxdfe },
-                    { _active_trx->radio_regs->RG_TXCUTC, txcutc },
-                    { _active_trx->radio_regs->RG_TXDFE, txdfe },
-                    { _active_trx->radio_regs->RG_EDD, 0x7A },
+                    { trx->radio_regs->RG_RXBWC, rxbwc },
+                    { trx->radio_regs->RG_RXDFE, rxdfe },
+                    { trx->radio_regs->RG_TXCUTC, txcutc },
+                    { trx->radio_regs->RG_TXDFE, txdfe },
+                    { trx->radio_regs->RG_EDD, 0x7A },
 
                     // Baseband
-                    { _active_trx->baseband_regs->RG_PC, 0b1110 },
-                    { _active_trx->baseband_regs->RG_OFDMC,
+                    { trx->baseband_regs->RG_PC, 0b1110 },
+                    { trx->baseband_regs->RG_OFDMC,
                       static_cast<uint8_t>(std::min(phy_config.opt, 3u)) },
-                    { _active_trx->baseband_regs->RG_OFDMPHRTX,
+                    { trx->baseband_regs->RG_OFDMPHRTX,
                       static_cast<uint8_t>(std::min(phy_config.mcs, 6u)) },
-                    { _active_trx->baseband_regs->RG_OFDMSW, ofdmsw },
+                    { trx->baseband_regs->RG_OFDMSW, ofdmsw },
                 };
 
                 const struct rf215_reg_set reg_set = {
@@ -424,67 +726,67 @@ auto rf215_radio::configure(const radio_config& config) -> error {
                 const struct rf215_reg_value mod_values[] = {
 
                     // Radio
-                    { _active_trx->radio_regs->RG_RXBWC, rxbwc },
-                    { _active_trx->radio_regs->RG_RXDFE, rxdfe },
-                    { _active_trx->radio_regs->RG_EDD, 0x7A },
-                    { _active_trx->radio_regs->RG_TXCUTC, txcutc },
-                    { _active_trx->radio_regs->RG_TXDFE, txdfe },
-                    { _active_trx->radio_regs->RG_AGCC, 0b1000000u | 0b1 },
-                    { _active_trx->radio_regs->RG_AGCS, 0b100000u | 0b10111 },
+                    { trx->radio_regs->RG_RXBWC, rxbwc },
+                    { trx->radio_regs->RG_RXDFE, rxdfe },
+                    { trx->radio_regs->RG_EDD, 0x7A },
+                    { trx->radio_regs->RG_TXCUTC, txcutc },
+                    { trx->radio_regs->RG_TXDFE, txdfe },
+                    { trx->radio_regs->RG_AGCC, 0b1000000u | 0b1 },
+                    { trx->radio_regs->RG_AGCS, 0b100000u | 0b10111 },
 
                     // Baseband
-                    { _active_trx->baseband_regs->RG_PC, 0b1101 },
+                    { trx->baseband_regs->RG_PC, 0b1101 },
 
-                    { _active_trx->baseband_regs->RG_FSKC0,
+                    { trx->baseband_regs->RG_FSKC0,
                       static_cast<uint8_t>(
                           ((phy_config.bt & 0b11) << 6) | ((phy_config.midxs & 0b11) << 4)
                           | ((phy_config.midx & 0b111) << 1) | (phy_config.mord & 0b1)) },
 
-                    { _active_trx->baseband_regs->RG_FSKC1,
+                    { trx->baseband_regs->RG_FSKC1,
                       static_cast<uint8_t>(
                           (phy_config.freq_inversion ? 0b10000 : 0) | (phy_config.srate & 0b1111)
                           | static_cast<uint8_t>(phy_config.preamble_length & 0b1100000000)) },
 
-                    { _active_trx->baseband_regs->RG_FSKC2,
+                    { trx->baseband_regs->RG_FSKC2,
                       static_cast<uint8_t>(
                           ((phy_config.pdtm & 1) << 7) | ((phy_config.rxo & 0b11) << 5)
                           | ((phy_config.rxpto & 1) << 4) | ((phy_config.mse & 1) << 3)
                           | (phy_config.preamble_inversion ? 0b100 : 0u)
                           | ((phy_config.fecs & 1) << 1) | (phy_config.fecie ? 1 : 0)) },
 
-                    { _active_trx->baseband_regs->RG_FSKC3,
+                    { trx->baseband_regs->RG_FSKC3,
                       static_cast<uint8_t>(((phy_config.sfdt & 0b1111) << 4)
                                            | (phy_config.pdt & 0b1111)) },
 
-                    { _active_trx->baseband_regs->RG_FSKC4,
+                    { trx->baseband_regs->RG_FSKC4,
                       static_cast<uint8_t>(
                           (phy_config.sftq ? 0b1000000 : 0) | ((phy_config.sfd32 & 0b1) << 5)
                           | (phy_config.rawbit ? 0b10000 : 0) | ((phy_config.csfd1 & 0b11) << 2)
                           | (phy_config.csfd0 & 0b11)) },
 
-                    { _active_trx->baseband_regs->RG_FSKPLL,
+                    { trx->baseband_regs->RG_FSKPLL,
                       static_cast<uint8_t>((phy_config.preamble_length & 0b11111111)) },
 
-                    { _active_trx->baseband_regs->RG_FSKSFD0L,
+                    { trx->baseband_regs->RG_FSKSFD0L,
                       static_cast<uint8_t>((phy_config.sfd0 & 0b11111111)) },
-                    { _active_trx->baseband_regs->RG_FSKSFD0H,
+                    { trx->baseband_regs->RG_FSKSFD0H,
                       static_cast<uint8_t>(((phy_config.sfd0 >> 8) & 0b11111111)) },
-                    { _active_trx->baseband_regs->RG_FSKSFD1L,
+                    { trx->baseband_regs->RG_FSKSFD1L,
                       static_cast<uint8_t>((phy_config.sfd1 & 0b11111111)) },
-                    { _active_trx->baseband_regs->RG_FSKSFD1H,
+                    { trx->baseband_regs->RG_FSKSFD1H,
                       static_cast<uint8_t>(((phy_config.sfd1 >> 8) & 0b11111111)) },
 
-                    { _active_trx->baseband_regs->RG_FSKPHRTX,
+                    { trx->baseband_regs->RG_FSKPHRTX,
                       static_cast<uint8_t>(((phy_config.sfd & 0b1) << 3)
                                            | ((phy_config.dw & 0b1) << 2)) },
 
-                    { _active_trx->baseband_regs->RG_FSKDM,
+                    { trx->baseband_regs->RG_FSKDM,
                       static_cast<uint8_t>((phy_config.pe ? 0b10 : 0)
                                            | (phy_config.en ? 0b01 : 0)) },
 
-                    { _active_trx->baseband_regs->RG_FSKPE0, phy_config.fskpe0 },
-                    { _active_trx->baseband_regs->RG_FSKPE1, phy_config.fskpe1 },
-                    { _active_trx->baseband_regs->RG_FSKPE2, phy_config.fskpe2 },
+                    { trx->baseband_regs->RG_FSKPE0, phy_config.fskpe0 },
+                    { trx->baseband_regs->RG_FSKPE1, phy_config.fskpe1 },
+                    { trx->baseband_regs->RG_FSKPE2, phy_config.fskpe2 },
                 };
 
                 const struct rf215_reg_set reg_set = {
@@ -505,18 +807,31 @@ auto rf215_radio::configure(const radio_config& config) -> error {
         .channel = config.channel,
     };
 
-    err += error::from_rc(rf215_set_freq(_active_trx, &freq));
+    if (freq_changed) {
+        err += error::from_rc(rf215_set_freq(trx, &freq));
+    }
+
+    err += commit_write_batch();
     if (!err.is_ok()) {
         log::error("rf215: set radio config failed");
+        _shadow->invalidate();
+        state.applied = false;
+        return err;
     }
 
+    state.applied_config = config;
+    state.applied = true;
+
+    log::debug("rf215: configure skipped {} unchanged register writes",
+               _shadow->skipped - skipped);
+
     return err;
 }
 
-static auto print_frame(const radio_frame& frame, std::string_view name) noexcept {
-    printf("<frame>:[%4dB] [%s]\n\r", (int)frame.len, name.data());
-    for (size_t i = 0x00; i < frame.len; ++i) {
-        printf("%02x ", frame.data[i]);
+static auto print_frame(span<const uint8_t> frame, std::string_view name) noexcept {
+    printf("<frame>:[%4dB] [%s]\n\r", (int)frame.size(), name.data());
+    for (size_t i = 0x00; i < frame.size(); ++i) {
+        printf("%02x ", frame[i]);
         if (((i + 1) % 14) == 0) {
             printf("|\n\r");
         }
@@ -524,69 +839,250 @@ static auto print_frame(const radio_frame& frame, std::string_view name) noexcep
     printf("<end>\n\r");
 }
 
-auto rf215_radio::transmit(const radio_frame& frame) -> error {
+auto rf215_radio::transmit(span<const uint8_t> data) -> error {
 
-    if (!_active_trx) {
+    const auto trx = _active_trx.load();
+
+    if (!trx) {
         log::error("rf215: trx wasn't configured");
         return error::precondition_failed();
     }
 
+    return transmit_frame(trx_state(trx->type), data);
+}
+
+auto rf215_radio::transmit_trx(rf215_trx_type type, span<const uint8_t> data) -> error {
+
+    auto& state = trx_state(type);
+
+    if (!state.applied) {
+        log::error("rf215: trx wasn't configured");
+        return error::precondition_failed();
+    }
+
+    return transmit_frame(state, data);
+}
+
+auto rf215_radio::transmit_frame(rf215_trx_state& state, span<const uint8_t> data) -> error {
+
     rf215_frame rf_frame { 0 };
-    rf_frame.len = frame.len;
-    memcpy(rf_frame.data, frame.data, frame.len);
 
-    const auto start_time = rf215_current_time(&_dev);
+    if (data.size() > sizeof(rf_frame.data)) {
+        log::error("rf215: frame of {}B exceeds {}B", data.size(), sizeof(rf_frame.data));
+        return error::invalid_arg();
+    }
 
-    auto err = error::fail();
-    for (size_t repeat = 0; repeat < 4; ++repeat) {
+    // The only payload copy on the way down, rf215 library sends the frame buffer over SPI
+    rf_frame.len = data.size();
+    memcpy(rf_frame.data, data.data(), data.size());
+    copy_counter::count_tx(data.size());
 
-        if (auto rc = rf215_baseband_cca_tx_frame(_active_trx, &rf_frame); rc != 0) {
-            log::warn("rf215: channel busy rc={}, repeat={}", rc, repeat);
-            continue;
-        }
+    const auto start_time = std::chrono::steady_clock::now();
+    const auto deadline = _config.channel_access.deadline.count() > 0
+                            ? start_time + _config.channel_access.deadline
+                            : std::chrono::steady_clock::time_point::max();
+
+    for (size_t attempt = 1;; ++attempt) {
+
+        std::optional<std::chrono::microseconds> backoff;
+        {
+            std::lock_guard lock { _mut };
+
+            _irq_state->owner = state.trx->type;
 
-        err = error::ok();
+            auto& stats = state.access_stats;
+            ++stats.attempts;
+
+            if (rf215_baseband_cca_tx_frame(state.trx, &rf_frame) == 0) {
+                ++stats.success;
+                ++state.tx_counter;
+                break;
+            }
+
+            ++stats.busy;
+
+            backoff = state.access_policy->backoff(attempt);
+            if (!backoff) {
+                ++stats.failed;
+                log::warn("rf215: {} channel busy, drop frame after {} attempts",
+                          _config.name,
+                          attempt);
+                return error::fail();
+            }
+
+            if (std::chrono::steady_clock::now() + *backoff > deadline) {
+                ++stats.expired;
+                log::warn("rf215: {} channel busy, drop frame at deadline", _config.name);
+                return error::timeout();
+            }
+
+            stats.backoff_time += *backoff;
+        }
 
-        break;
+        // Back off without the device lock so the receiver keeps being serviced
+        std::this_thread::sleep_for(*backoff);
     }
 
-    const auto end_time = rf215_current_time(&_dev);
-    ++_tx_counter;
-    // log::trace("rf215: {} tx [{:>10}] >> {:>4} B in {}msec",
+    // log::trace("rf215: {} tx [{:>10}] >> {:>4} B in {}usec",
     //            _config.name,
-    //            _tx_counter,
-    //            frame.len,
-    //            end_time - start_time);
+    //            state.tx_counter,
+    //            data.size(),
+    //            std::chrono::duration_cast<std::chrono::microseconds>(
+    //                std::chrono::steady_clock::now() - start_time).count());
 
-    // print_frame(frame, "TX");
+    // print_frame(data, "TX");
 
-    return err;
+    return error::ok();
 }
 
-auto rf215_radio::receive(radio_frame& frame, const std::chrono::milliseconds& timeout) -> error {
+auto rf215_radio::set_channel_access_policy(rf215_trx_type type,
+                                            std::unique_ptr<channel_access_policy> policy)
+    -> error {
+
+    if (!policy) {
+        return error::invalid_arg();
+    }
+
+    std::lock_guard lock { _mut };
+
+    trx_state(type).access_policy = std::move(policy);
+
+    return error::ok();
+}
+
+auto rf215_radio::get_channel_access_stats(rf215_trx_type type) -> channel_access_stats {
+    std::lock_guard lock { _mut };
+
+    return trx_state(type).access_stats;
+}
+
+auto rf215_radio::get_channel_access_stats() -> channel_access_stats {
+    const auto trx = _active_trx.load();
+
+    return trx ? get_channel_access_stats(trx->type) : channel_access_stats {};
+}
+
+auto rf215_radio::receive(span<uint8_t> buffer,
+                          size_t& len,
+                          radio_rx_info& info,
+                          const std::chrono::milliseconds& timeout) -> error {
+
+    const auto trx = _active_trx.load();
 
-    if (!_active_trx) {
+    if (!trx) {
         log::error("rf215: trx wasn't configured");
         return error::precondition_failed();
     }
 
-    uint16_t len = sizeof(frame.data);
+    return receive_from(trx_state(trx->type), buffer, len, info, timeout);
+}
 
-    const int rc = rf215_baseband_rx(
-        _active_trx, static_cast<rf215_millis_t>(timeout.count()), frame.data, &len);
+auto rf215_radio::rx_event_fd() const noexcept -> int {
+    const auto trx = _active_trx.load();
+
+    return trx ? trx_rx_event_fd(trx->type) : -1;
+}
+
+auto rf215_radio::trx_rx_event_fd(rf215_trx_type type) const noexcept -> int {
+    // Event is only read once the queue is found empty, so it may report a drained queue
+    return _trx[trx_index(type)]->rx_event_fd;
+}
+
+auto rf215_radio::receive_trx(rf215_trx_type type,
+                              span<uint8_t> buffer,
+                              size_t& len,
+                              radio_rx_info& info,
+                              const std::chrono::milliseconds& timeout) -> error {
+
+    auto& state = trx_state(type);
+
+    if (!state.applied) {
+        log::error("rf215: trx wasn't configured");
+        return error::precondition_failed();
+    }
+
+    return receive_from(state, buffer, len, info, timeout);
+}
+
+auto rf215_radio::receive_from(rf215_trx_state& state,
+                               span<uint8_t> buffer,
+                               size_t& len,
+                               radio_rx_info& info,
+                               const std::chrono::milliseconds& timeout) -> error {
+
+    // FIFO slot was filled by the SPI read, this is the only copy on the way up
+    const auto pop_frame = [&state, &buffer, &len, &info]() -> error {
+        const auto slot = state.rx_queue.consumer_slot();
+        if (!slot) {
+            return error::timeout();
+        }
 
-    auto err = error::timeout();
-    if ((rc == 0) && (len > 0)) {
-        frame.len = len;
-        ++_rx_counter;
-        // log::trace("rf215: {} rx [{:>10}] << {:>4} B", _config.name, _rx_counter, len);
-        // print_frame(frame, "RX");
-        err = error::ok();
+        if (slot->len > buffer.size()) {
+            log::warn("rf215: drop {}B frame, receive buffer is {}B", slot->len, buffer.size());
+            state.rx_queue.pop();
+            return error::invalid_arg();
+        }
+
+        len = slot->len;
+        info = slot->info;
+        memcpy(buffer.data(), slot->data, slot->len);
+        copy_counter::count_rx(slot->len);
+        state.rx_queue.pop();
+
+        return error::ok();
+    };
+
+    if (auto err = pop_frame(); err.code != error_code::timeout) {
+        return err;
     }
 
+    pollfd rx_event { .fd = state.rx_event_fd, .events = POLLIN, .revents = 0 };
+
+    if (::poll(&rx_event, 1, static_cast<int>(timeout.count())) <= 0) {
+        return error::timeout();
+    }
+
+    uint64_t events = 0;
+    if (::read(state.rx_event_fd, &events, sizeof(events)) < 0) {
+        return error::timeout();
+    }
+
+    // log::trace("rf215: {} rx [{:>10}] << {:>4} B", _config.name, state.rx_counter, len);
+    // print_frame(buffer.first(len), "RX");
+
+    return pop_frame();
+}
+
+auto rf215_radio::begin_write_batch() noexcept -> void {
+    _spi_batch->clear();
+    _spi_batching = true;
+}
+
+auto rf215_radio::commit_write_batch() noexcept -> error {
+    auto err = flush_write_batch();
+    _spi_batching = false;
     return err;
 }
 
+auto rf215_radio::flush_write_batch() const noexcept -> error {
+    if (_spi_batch->empty()) {
+        return error::ok();
+    }
+
+    if (rf215_log_verbose) {
+        log::trace("rf215: submit {} spi bursts", _spi_batch->bursts());
+    }
+
+    if (auto err = _spi->submit(*_spi_batch); !err.is_ok()) {
+        log::error("rf215: fail to submit spi batch");
+        // Part of the batch may not have reached the chip
+        _shadow->invalidate();
+        return err;
+    }
+
+    return error::ok();
+}
+
 auto rf215_radio::write(const void* ctx, rf215_reg_t reg, void* data, size_t len) noexcept -> int {
     auto& self = *reinterpret_cast<const rf215_radio*>(ctx);
 
@@ -605,8 +1101,22 @@ auto rf215_radio::write(const void* ctx, rf215_reg_t reg, void* data, size_t len
         log::trace("rf215: wr reg[0x{:04x}]=0x{:04x}", reg, dump);
     }
 
+    if (self._shadow->is_cached(reg, bytes, len)) {
+        ++self._shadow->skipped;
+        return 0;
+    }
+
+    self._shadow->update(reg, bytes, len);
+    ++self._shadow->writes;
+
+    if (self._spi_batching) {
+        self._spi_batch->write(reg, bytes, len);
+        return 0;
+    }
+
     if (auto err = self._spi->write_buffer(reg, bytes, len); !err.is_ok()) {
         log::error("rf215: fail to write spi buffer");
+        self._shadow->invalidate(reg, len);
         return -1;
     }
     return 0;
@@ -616,6 +1126,11 @@ auto rf215_radio::read(const void* ctx, rf215_reg_t reg, void* data, size_t len)
 
     auto& self = *reinterpret_cast<const rf215_radio*>(ctx);
 
+    // Queued writes have to land before the read to keep register access ordered
+    if (auto err = self.flush_write_batch(); !err.is_ok()) {
+        return -1;
+    }
+
     auto bytes = reinterpret_cast<uint8_t*>(data);
     if (auto err = self._spi->read_buffer(reg, bytes, len); !err.is_ok()) {
         log::error("rf215: fail to read spi buffer");
@@ -638,34 +1153,97 @@ auto rf215_radio::read(const void* ctx, rf215_reg_t reg, void* data, size_t len)
     return 0;
 }
 
+auto rf215_radio::read_irq_status() const noexcept -> bool {
+
+    // Edge time is taken by the kernel on the same clock as steady_clock. No edge left means
+    // a transmit took it under the lock after the IRQ thread polled, and read the status already
+    std::chrono::nanoseconds timestamp {};
+    if (!_irq_line->take(timestamp)) {
+        return true;
+    }
+
+    // IRQ status registers are cleared on read, bits are merged with ones not yet consumed
+    std::array<uint8_t, sizeof(rf215_irq_data_t)> status {};
+    if (auto err = _spi->read_buffer(0x0000, status.data(), status.size()); !err.is_ok()) {
+        return false;
+    }
+
+    auto& irq_state = *_irq_state;
+    for (size_t i = 0; i < status.size(); ++i) {
+        irq_state.pending[i] |= status[i];
+    }
+
+    for (const auto type : { RF215_TRX_TYPE_RF09, RF215_TRX_TYPE_RF24 }) {
+        const auto& bytes = irq_bytes(type);
+        if (std::any_of(bytes.begin(), bytes.end(), [&](size_t i) { return status[i] != 0; })) {
+            irq_state.timestamp[trx_index(type)] = timestamp;
+        }
+    }
+
+    if (rf215_log_verbose) {
+        log::trace("rf215: irq {:02x}{:02x}{:02x}{:02x}", status[3], status[2], status[1], status[0]);
+    }
+
+    // The other transceiver is serviced by the IRQ thread
+    const auto owner = irq_state.owner;
+    const auto& other = irq_bytes(owner == RF215_TRX_TYPE_RF09 ? RF215_TRX_TYPE_RF24
+                                                               : RF215_TRX_TYPE_RF09);
+    if (std::any_of(other.begin(), other.end(), [&](size_t i) { return status[i] != 0; })) {
+        signal_event(_irq_kick_fd);
+    }
+
+    return true;
+}
+
+auto rf215_radio::take_irq_status(rf215_trx_type type, rf215_irq_data_t* irq) const noexcept
+    -> bool {
+
+    std::array<uint8_t, sizeof(rf215_irq_data_t)> status {};
+
+    bool has_irq = false;
+    for (const auto i : irq_bytes(type)) {
+        status[i] = _irq_state->pending[i];
+        _irq_state->pending[i] = 0;
+        has_irq = has_irq || (status[i] != 0);
+    }
+
+    memcpy(irq, status.data(), sizeof(rf215_irq_data_t));
+
+    return has_irq;
+}
+
 auto rf215_radio::wait_irq(const void* ctx, rf215_millis_t timeout, rf215_irq_data_t* irq) noexcept
     -> bool {
 
     auto& self = *reinterpret_cast<const rf215_radio*>(ctx);
 
-    const auto has_irq = self._irq_gpio_req->wait_edge_events(std::chrono::milliseconds(timeout));
+    if (auto err = self.flush_write_batch(); !err.is_ok()) {
+        return false;
+    }
 
-    if (has_irq) {
+    // Both transceivers share the IRQ line, only bits of the one being served are returned
+    const auto owner = self._irq_state->owner;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
 
-        self._irq_gpio_req->read_edge_events(*self._irq_buffer);
+    while (!self.take_irq_status(owner, irq)) {
 
-        auto irq_data_ptr = reinterpret_cast<uint8_t*>(irq);
-        if (auto err = self._spi->read_buffer(0x0000, irq_data_ptr, sizeof(rf215_irq_data_t));
-            !err.is_ok()) {
-            return false;
-        }
+        const auto remaining = std::max(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                            deadline - std::chrono::steady_clock::now()),
+                                        std::chrono::nanoseconds::zero());
 
-        if (rf215_log_verbose) {
-            log::trace("rf215: irq 0x{:08x}", *irq);
+        if (!self._irq_line->wait(remaining)) {
+            if (rf215_log_verbose) {
+                log::trace("rf215: no irq");
+            }
+            return false;
         }
 
-    } else {
-        if (rf215_log_verbose) {
-            log::trace("rf215: no irq");
+        if (!self.read_irq_status()) {
+            return false;
         }
     }
 
-    return has_irq;
+    return true;
 }
 
 auto rf215_radio::current_time(const void* ctx) noexcept -> rf215_millis_t {
@@ -681,6 +1259,14 @@ auto rf215_radio::reset(const void* ctx) noexcept -> void {
 
     auto& self = *reinterpret_cast<const rf215_radio*>(ctx);
 
+    // Writes queued before the reset would otherwise land after it
+    if (auto err = self.flush_write_batch(); !err.is_ok()) {
+        log::warn("rf215: writes before the reset failed");
+    }
+
+    // Registers are back to reset values
+    self._shadow->invalidate();
+
     self._rst_gpio_req->set_value(self._config.rst_gpio.gpio_line, gpiod::line::value::ACTIVE);
     std::this_thread::sleep_for(25ms);
 
@@ -689,7 +1275,42 @@ auto rf215_radio::reset(const void* ctx) noexcept -> void {
 }
 
 auto rf215_radio::sleep(const void* ctx, rf215_millis_t delay) noexcept -> void {
+    auto& self = *reinterpret_cast<const rf215_radio*>(ctx);
+
+    // Writes before the delay have to reach the chip before it starts, e.g. for PLL settling
+    if (auto err = self.flush_write_batch(); !err.is_ok()) {
+        log::warn("rf215: writes before a {}ms delay failed", delay);
+    }
+
     std::this_thread::sleep_for(std::chrono::milliseconds(delay));
 }
 
+rf215_trx_radio::rf215_trx_radio(const std::shared_ptr<rf215_radio>& chip,
+                                 rf215_trx_type type) noexcept
+    : _chip { chip }
+    , _type { type } {}
+
+auto rf215_trx_radio::configure(const radio_config& config) -> error {
+    return _chip->configure_trx(_type, config);
+}
+
+auto rf215_trx_radio::transmit(span<const uint8_t> data) -> error {
+    return _chip->transmit_trx(_type, data);
+}
+
+auto rf215_trx_radio::receive(span<uint8_t> buffer,
+                              size_t& len,
+                              radio_rx_info& info,
+                              const std::chrono::milliseconds& timeout) -> error {
+    return _chip->receive_trx(_type, buffer, len, info, timeout);
+}
+
+auto rf215_trx_radio::rx_event_fd() const noexcept -> int {
+    return _chip->trx_rx_event_fd(_type);
+}
+
+auto rf215_trx_radio::get_channel_access_stats() -> channel_access_stats {
+    return _chip->get_channel_access_stats(_type);
+}
+
 } // namespace kaonic::comm
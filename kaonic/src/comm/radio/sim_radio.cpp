@@ -0,0 +1,415 @@
+#include "kaonic/comm/radio/sim_radio.hpp"
+
+#include <algorithm>
+#include <array>
+#include <sys/eventfd.h>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <variant>
+
+#include "kaonic/common/copy_stats.hpp"
+#include "kaonic/common/logging.hpp"
+
+using namespace std::chrono_literals;
+
+namespace kaonic::comm {
+
+// MR-OFDM data rate (kbit/s) for Option 1, other options scale down by a power of two
+constexpr static std::array<uint32_t, 7> ofdm_opt1_rates = { 100, 200, 400, 800, 1200, 1600, 2400 };
+constexpr static auto ofdm_symbol_duration = 120us;
+// STF + LTF + PHR
+constexpr static size_t ofdm_header_symbols = 9;
+
+// MR-FSK symbol rate (ksymbol/s) indexed by FSKC1.SRATE
+constexpr static std::array<uint32_t, 6> fsk_symbol_rates = { 50, 100, 150, 200, 300, 400 };
+constexpr static size_t fsk_min_preamble_length = 4;
+// SFD + PHR
+constexpr static size_t fsk_header_length = 4;
+
+constexpr static size_t fcs_length = 4;
+
+static auto is_same_channel(const radio_config& lhs, const radio_config& rhs) noexcept -> bool {
+    return lhs.freq == rhs.freq && lhs.channel == rhs.channel
+        && lhs.channel_spacing == rhs.channel_spacing;
+}
+
+sim_medium::sim_medium(const sim_medium_config& config) noexcept
+    : _config { config }
+    , _loss_generator { config.seed ? config.seed : std::random_device {}() } {}
+
+auto sim_medium::attach(sim_radio* radio) noexcept -> void {
+    std::lock_guard lock { _mut };
+
+    if (radio && std::find(_radios.begin(), _radios.end(), radio) == _radios.end()) {
+        _radios.push_back(radio);
+    }
+}
+
+auto sim_medium::detach(sim_radio* radio) noexcept -> void {
+    std::lock_guard lock { _mut };
+
+    _radios.erase(std::remove(_radios.begin(), _radios.end(), radio), _radios.end());
+}
+
+auto sim_medium::set_link(const sim_radio& from, const sim_radio& to, const sim_link& link) noexcept
+    -> void {
+    std::lock_guard lock { _mut };
+
+    _links[{ &from, &to }] = link;
+}
+
+auto sim_medium::get_stats() const noexcept -> sim_medium_stats {
+    std::lock_guard lock { _mut };
+
+    return _stats;
+}
+
+auto sim_medium::begin_transmit(const sim_radio* source,
+                                const radio_config& config,
+                                std::chrono::microseconds airtime) noexcept -> transmission_id {
+    std::lock_guard lock { _mut };
+
+    const auto now = clock::now();
+
+    transmission tx {
+        .source = source,
+        .config = config,
+        .start = now,
+        .end = now + airtime,
+    };
+
+    if (_config.collisions) {
+        for (auto& other : _transmissions) {
+            if (is_same_channel(other.config, config)) {
+                if (!other.collided) {
+                    ++_stats.collisions;
+                }
+                other.collided = true;
+                tx.collided = true;
+            }
+        }
+    }
+
+    // Count the channel as busy only once for overlapping frames
+    const auto busy_start = std::max(tx.start, _busy_until);
+    if (tx.end > busy_start) {
+        _stats.busy_time +=
+            std::chrono::duration_cast<std::chrono::microseconds>(tx.end - busy_start);
+        _busy_until = tx.end;
+    }
+
+    ++_stats.transmissions;
+
+    if (_free_transmissions.empty()) {
+        return _transmissions.insert(_transmissions.end(), tx);
+    }
+
+    const auto id = _free_transmissions.begin();
+    *id = tx;
+    _transmissions.splice(_transmissions.end(), _free_transmissions, id);
+
+    return id;
+}
+
+auto sim_medium::end_transmit(transmission_id id, span<const uint8_t> data) noexcept -> void {
+    std::lock_guard lock { _mut };
+
+    const auto tx = *id;
+    _free_transmissions.splice(_free_transmissions.end(), _transmissions, id);
+
+    for (auto radio : _radios) {
+        if (radio == tx.source) {
+            continue;
+        }
+
+        if (tx.collided) {
+            ++_stats.lost;
+            continue;
+        }
+
+        const auto& link = this->link(tx.source, radio);
+
+        if (link.loss_rate > 0.0 && _loss_distribution(_loss_generator) < link.loss_rate) {
+            ++_stats.lost;
+            continue;
+        }
+
+        if (radio->deliver(tx.config, data, link, clock::now() + link.propagation_delay)) {
+            ++_stats.delivered;
+        }
+    }
+}
+
+auto sim_medium::link(const sim_radio* from, const sim_radio* to) const noexcept
+    -> const sim_link& {
+    if (const auto it = _links.find({ from, to }); it != _links.end()) {
+        return it->second;
+    }
+
+    return _config.default_link;
+}
+
+sim_radio::sim_radio(const sim_radio_config& config,
+                     const std::shared_ptr<sim_medium>& medium) noexcept
+    : _config { config }
+    , _medium { medium }
+    , _rx_queue { config.rx_queue_size }
+    , _loss_generator { config.seed ? config.seed : std::random_device {}() } {
+
+    _rx_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_rx_event_fd < 0) {
+        log::warn("sim: {} can't create rx event", _config.name);
+    }
+
+    if (!_medium) {
+        log::error("sim: {} medium wasn't initialized", _config.name);
+        return;
+    }
+
+    _medium->attach(this);
+}
+
+sim_radio::~sim_radio() {
+    if (_medium) {
+        _medium->detach(this);
+    }
+
+    if (_rx_event_fd >= 0) {
+        ::close(_rx_event_fd);
+    }
+}
+
+auto sim_radio::configure(const radio_config& config) -> error {
+    std::lock_guard lock { _mut };
+
+    log::debug("sim: {} configure to {}kHz {}ch {}kHz spacing",
+               _config.name,
+               config.freq,
+               config.channel,
+               config.channel_spacing);
+
+    _radio_config = config;
+    _configured = true;
+    _rx_queue.clear();
+    update_rx_event();
+
+    return error::ok();
+}
+
+auto sim_radio::transmit(span<const uint8_t> data) -> error {
+
+    radio_config config;
+    {
+        std::lock_guard lock { _mut };
+
+        if (!_configured) {
+            log::error("sim: {} wasn't configured", _config.name);
+            return error::precondition_failed();
+        }
+
+        config = _radio_config;
+        ++_tx_counter;
+    }
+
+    if (data.size() > data_max_size) {
+        return error::invalid_arg();
+    }
+
+    if (!_medium) {
+        return error::precondition_failed();
+    }
+
+    const auto frame_airtime = airtime(config.phy_config, data.size());
+
+    // Sender is busy for the whole frame, receivers get it once the last symbol is on air
+    const auto id = _medium->begin_transmit(this, config, frame_airtime);
+
+    std::this_thread::sleep_for(frame_airtime);
+
+    _medium->end_transmit(id, data);
+
+    return error::ok();
+}
+
+auto sim_radio::receive(span<uint8_t> buffer,
+                        size_t& len,
+                        radio_rx_info& info,
+                        const std::chrono::milliseconds& timeout) -> error {
+    std::unique_lock lock { _mut };
+
+    if (!_configured) {
+        log::error("sim: {} wasn't configured", _config.name);
+        return error::precondition_failed();
+    }
+
+    const auto deadline = sim_medium::clock::now() + timeout;
+
+    // Frames become visible after the link propagation delay
+    while (_rx_queue.empty() || _rx_queue.front().available_at > sim_medium::clock::now()) {
+        const auto wake_time =
+            _rx_queue.empty() ? deadline : std::min(deadline, _rx_queue.front().available_at);
+
+        if (_rx_cond.wait_until(lock, wake_time) == std::cv_status::timeout
+            && sim_medium::clock::now() >= deadline) {
+            update_rx_event();
+            return error::timeout();
+        }
+    }
+
+    const auto& rx_frame = _rx_queue.front().frame;
+
+    if (rx_frame.len > buffer.size()) {
+        log::warn("sim: {} drop {}B frame, receive buffer is {}B",
+                  _config.name,
+                  rx_frame.len,
+                  buffer.size());
+        _rx_queue.pop_front();
+        update_rx_event();
+        return error::invalid_arg();
+    }
+
+    // Receive queue stands in for the transceiver frame buffer, same as the rf215 FIFO
+    len = rx_frame.len;
+    info = rx_frame.info;
+    std::copy(rx_frame.data, rx_frame.data + rx_frame.len, buffer.data());
+    copy_counter::count_rx(rx_frame.len);
+    _rx_queue.pop_front();
+    update_rx_event();
+
+    ++_rx_counter;
+
+    return error::ok();
+}
+
+auto sim_radio::rx_event_fd() const noexcept -> int {
+    return _rx_event_fd;
+}
+
+auto sim_radio::update_rx_event() noexcept -> void {
+    if (_rx_event_fd < 0) {
+        return;
+    }
+
+    // Frames still in propagation aren't signalled, pollers pick them up on their next wakeup
+    const auto ready = !_rx_queue.empty()
+                    && _rx_queue.front().available_at <= sim_medium::clock::now();
+
+    if (ready == _rx_event_set) {
+        return;
+    }
+
+    uint64_t event = 1;
+    const auto rc = ready ? ::write(_rx_event_fd, &event, sizeof(event))
+                          : ::read(_rx_event_fd, &event, sizeof(event));
+
+    if (rc >= 0) {
+        _rx_event_set = ready;
+    }
+}
+
+auto sim_radio::airtime(const radio_phy_config_t& phy_config, size_t len) noexcept
+    -> std::chrono::microseconds {
+    return std::visit(
+        [len](auto&& phy_config) -> std::chrono::microseconds {
+            using T = std::decay_t<decltype(phy_config)>;
+
+            const auto bits = static_cast<uint64_t>(len + fcs_length) * 8u;
+
+            if constexpr (std::is_same_v<T, radio_phy_config_ofdm>) {
+                const auto mcs = std::min<size_t>(phy_config.mcs, ofdm_opt1_rates.size() - 1);
+                const auto opt = std::min<uint32_t>(phy_config.opt, 3u);
+                const auto rate_kbps = std::max<uint64_t>(ofdm_opt1_rates[mcs] >> opt, 1u);
+
+                // kbit/s is the same as bit/ms
+                const auto payload = std::chrono::microseconds { (bits * 1000u) / rate_kbps };
+
+                return ofdm_symbol_duration * ofdm_header_symbols + payload;
+            }
+
+            if constexpr (std::is_same_v<T, radio_phy_config_fsk>) {
+                const auto srate =
+                    fsk_symbol_rates[std::min<size_t>(phy_config.srate, fsk_symbol_rates.size() - 1)];
+                const auto bits_per_symbol = (phy_config.mord & 0b1) ? 2u : 1u;
+                const auto preamble_length =
+                    std::max<size_t>(phy_config.preamble_length, fsk_min_preamble_length);
+
+                const auto header_bits =
+                    static_cast<uint64_t>(preamble_length + fsk_header_length) * 8u;
+                const auto symbols = (bits + header_bits + bits_per_symbol - 1) / bits_per_symbol;
+
+                return std::chrono::microseconds { (symbols * 1000u) / srate };
+            }
+        },
+        phy_config);
+}
+
+auto sim_radio::is_compatible(const radio_config& config) const noexcept -> bool {
+    if (!_configured) {
+        return false;
+    }
+
+    if (config.freq != _radio_config.freq || config.channel != _radio_config.channel
+        || config.channel_spacing != _radio_config.channel_spacing) {
+        return false;
+    }
+
+    if (config.phy_config.index() != _radio_config.phy_config.index()) {
+        return false;
+    }
+
+    return std::visit(
+        [&](auto&& phy_config) {
+            using T = std::decay_t<decltype(phy_config)>;
+
+            const auto& rx_config = std::get<T>(_radio_config.phy_config);
+
+            // OFDM receiver detects MCS from PHR, FSK needs the same symbol rate and order
+            if constexpr (std::is_same_v<T, radio_phy_config_ofdm>) {
+                return phy_config.opt == rx_config.opt;
+            }
+
+            if constexpr (std::is_same_v<T, radio_phy_config_fsk>) {
+                return phy_config.srate == rx_config.srate && phy_config.mord == rx_config.mord;
+            }
+        },
+        config.phy_config);
+}
+
+auto sim_radio::deliver(const radio_config& config,
+                        span<const uint8_t> data,
+                        const sim_link& link,
+                        sim_medium::clock::time_point available_at) noexcept -> bool {
+    std::lock_guard lock { _mut };
+
+    if (!is_compatible(config)) {
+        return false;
+    }
+
+    if (_config.loss_rate > 0.0 && _loss_distribution(_loss_generator) < _config.loss_rate) {
+        ++_rx_dropped;
+        return false;
+    }
+
+    if (_rx_queue.full()) {
+        _rx_queue.pop_front();
+        ++_rx_dropped;
+    }
+
+    auto& rx_entry = _rx_queue.emplace_back();
+    rx_entry.available_at = available_at;
+    rx_entry.frame.len = data.size();
+    rx_entry.frame.info = radio_rx_info {
+        .rssi = link.rssi,
+        .edv = link.rssi,
+        .timestamp = available_at.time_since_epoch(),
+    };
+    std::copy(data.begin(), data.end(), rx_entry.frame.data);
+
+    update_rx_event();
+    _rx_cond.notify_one();
+
+    return true;
+}
+
+} // namespace kaonic::comm
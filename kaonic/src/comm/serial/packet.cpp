@@ -2,6 +2,11 @@
 
 #include "kaonic/common/logging.hpp"
 
+#include <algorithm>
+#include <type_traits>
+
+#include <google/protobuf/io/coded_stream.h>
+
 namespace kaonic::comm::serial {
 
 constexpr static uint16_t magic = 0x22;
@@ -19,6 +24,33 @@ struct packet_header final {
     uint8_t reserved[16];
 };
 
+// Parses into the message the payload already holds when it's of the same type, its fields
+// keep their memory from one packet to the next. Clear() deletes the frame of a message that isn't
+// on an arena, so the frame is taken out while the message is cleared.
+template <class T>
+static auto parse_in_place(const buffer_t& buffer, payload_t& payload) noexcept -> bool {
+    const auto* data = buffer.data() + sizeof(packet_header);
+    const auto size = static_cast<int>(buffer.size() - sizeof(packet_header));
+
+    auto* message = std::get_if<T>(&payload);
+    if (!message) {
+        message = &payload.emplace<T>();
+    }
+
+    if constexpr (std::is_same_v<T, TransmitRequest> || std::is_same_v<T, ReceiveResponse>) {
+        if (auto* frame = message->unsafe_arena_release_frame()) {
+            message->Clear();
+            frame->Clear();
+            message->unsafe_arena_set_allocated_frame(frame);
+
+            google::protobuf::io::CodedInputStream input { data, size };
+            return message->MergeFromCodedStream(&input) && input.ConsumedEntireMessage();
+        }
+    }
+
+    return message->ParseFromArray(data, size);
+}
+
 auto packet::decode(const buffer_t& buffer, payload_t& payload) noexcept -> void {
     if (buffer.size() < sizeof(packet_header)) {
         payload = error_payload {};
@@ -34,43 +66,27 @@ auto packet::decode(const buffer_t& buffer, payload_t& payload) noexcept -> void
     }
 
     switch (header.type) {
-        case packet_type::config: {
-            ConfigurationRequest config;
-            if (!config.ParseFromArray(buffer.data() + sizeof(header),
-                                       buffer.size() - sizeof(header))) {
+        case packet_type::config:
+            if (!parse_in_place<ConfigurationRequest>(buffer, payload)) {
                 log::warn("[Serial Service] TX failed: unable to parse config packet");
                 payload = error_payload {};
-                break;
             }
-            payload = config;
             break;
-        }
-        case packet_type::transmit: {
-            TransmitRequest request;
-            if (!request.ParseFromArray(buffer.data() + sizeof(header),
-                                        buffer.size() - sizeof(header))) {
+        case packet_type::transmit:
+            if (!parse_in_place<TransmitRequest>(buffer, payload)) {
                 log::warn("[Serial Service] TX failed: unable to parse frame packet");
                 payload = error_payload {};
-                break;
             }
-            payload = request;
             break;
-        }
-        case packet_type::receive: {
-            ReceiveResponse response;
-            if (!response.ParseFromArray(buffer.data() + sizeof(header),
-                                         buffer.size() - sizeof(header))) {
+        case packet_type::receive:
+            if (!parse_in_place<ReceiveResponse>(buffer, payload)) {
                 log::warn("[Serial Service] RX failed: unable to parse frame packet");
                 payload = error_payload {};
-                break;
             }
-            payload = response;
             break;
-        }
-        default: {
+        default:
             payload = error_payload {};
             break;
-        }
     }
 }
 
@@ -114,4 +130,14 @@ auto serial::packet::encode(const payload_t& payload, buffer_t& buffer) noexcept
         payload);
 }
 
+auto packet::encode_receive(span<const uint8_t> response, buffer_t& buffer) noexcept -> void {
+    packet_header header;
+    header.magic = magic;
+    header.type = packet_type::receive;
+
+    buffer.resize(sizeof(header) + response.size());
+    memcpy(buffer.data(), &header, sizeof(header));
+    std::copy(response.begin(), response.end(), buffer.begin() + sizeof(header));
+}
+
 } // namespace kaonic::comm::serial
@@ -1,202 +1,935 @@
 #include "kaonic/comm/services/grpc_service.hpp"
 
+#include "kaonic/comm/services/radio_frame.hpp"
 #include "kaonic/common/logging.hpp"
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstddef>
+#include <optional>
 #include <thread>
 
+#include <google/protobuf/arena.h>
+#include <grpcpp/alarm.h>
+#include <grpcpp/server_builder.h>
+
 using namespace std::chrono_literals;
 
 namespace kaonic::comm {
 
-constexpr static auto pop_timeout = 50ms;
+// Block allocated along with a unary call for its messages. A request with a frame of a few
+// hundred bytes is parsed without reaching the allocator, the string of a bytes payload is
+// still taken from the heap.
+constexpr static size_t call_arena_size = 4096;
+
+// Transmit waits for room in a full TX queue without holding a queue thread
+constexpr static auto tx_retry_interval = 5ms;
+constexpr static auto tx_retry_timeout = 1s;
 
-static auto grpc_buf_pack(const RadioFrame& src, std::vector<uint8_t>& dst) -> void {
-    const auto& data = src.data();
-    dst.resize(data.size() * sizeof(uint32_t));
-    memcpy(dst.data(), data.data(), data.size() * sizeof(uint32_t));
-    dst.resize(src.length());
+// Clients address every node in range with destination 0
+static auto grpc_destination(uint64_t destination) -> uint64_t {
+    return destination ? destination : mesh::broadcast_id;
 }
 
-static auto grpc_buf_unpack(const std::vector<uint8_t>& src, RadioFrame& dst) -> void {
-    auto data = dst.mutable_data();
+// Message of the raw stream, the slice holds a reference to the pooled buffer so the bytes are
+// handed to gRPC without a copy
+static auto grpc_message(const mesh::frame_buffer& buffer) -> ::grpc::ByteBuffer {
+    if (buffer.empty()) {
+        ::grpc::Slice empty;
+        return ::grpc::ByteBuffer { &empty, 1 };
+    }
 
-    size_t dst_size = src.size() / sizeof(uint32_t);
-    dst_size += (src.size() - dst_size * sizeof(uint32_t)) ? 1 : 0;
-    data->Resize(dst_size, 0);
-    std::memcpy(data->mutable_data(), src.data(), src.size());
+    auto* ref = new mesh::frame_buffer { buffer };
+    ::grpc::Slice slice { ref->data(),
+                          ref->size(),
+                          [](void* ref) { delete static_cast<mesh::frame_buffer*>(ref); },
+                          ref };
 
-    dst.set_length(src.size());
+    return ::grpc::ByteBuffer { &slice, 1 };
 }
 
-grpc_radio_listener::grpc_radio_listener(const std::shared_ptr<grpc_service>& service) noexcept
-    : _grpc_service { service } {}
+// Messages of a unary call, freed all at once with the call
+class call_arena final {
 
-auto grpc_radio_listener::on_receive(const mesh::frame& frame) -> void {
-    _grpc_service->receive_frame(frame);
-}
+public:
+    call_arena() noexcept
+        : _arena { options(_block) } {}
 
-grpc_service::grpc_service(const std::shared_ptr<radio_service>& service,
-                           std::string_view version) noexcept
-    : Radio::Service {}
-    , _radio_service { service }
-    , _version { version } {}
-
-auto grpc_service::Configure(::grpc::ServerContext* context,
-                             const ConfigurationRequest* request,
-                             Empty* response) -> ::grpc::Status {
-    if (!_radio_service) {
-        log::error("[GRPC service] Unable to configure radio: radio service wasn't initialized");
-        return ::grpc::Status(::grpc::StatusCode::FAILED_PRECONDITION,
-                              "Unable to configure radio: radio service wasn't initialized");
+    template <class T>
+    [[nodiscard]] auto make() -> T& {
+        return *google::protobuf::Arena::CreateMessage<T>(&_arena);
     }
 
-    const auto module = request->module();
-    const auto freq = request->freq();
-    const auto channel = request->channel();
-    const auto channel_spacing = request->channel_spacing();
-    const auto tx_power = request->tx_power();
+protected:
+    call_arena(const call_arena&) = delete;
+    call_arena(call_arena&&) = delete;
 
-    radio_phy_config_t phy_config = radio_phy_config_ofdm {};
+    call_arena& operator=(const call_arena&) = delete;
+    call_arena& operator=(call_arena&&) = delete;
 
-    if (request->has_ofdm()) {
-        phy_config = radio_phy_config_ofdm {
-            .mcs = request->ofdm().mcs(),
-            .opt = request->ofdm().opt(),
-        };
-    }
-    if (request->has_fsk()) {
-        phy_config = radio_phy_config_fsk {
-            .bt = static_cast<uint8_t>(request->fsk().bt()),
-            .midxs = static_cast<uint8_t>(request->fsk().midxs()),
-            .midx = static_cast<uint8_t>(request->fsk().midx()),
-            .mord = static_cast<uint8_t>(request->fsk().mord()),
-            .preamble_length = static_cast<uint16_t>(request->fsk().preamble_length()),
-            .freq_inversion = request->fsk().freq_inversion(),
-            .srate = static_cast<uint8_t>(request->fsk().srate()),
-            .pdtm = static_cast<uint8_t>(request->fsk().pdtm()),
-            .rxo = static_cast<uint8_t>(request->fsk().rxo()),
-            .rxpto = static_cast<uint8_t>(request->fsk().rxpto()),
-            .mse = static_cast<uint8_t>(request->fsk().mse()),
-            .preamble_inversion = request->fsk().preamble_inversion(),
-            .fecs = static_cast<uint8_t>(request->fsk().fecs()),
-            .fecie = request->fsk().fecie(),
-            .sfdt = static_cast<uint8_t>(request->fsk().sfdt()),
-            .pdt = static_cast<uint8_t>(request->fsk().pdt()),
-            .sftq = request->fsk().sftq(),
-            .sfd32 = static_cast<uint8_t>(request->fsk().sfd32()),
-            .rawbit = request->fsk().rawbit(),
-            .csfd1 = static_cast<uint8_t>(request->fsk().csfd1()),
-            .csfd0 = static_cast<uint8_t>(request->fsk().csfd0()),
-            .sfd0 = static_cast<uint8_t>(request->fsk().sfd0()),
-            .sfd1 = static_cast<uint8_t>(request->fsk().sfd1()),
-            .sfd = static_cast<uint8_t>(request->fsk().sfd()),
-            .dw = static_cast<uint8_t>(request->fsk().dw()),
-            .pe = request->fsk().pe(),
-            .en = request->fsk().en(),
-            .fskpe0 = static_cast<uint8_t>(request->fsk().fskpe0()),
-            .fskpe1 = static_cast<uint8_t>(request->fsk().fskpe1()),
-            .fskpe2 = static_cast<uint8_t>(request->fsk().fskpe2()),
-        };
+private:
+    static auto options(std::array<char, call_arena_size>& block) noexcept
+        -> google::protobuf::ArenaOptions {
+        google::protobuf::ArenaOptions options;
+        options.initial_block = block.data();
+        options.initial_block_size = block.size();
+        return options;
     }
 
-    radio_config config {
-        .freq = freq,
-        .channel = static_cast<uint8_t>(channel),
-        .channel_spacing = channel_spacing,
-        .phy_config = phy_config,
+private:
+    alignas(std::max_align_t) std::array<char, call_arena_size> _block;
+    google::protobuf::Arena _arena;
+};
+
+// Call in progress on a completion queue. The queue hands back the tag of an operation once
+// it's done, it belongs to a single thread so events of a call are handled one at a time.
+class grpc_service::call {
+
+public:
+    enum class op {
+        request,
+        read,
+        write,
+        wake,
+        done,
+        finish,
     };
 
-    if (auto err = _radio_service->configure(module, config); !err.is_ok()) {
-        log::error("[GRPC service] Unable to configure radio");
-        return ::grpc::Status(::grpc::StatusCode::INTERNAL, "Unable to configure radio");
+    struct tag final {
+        call* owner;
+        op what;
+    };
+
+    explicit call(grpc_service& service, ::grpc::ServerCompletionQueue* queue) noexcept
+        : _service { service }
+        , _queue { queue } {
+        for (size_t i = 0; i < _tags.size(); ++i) {
+            _tags[i] = tag { this, static_cast<op>(i) };
+        }
     }
 
-    return ::grpc::Status::OK;
-}
+    virtual ~call() = default;
 
-auto grpc_service::Transmit(::grpc::ServerContext* context,
-                            const TransmitRequest* request,
-                            TransmitResponse* response) -> ::grpc::Status {
-    if (!_radio_service) {
-        log::error("[GRPC service] Unable to transmit: radio service wasn't initialized");
-        return ::grpc::Status(::grpc::StatusCode::FAILED_PRECONDITION,
-                              "Unable to transmit: radio service wasn't initialized");
+    // Waits for the next call of its kind on the queue
+    template <class T>
+    static auto spawn(grpc_service& service, ::grpc::ServerCompletionQueue* queue) -> void {
+        auto* next = new T { service, queue };
+        if (!service.start_operation([next] { next->listen(); })) {
+            delete next;
+        }
+    }
+
+    // ok is false when the operation didn't complete, e.g. the call was cancelled
+    virtual auto proceed(op what, bool ok) -> void = 0;
+
+protected:
+    [[nodiscard]] auto tag_of(op what) noexcept -> void* {
+        return &_tags[static_cast<size_t>(what)];
     }
-    const auto& module = request->module();
-    const auto& frame = request->frame();
 
-    grpc_buf_pack(frame, _tx_frame.buffer);
+protected:
+    grpc_service& _service;
+    ::grpc::ServerCompletionQueue* const _queue;
 
-    auto err = _radio_service->transmit(module, _tx_frame);
+    ::grpc::ServerContext _context;
 
-    if (!err.is_ok()) {
-        log::error("[GRPC service] Unable to transmit");
-        return ::grpc::Status(::grpc::StatusCode::INTERNAL, "Unable to transmit");
+private:
+    std::array<tag, 6> _tags;
+};
+
+class grpc_service::configure_call final : public call {
+
+public:
+    using call::call;
+
+    auto listen() -> void {
+        _service._service.RequestConfigure(
+            &_context, &_request, &_responder, _queue, _queue, tag_of(op::request));
     }
 
-    return ::grpc::Status::OK;
+    auto proceed(op what, bool ok) -> void final {
+        if (what != op::request || !ok) {
+            delete this;
+            return;
+        }
+
+        spawn<configure_call>(_service, _queue);
+
+        // Waits for the network's update thread, configuration is rare and quick
+        const auto status = _service.configure(_request);
+
+        if (!_service.start_operation(
+                [&] { _responder.Finish(_response, status, tag_of(op::finish)); })) {
+            delete this;
+        }
+    }
+
+private:
+    call_arena _arena;
+    ConfigurationRequest& _request = _arena.make<ConfigurationRequest>();
+    Empty& _response = _arena.make<Empty>();
+    ::grpc::ServerAsyncResponseWriter<Empty> _responder { &_context };
+};
+
+class grpc_service::transmit_call final : public call {
+
+public:
+    using call::call;
+
+    auto listen() -> void {
+        _service._service.RequestTransmit(
+            &_context, &_request, &_responder, _queue, _queue, tag_of(op::request));
+    }
+
+    auto proceed(op what, bool ok) -> void final {
+        switch (what) {
+            case op::request:
+                if (!ok) {
+                    delete this;
+                    return;
+                }
+
+                spawn<transmit_call>(_service, _queue);
+
+                _deadline = std::chrono::steady_clock::now() + tx_retry_timeout;
+                send();
+                return;
+
+            case op::wake:
+                send();
+                return;
+
+            default:
+                delete this;
+                return;
+        }
+    }
+
+private:
+    auto send() -> void {
+        // Completed from the network's update thread, the call is left alone until then
+        const auto err = _service.transmit(
+            _request, [this](const mesh::tx_result& result) { complete(result); });
+
+        if (err.code == error_code::not_ready && std::chrono::steady_clock::now() < _deadline) {
+            if (!_service.start_operation([this] {
+                    _alarm.Set(_queue,
+                               std::chrono::system_clock::now() + tx_retry_interval,
+                               tag_of(op::wake));
+                })) {
+                delete this;
+            }
+            return;
+        }
+
+        if (!err.is_ok()) {
+            log::error("[GRPC service] Unable to transmit");
+            finish(::grpc::Status(::grpc::StatusCode::INTERNAL, "Unable to transmit"));
+        }
+    }
+
+    auto complete(const mesh::tx_result& result) -> void {
+        if (!result.err.is_ok()) {
+            log::error("[GRPC service] Unable to transmit");
+            finish(::grpc::Status(::grpc::StatusCode::INTERNAL, "Unable to transmit"));
+            return;
+        }
+
+        // Queueing plus air time in microseconds
+        _response.set_latency(static_cast<uint32_t>(result.latency().count()));
+
+        finish(::grpc::Status::OK);
+    }
+
+    auto finish(const ::grpc::Status& status) -> void {
+        if (!_service.start_operation(
+                [&] { _responder.Finish(_response, status, tag_of(op::finish)); })) {
+            delete this;
+        }
+    }
+
+private:
+    call_arena _arena;
+    TransmitRequest& _request = _arena.make<TransmitRequest>();
+    TransmitResponse& _response = _arena.make<TransmitResponse>();
+    ::grpc::ServerAsyncResponseWriter<TransmitResponse> _responder { &_context };
+
+    ::grpc::Alarm _alarm;
+    std::chrono::steady_clock::time_point _deadline;
+};
+
+// Writes one frame at a time and goes idle once it has read everything published for it.
+// The producer wakes an idle stream through an alarm expiring right away, so the write is
+// started from the queue thread.
+class grpc_service::receive_call final : public call {
+
+public:
+    using call::call;
+
+    auto listen() -> void {
+        // Delivered once the call has started, when it's finished or the client went away
+        _context.AsyncNotifyWhenDone(tag_of(op::done));
+
+        _service._service.RequestReceiveStream(
+            &_context, &_request_buffer, &_writer, _queue, _queue, tag_of(op::request));
+    }
+
+    auto proceed(op what, bool ok) -> void final {
+        // Never started, there is no done event to wait for
+        if (what == op::request && !ok) {
+            delete this;
+            return;
+        }
+
+        switch (what) {
+            case op::request:
+                ++_pending;
+                spawn<receive_call>(_service, _queue);
+                start();
+                break;
+
+            case op::write:
+                --_pending;
+                _writing = false;
+                if (ok) {
+                    pump();
+                } else {
+                    release();
+                }
+                break;
+
+            case op::wake:
+                --_pending;
+                _wake_pending = false;
+                pump();
+                break;
+
+            case op::done:
+                --_pending;
+                release();
+                _closed = true;
+                break;
+
+            case op::read:
+            case op::finish:
+                --_pending;
+                break;
+        }
+
+        if (_closed && _pending == 0) {
+            delete this;
+        }
+    }
+
+private:
+    auto start() -> void {
+        if (!::grpc::SerializationTraits<ReceiveRequest>::Deserialize(&_request_buffer, &_request)
+                 .ok()) {
+            log::error("[GRPC service] Unable to set receive stream: invalid request");
+            finish(::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                                  "Unable to set receive stream: invalid request"));
+            return;
+        }
+
+        const auto module = _request.module();
+        auto* ring = module >= 0 ? _service._publisher->ring(module, _request.encoding()) : nullptr;
+        if (!ring) {
+            log::error("[GRPC service] Unable to set receive stream: invalid module index");
+            finish(::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                                  "Unable to set receive stream: invalid module index"));
+            return;
+        }
+
+        log::info("grpc: start receive stream [{}]", static_cast<int>(module));
+
+        _subscriber.emplace(*ring, _service._config.stream, [this] { wake(); });
+
+        // Client learns the stream is open before the first frame
+        write(grpc_message({}));
+    }
+
+    auto pump() -> void {
+        if (!_subscriber || _writing) {
+            return;
+        }
+
+        // Producer claims the wakeup from here on, a frame it publishes after the pop below
+        // wakes the stream
+        const auto arm = !_wake_pending;
+        if (arm) {
+            _idle.store(true);
+        }
+
+        mesh::frame frame;
+        const auto popped = _subscriber->pop(frame, 0ms);
+        const auto disconnected = !popped && _subscriber->is_disconnected();
+
+        if ((popped || disconnected) && arm && !_idle.exchange(false)) {
+            // Claimed in the meantime, its event is still to come
+            _wake_pending = true;
+        }
+
+        if (popped) {
+            // Serialized by the producer, the stream only hands the bytes on
+            write(grpc_message(frame.buffer));
+            return;
+        }
+
+        if (disconnected) {
+            log::warn("grpc: receive stream fell behind by {} frames",
+                      _subscriber->get_stats().lag);
+            finish(::grpc::Status(::grpc::StatusCode::RESOURCE_EXHAUSTED,
+                                  "Receive stream fell behind"));
+        }
+    }
+
+    // Called by the producer with the ring locked
+    auto wake() -> void {
+        if (!_idle.exchange(false)) {
+            return;
+        }
+
+        ++_pending;
+        if (!_service.start_operation([this] {
+                _alarm.Set(_queue, std::chrono::system_clock::now(), tag_of(op::wake));
+            })) {
+            --_pending;
+        }
+    }
+
+    auto write(const ::grpc::ByteBuffer& message) -> void {
+        _writing = true;
+        ++_pending;
+
+        if (!_service.start_operation([&] { _writer.Write(message, tag_of(op::write)); })) {
+            _writing = false;
+            --_pending;
+            release();
+        }
+    }
+
+    auto finish(const ::grpc::Status& status) -> void {
+        release();
+
+        ++_pending;
+        if (!_service.start_operation([&] { _writer.Finish(status, tag_of(op::finish)); })) {
+            --_pending;
+        }
+    }
+
+    // No frame wakes the stream once it returns
+    auto release() -> void {
+        if (!_subscriber) {
+            return;
+        }
+
+        const auto stats = _subscriber->get_stats();
+        log::debug("grpc: stop receive stream, {} frames sent, {} dropped",
+                   stats.delivered,
+                   stats.dropped);
+
+        _subscriber.reset();
+    }
+
+private:
+    ::grpc::ByteBuffer _request_buffer;
+    ReceiveRequest _request;
+    ::grpc::ServerAsyncWriter<::grpc::ByteBuffer> _writer { &_context };
+
+    std::optional<mesh::frame_subscriber> _subscriber;
+
+    ::grpc::Alarm _alarm;
+
+    // Operations started and not yet handed back, the producer adds its wakeups
+    std::atomic<size_t> _pending { 0 };
+
+    std::atomic_bool _idle { false };
+    bool _wake_pending = false;
+    bool _writing = false;
+    bool _closed = false;
+};
+
+// Reads the next frame once the previous one is in the TX queue, so a client sending faster
+// than the radio is held back by flow control. Acks of the frames sent while a write is in
+// flight go out together with the next write.
+class grpc_service::transmit_stream_call final : public call {
+
+public:
+    using call::call;
+
+    auto listen() -> void {
+        _context.AsyncNotifyWhenDone(tag_of(op::done));
+
+        _service._service.RequestTransmitStream(
+            &_context, &_stream, _queue, _queue, tag_of(op::request));
+    }
+
+    auto proceed(op what, bool ok) -> void final {
+        if (what == op::request && !ok) {
+            delete this;
+            return;
+        }
+
+        switch (what) {
+            case op::request:
+                {
+                    std::lock_guard lock { _mut };
+                    ++_pending;
+                }
+                spawn<transmit_stream_call>(_service, _queue);
+                log::debug("grpc: start transmit stream");
+                read();
+                break;
+
+            case op::read:
+                if (ok) {
+                    _deadline = std::chrono::steady_clock::now() + tx_retry_timeout;
+                    send();
+                } else {
+                    // Client is done sending, the stream ends once the last frame is acked
+                    std::lock_guard lock { _mut };
+                    _reads_done = true;
+                    flush();
+                }
+                break;
+
+            case op::wake:
+                send();
+                break;
+
+            case op::write:
+                {
+                    std::lock_guard lock { _mut };
+                    _writing = false;
+                    _broken = _broken || !ok;
+                    flush();
+                }
+                break;
+
+            case op::done:
+                {
+                    std::lock_guard lock { _mut };
+                    _closed = true;
+                }
+                break;
+
+            case op::finish:
+                break;
+        }
+
+        settle(what == op::request ? 0 : 1);
+    }
+
+private:
+    auto read() -> void {
+        {
+            std::lock_guard lock { _mut };
+            ++_pending;
+        }
+
+        if (!_service.start_operation([this] { _stream.Read(&_request, tag_of(op::read)); })) {
+            std::lock_guard lock { _mut };
+            --_pending;
+        }
+    }
+
+    auto send() -> void {
+        const auto sequence = _sequence;
+
+        {
+            std::lock_guard lock { _mut };
+            ++_in_flight;
+        }
+
+        // Completed from the network's update thread, maybe while the next frame is read
+        const auto err =
+            _service.transmit(_request, [this, sequence](const mesh::tx_result& result) {
+                acknowledge(sequence, result);
+            });
+
+        if (err.code == error_code::not_ready && std::chrono::steady_clock::now() < _deadline) {
+            std::lock_guard lock { _mut };
+            --_in_flight;
+            ++_pending;
+
+            if (!_service.start_operation([this] {
+                    _alarm.Set(_queue,
+                               std::chrono::system_clock::now() + tx_retry_interval,
+                               tag_of(op::wake));
+                })) {
+                --_pending;
+            }
+            return;
+        }
+
+        if (!err.is_ok()) {
+            log::error("[GRPC service] Unable to transmit");
+
+            std::lock_guard lock { _mut };
+            --_in_flight;
+            add_ack(sequence, mesh::tx_result { .err = err });
+        }
+
+        ++_sequence;
+        read();
+    }
+
+    // No operation of the queue thread keeps the call alive here, the ack and the check whether
+    // it was the last thing the call waited for are one step
+    auto acknowledge(uint64_t sequence, const mesh::tx_result& result) -> void {
+        bool last = false;
+
+        {
+            std::lock_guard lock { _mut };
+            --_in_flight;
+            add_ack(sequence, result);
+            last = is_finished();
+        }
+
+        if (last) {
+            destroy();
+        }
+    }
+
+    // Lock is held
+    auto add_ack(uint64_t sequence, const mesh::tx_result& result) -> void {
+        auto* ack = _acks.add_acks();
+        ack->set_sequence(sequence);
+        ack->set_sent(result.err.is_ok());
+
+        if (result.err.is_ok()) {
+            ack->set_latency(static_cast<uint32_t>(result.latency().count()));
+        }
+
+        flush();
+    }
+
+    // Writes the acks gathered so far, or finishes the stream once nothing is left. Lock is held.
+    auto flush() -> void {
+        if (_writing || _finishing) {
+            return;
+        }
+
+        // Client went away, nobody reads the acks
+        if (_broken) {
+            _acks.clear_acks();
+        }
+
+        if (_acks.acks_size() != 0) {
+            // Cleared acks keep their memory for the next batch
+            _response.Swap(&_acks);
+            _acks.clear_acks();
+
+            _writing = true;
+            ++_pending;
+
+            if (!_service.start_operation(
+                    [this] { _stream.Write(_response, tag_of(op::write)); })) {
+                _writing = false;
+                _broken = true;
+                --_pending;
+            }
+            return;
+        }
+
+        if (_reads_done && _in_flight == 0) {
+            _finishing = true;
+            ++_pending;
+
+            if (!_service.start_operation(
+                    [this] { _stream.Finish(::grpc::Status::OK, tag_of(op::finish)); })) {
+                --_pending;
+            }
+        }
+    }
+
+    // Takes back 'handled' operations, the last one of a closed stream deletes it
+    auto settle(size_t handled) -> void {
+        bool last = false;
+
+        {
+            std::lock_guard lock { _mut };
+            _pending -= handled;
+            last = is_finished();
+        }
+
+        if (last) {
+            destroy();
+        }
+    }
+
+    // Nothing is left to hand the call back, lock is held
+    [[nodiscard]] auto is_finished() const noexcept -> bool {
+        return _closed && _pending == 0 && _in_flight == 0;
+    }
+
+    auto destroy() -> void {
+        log::debug("grpc: stop transmit stream, {} frames", _sequence);
+        delete this;
+    }
+
+private:
+    // Every frame is parsed into the same request, its fields keep their memory
+    TransmitRequest _request;
+    ::grpc::ServerAsyncReaderWriter<TransmitStreamResponse, TransmitRequest> _stream { &_context };
+
+    ::grpc::Alarm _alarm;
+    std::chrono::steady_clock::time_point _deadline;
+
+    // Position of the frame being read, only touched by the queue thread
+    uint64_t _sequence = 0;
+
+    // Guard everything below, TX callbacks come from the update thread
+    std::mutex _mut;
+
+    TransmitStreamResponse _acks;
+    TransmitStreamResponse _response;
+
+    size_t _pending = 0;
+    size_t _in_flight = 0;
+
+    bool _reads_done = false;
+    bool _writing = false;
+    bool _finishing = false;
+    bool _broken = false;
+    bool _closed = false;
+};
+
+grpc_service::grpc_service(const std::shared_ptr<radio_service>& service,
+                           const std::shared_ptr<response_publisher>& publisher,
+                           std::string_view version,
+                           const grpc_config& config) noexcept
+    : _radio_service { service }
+    , _publisher { publisher }
+    , _version { version }
+    , _config { config } {}
+
+grpc_service::~grpc_service() {
+    stop();
 }
 
-auto grpc_service::ReceiveStream(::grpc::ServerContext* context,
-                                 const ReceiveRequest* request,
-                                 ::grpc::ServerWriter<ReceiveResponse>* writer) -> ::grpc::Status {
+auto grpc_service::start() -> error {
     if (!_radio_service) {
-        log::error("[GRPC service] Unable to set receive stream: radio service wasn't initialized");
-        return ::grpc::Status(::grpc::StatusCode::FAILED_PRECONDITION,
-                              "Unable to set receive stream: radio service wasn't initialized");
+        log::error("[GRPC service] Unable to start: radio service wasn't initialized");
+        return error::precondition_failed();
+    }
+
+    if (!_publisher) {
+        log::error("[GRPC service] Unable to start: response publisher wasn't initialized");
+        return error::precondition_failed();
     }
 
-    log::info("grpc: start receive stream");
+    if (_server) {
+        return error::precondition_failed();
+    }
 
-    ReceiveResponse response;
+    ::grpc::ServerBuilder builder;
+    builder.AddListeningPort(_config.address, ::grpc::InsecureServerCredentials(), &_port);
+    builder.RegisterService(&_service);
 
-    auto frame = response.mutable_frame();
+    for (size_t i = 0; i < std::max<size_t>(_config.threads, 1); ++i) {
+        _queues.push_back(builder.AddCompletionQueue());
+    }
 
-    writer->Write(response);
+    _server = builder.BuildAndStart();
+    if (!_server) {
+        log::error("[GRPC service] Unable to listen on {}", _config.address);
 
-    while (context && !context->IsCancelled()) {
+        for (auto& queue : _queues) {
+            queue->Shutdown();
 
-        if (!pop_frame(_rx_frame, pop_timeout)) {
-            continue;
+            void* tag = nullptr;
+            bool ok = false;
+            while (queue->Next(&tag, &ok)) {}
         }
+        _queues.clear();
+
+        return error::fail();
+    }
 
-        grpc_buf_unpack(_rx_frame.buffer, *frame);
+    {
+        std::unique_lock lock { _queue_mut };
+        _queues_open = true;
+    }
+
+    {
+        std::lock_guard lock { _state_mut };
+        _accepting = true;
+        _running = true;
+    }
+
+    for (const auto& queue : _queues) {
+        call::spawn<configure_call>(*this, queue.get());
+        call::spawn<transmit_call>(*this, queue.get());
+        call::spawn<receive_call>(*this, queue.get());
+        call::spawn<transmit_stream_call>(*this, queue.get());
 
-        if (!writer || !writer->Write(response)) {
-            log::error("[Radio Service] Unable to write to the client stream");
-            return ::grpc::Status(::grpc::StatusCode::ABORTED,
-                                  "Unable to write to the client stream");
+        _threads.emplace_back(&grpc_service::serve, this, queue.get());
+    }
+
+    log::info("grpc: listening on port {} with {} threads", _port, _threads.size());
+
+    return error::ok();
+}
+
+auto grpc_service::stop() -> void {
+    if (!_server) {
+        return;
+    }
+
+    // Streams are cancelled right away, queue threads clean them up
+    _server->Shutdown(std::chrono::system_clock::now());
+
+    {
+        // Transmits finish their calls from the update threads, the queues are kept for them
+        std::unique_lock lock { _state_mut };
+        _accepting = false;
+        _state_cond.wait(lock, [this] { return _transmits == 0; });
+    }
+
+    {
+        std::unique_lock lock { _queue_mut };
+        _queues_open = false;
+    }
+
+    for (auto& queue : _queues) {
+        queue->Shutdown();
+    }
+
+    for (auto& thread : _threads) {
+        if (thread.joinable()) {
+            thread.join();
         }
     }
 
-    log::debug("grpc: stop receive stream");
+    _threads.clear();
+    _queues.clear();
+    _server.reset();
 
-    return ::grpc::Status::OK;
+    {
+        std::lock_guard lock { _state_mut };
+        _running = false;
+    }
+
+    _state_cond.notify_all();
+}
+
+auto grpc_service::wait() -> void {
+    std::unique_lock lock { _state_mut };
+    _state_cond.wait(lock, [this] { return !_running; });
 }
 
-auto grpc_service::receive_frame(const mesh::frame& frame) -> void {
-    std::unique_lock<std::mutex> lock(_mut);
+auto grpc_service::serve(::grpc::ServerCompletionQueue* queue) -> void {
+    void* tag = nullptr;
+    bool ok = false;
 
-    if (_frame_queue.size() >= 64) {
-        _frame_queue.pop();
+    // Returns false once the queue is shut down and drained
+    while (queue->Next(&tag, &ok)) {
+        const auto* event = static_cast<call::tag*>(tag);
+        event->owner->proceed(event->what, ok);
+    }
+}
+
+auto grpc_service::configure(const ConfigurationRequest& request) -> ::grpc::Status {
+    const auto module = request.module();
+    const auto freq = request.freq();
+    const auto channel = request.channel();
+    const auto channel_spacing = request.channel_spacing();
+    const auto tx_power = request.tx_power();
+
+    radio_phy_config_t phy_config = radio_phy_config_ofdm {};
+
+    if (request.has_ofdm()) {
+        phy_config = radio_phy_config_ofdm {
+            .mcs = request.ofdm().mcs(),
+            .opt = request.ofdm().opt(),
+        };
+    }
+    if (request.has_fsk()) {
+        phy_config = radio_phy_config_fsk {
+            .bt = static_cast<uint8_t>(request.fsk().bt()),
+            .midxs = static_cast<uint8_t>(request.fsk().midxs()),
+            .midx = static_cast<uint8_t>(request.fsk().midx()),
+            .mord = static_cast<uint8_t>(request.fsk().mord()),
+            .preamble_length = static_cast<uint16_t>(request.fsk().preamble_length()),
+            .freq_inversion = request.fsk().freq_inversion(),
+            .srate = static_cast<uint8_t>(request.fsk().srate()),
+            .pdtm = static_cast<uint8_t>(request.fsk().pdtm()),
+            .rxo = static_cast<uint8_t>(request.fsk().rxo()),
+            .rxpto = static_cast<uint8_t>(request.fsk().rxpto()),
+            .mse = static_cast<uint8_t>(request.fsk().mse()),
+            .preamble_inversion = request.fsk().preamble_inversion(),
+            .fecs = static_cast<uint8_t>(request.fsk().fecs()),
+            .fecie = request.fsk().fecie(),
+            .sfdt = static_cast<uint8_t>(request.fsk().sfdt()),
+            .pdt = static_cast<uint8_t>(request.fsk().pdt()),
+            .sftq = request.fsk().sftq(),
+            .sfd32 = static_cast<uint8_t>(request.fsk().sfd32()),
+            .rawbit = request.fsk().rawbit(),
+            .csfd1 = static_cast<uint8_t>(request.fsk().csfd1()),
+            .csfd0 = static_cast<uint8_t>(request.fsk().csfd0()),
+            .sfd0 = static_cast<uint8_t>(request.fsk().sfd0()),
+            .sfd1 = static_cast<uint8_t>(request.fsk().sfd1()),
+            .sfd = static_cast<uint8_t>(request.fsk().sfd()),
+            .dw = static_cast<uint8_t>(request.fsk().dw()),
+            .pe = request.fsk().pe(),
+            .en = request.fsk().en(),
+            .fskpe0 = static_cast<uint8_t>(request.fsk().fskpe0()),
+            .fskpe1 = static_cast<uint8_t>(request.fsk().fskpe1()),
+            .fskpe2 = static_cast<uint8_t>(request.fsk().fskpe2()),
+        };
     }
 
-    _frame_queue.push(frame);
-    _frame_queue_cond.notify_one();
+    radio_config config {
+        .freq = freq,
+        .channel = static_cast<uint8_t>(channel),
+        .channel_spacing = channel_spacing,
+        .tx_power = tx_power,
+        .phy_config = phy_config,
+    };
+
+    if (auto err = _radio_service->configure(module, config); !err.is_ok()) {
+        log::error("[GRPC service] Unable to configure radio");
+        return ::grpc::Status(::grpc::StatusCode::INTERNAL, "Unable to configure radio");
+    }
+
+    return ::grpc::Status::OK;
 }
 
-auto grpc_service::pop_frame(mesh::frame& frame, std::chrono::milliseconds timeout) -> bool {
-    std::unique_lock<std::mutex> lock(_mut);
+auto grpc_service::transmit(const TransmitRequest& request, mesh::tx_callback callback)
+    -> error {
+    auto view = radio_frame_view(request.frame());
+    view.info.destination = grpc_destination(request.destination());
 
-    if (!_frame_queue_cond.wait_for(lock, timeout, [this] { return !_frame_queue.empty(); })) {
-        return false;
+    {
+        std::lock_guard lock { _state_mut };
+        if (!_accepting) {
+            return error::precondition_failed();
+        }
+        ++_transmits;
     }
 
-    frame = _frame_queue.front();
-    _frame_queue.pop();
+    const auto done = [this] {
+        {
+            std::lock_guard lock { _state_mut };
+            --_transmits;
+        }
+        _state_cond.notify_all();
+    };
+
+    // Payload is copied into the TX queue, the request may go away before it's sent
+    auto err = _radio_service->transmit_async(
+        request.module(), view, [callback = std::move(callback), done](const auto& result) {
+            callback(result);
+            done();
+        });
+
+    if (!err.is_ok()) {
+        done();
+    }
 
-    return true;
+    return err;
 }
 
 } // namespace kaonic::comm
@@ -0,0 +1,74 @@
+#include "kaonic/comm/services/radio_frame.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "kaonic/common/copy_stats.hpp"
+
+namespace kaonic::comm {
+
+// Microseconds between the radio IRQ of a frame and now
+static auto radio_frame_latency(std::chrono::nanoseconds timestamp) -> uint32_t {
+    if (timestamp.count() == 0) {
+        return 0;
+    }
+
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(now - timestamp);
+
+    return static_cast<uint32_t>(std::max<int64_t>(latency.count(), 0));
+}
+
+auto radio_frame_view(const RadioFrame& frame) -> mesh::frame_view {
+    // Bytes alias the string of the message, nothing is repacked
+    if (!frame.payload().empty()) {
+        const auto& payload = frame.payload();
+        return span<const uint8_t> { reinterpret_cast<const uint8_t*>(payload.data()),
+                                     payload.size() };
+    }
+
+    const auto& data = frame.data();
+    const auto size = std::min<size_t>(frame.length(), data.size() * sizeof(uint32_t));
+    return span<const uint8_t> { reinterpret_cast<const uint8_t*>(data.data()), size };
+}
+
+auto radio_frame_pack(span<const uint8_t> payload, FrameEncoding encoding, RadioFrame& frame)
+    -> void {
+    copy_counter::count_rx(payload.size());
+
+    if (encoding == FRAME_ENCODING_BYTES) {
+        frame.clear_data();
+        frame.clear_length();
+        frame.mutable_payload()->assign(reinterpret_cast<const char*>(payload.data()),
+                                        payload.size());
+        return;
+    }
+
+    frame.clear_payload();
+
+    // Last word is padded with zeros
+    auto data = frame.mutable_data();
+    data->Resize((payload.size() + sizeof(uint32_t) - 1) / sizeof(uint32_t), 0);
+    if (!payload.empty()) {
+        data->Set(data->size() - 1, 0);
+        std::memcpy(data->mutable_data(), payload.data(), payload.size());
+    }
+
+    frame.set_length(payload.size());
+}
+
+auto radio_frame_response(const mesh::frame_view& frame,
+                          FrameEncoding encoding,
+                          ReceiveResponse& response) -> void {
+    radio_frame_pack(frame.buffer, encoding, *response.mutable_frame());
+
+    response.set_module(static_cast<RadioModule>(frame.info.module));
+    response.set_rssi(frame.info.rssi);
+    response.set_edv(frame.info.edv);
+    response.set_timestamp(frame.info.timestamp.count());
+    response.set_source(frame.info.source);
+    response.set_latency(radio_frame_latency(frame.info.timestamp));
+}
+
+} // namespace kaonic::comm
@@ -8,10 +8,37 @@ using namespace std::chrono_literals;
 
 namespace kaonic::comm {
 
+radio_module_receiver::radio_module_receiver(
+    uint8_t module, const std::shared_ptr<mesh::network_receiver>& receiver) noexcept
+    : _module { module }
+    , _receiver { receiver } {}
+
+auto radio_module_receiver::on_receive(const mesh::frame_view& frame) -> void {
+    auto tagged = frame;
+    tagged.info.module = _module;
+
+    _receiver->on_receive(tagged);
+}
+
+auto radio_module_receiver::on_receive_pooled(const mesh::frame& frame) -> void {
+    auto tagged = frame;
+    tagged.info.module = _module;
+
+    _receiver->on_receive_pooled(tagged);
+}
+
 radio_service::radio_service(const mesh::config& config,
-                             const std::vector<std::shared_ptr<radio>>& radios) noexcept
-    : _radios { radios }
-    , _radio_broadcasters { _radios.size(), std::make_shared<mesh::network_broadcast_receiver>() } {
+                             const std::vector<std::shared_ptr<radio>>& radios,
+                             size_t pool_size,
+                             std::chrono::seconds stats_interval) noexcept
+    : _frame_pool { std::make_shared<mesh::frame_pool>(pool_size) }
+    , _radios { radios }
+    , _dedup_filter { std::make_shared<mesh::dedup_filter>(mesh::dedup_config {}) } {
+
+    for (size_t i = 0; i < _radios.size(); ++i) {
+        _radio_broadcasters.push_back(
+            std::make_shared<mesh::network_broadcast_receiver>(_dedup_filter, _frame_pool));
+    }
 
     for (size_t i = 0; i < _radios.size(); ++i) {
 
@@ -20,15 +47,71 @@ radio_service::radio_service(const mesh::config& config,
 
         log::debug("radio: create network [{}]", i);
 
+        const auto receiver =
+            std::make_shared<radio_module_receiver>(i, _radio_broadcasters[i]);
+
         auto net =
-            std::make_shared<mesh::radio_network>(net_config, _radios[i], _radio_broadcasters[i]);
+            std::make_shared<mesh::radio_network>(net_config, _radios[i], receiver, _frame_pool);
 
         _radio_networks.push_back(net);
     }
 
-    for (const auto& net : _radio_networks) {
-        log::debug("radio: start network");
-        auto err = net->start();
+    for (size_t i = 0; i < _radio_networks.size(); ++i) {
+        log::debug("radio: start network [{}]", i);
+        if (auto err = _radio_networks[i]->start(); !err.is_ok()) {
+            log::error("radio: unable to start network [{}]", i);
+        }
+    }
+
+    if (stats_interval.count() > 0) {
+        _stats_thread = std::thread(&radio_service::stats_loop, this, stats_interval);
+    }
+}
+
+radio_service::~radio_service() {
+    {
+        std::lock_guard lock { _stats_mut };
+        _stopping = true;
+    }
+    _stats_cond.notify_all();
+
+    if (_stats_thread.joinable()) {
+        _stats_thread.join();
+    }
+
+    for (size_t i = 0; i < _radio_networks.size(); ++i) {
+        if (auto err = _radio_networks[i]->stop(); !err.is_ok()) {
+            log::error("radio: unable to stop network [{}]", i);
+        }
+    }
+}
+
+auto radio_service::log_stats() -> void {
+    for (size_t i = 0; i < _radio_networks.size(); ++i) {
+        const auto net = _radio_networks[i]->get_stats();
+        const auto cca = _radios[i]->get_channel_access_stats();
+
+        log::info("radio: [{}] tx={} rx={} cca attempts={} busy={} sent={} failed={} expired={} "
+                  "backoff={}us",
+                  i,
+                  net.tx_counter,
+                  net.rx_counter,
+                  cca.attempts,
+                  cca.busy,
+                  cca.success,
+                  cca.failed,
+                  cca.expired,
+                  cca.backoff_time.count());
+    }
+}
+
+auto radio_service::stats_loop(std::chrono::seconds interval) noexcept -> void {
+    std::unique_lock lock { _stats_mut };
+
+    while (!_stats_cond.wait_for(lock, interval, [this] { return _stopping; })) {
+        lock.unlock();
+        log_stats();
+        lock.lock();
     }
 }
 
@@ -41,13 +124,31 @@ auto radio_service::configure(uint8_t module, const radio_config& config) -> err
     return _radio_networks[module]->configure(config);
 }
 
-auto radio_service::transmit(uint8_t module, const mesh::frame& frame) -> error {
+auto radio_service::transmit(uint8_t module, const mesh::frame_view& frame) -> error {
+    mesh::tx_result result;
+    return transmit(module, frame, result);
+}
+
+auto radio_service::transmit(uint8_t module,
+                             const mesh::frame_view& frame,
+                             mesh::tx_result& result) -> error {
+    if (module >= _radio_networks.size()) {
+        log::error("radio_service: invalid module index for tx");
+        return error::invalid_arg();
+    }
+
+    return _radio_networks[module]->transmit(frame, result);
+}
+
+auto radio_service::transmit_async(uint8_t module,
+                                   const mesh::frame_view& frame,
+                                   mesh::tx_callback callback) -> error {
     if (module >= _radio_networks.size()) {
         log::error("radio_service: invalid module index for tx");
         return error::invalid_arg();
     }
 
-    return _radio_networks[module]->transmit(frame);
+    return _radio_networks[module]->transmit_async(frame, std::move(callback));
 }
 
 auto radio_service::attach_listener(
@@ -59,4 +160,17 @@ auto radio_service::attach_listener(
     }
 }
 
+auto radio_service::attach_listener(uint8_t module,
+                                     const std::shared_ptr<mesh::network_receiver>& listener,
+                                     const mesh::listener_config& config) noexcept -> error {
+    if (module >= _radio_broadcasters.size()) {
+        log::error("[Radio Service] Unable to attach listener: invalid module index");
+        return error::invalid_arg();
+    }
+
+    _radio_broadcasters[module]->attach_listener(listener, config);
+
+    return error::ok();
+}
+
 } // namespace kaonic::comm
@@ -0,0 +1,93 @@
+#include "kaonic/comm/services/response_publisher.hpp"
+
+#include <algorithm>
+
+#include "kaonic/comm/services/radio_frame.hpp"
+#include "kaonic/common/logging.hpp"
+
+namespace kaonic::comm {
+
+// Largest response, a full frame in words, serializes to about 2.6KB
+constexpr static size_t response_slot_size = 3072;
+
+// Encodings frames are read in, each has its own ring of serialized responses
+constexpr static std::array<FrameEncoding, 2> frame_encodings {
+    FRAME_ENCODING_WORDS,
+    FRAME_ENCODING_BYTES,
+};
+
+static auto encoding_index(FrameEncoding encoding) -> size_t {
+    return encoding == FRAME_ENCODING_BYTES ? 1 : 0;
+}
+
+// Response is serialized once into a pooled buffer, every consumer that writes it shares it
+static auto serialize(const ReceiveResponse& response, mesh::frame_pool& pool)
+    -> mesh::frame_buffer {
+    auto buffer = pool.allocate(response.ByteSizeLong());
+    if (buffer) {
+        response.SerializeWithCachedSizesToArray(buffer.data());
+    }
+
+    return buffer;
+}
+
+response_publisher::response_publisher(size_t modules, size_t ring_size) noexcept {
+    ring_size = std::max<size_t>(ring_size, 1);
+
+    // Enough for one encoding in use on every module, responses of a second one may spill
+    // onto the heap
+    _pool = std::make_unique<mesh::frame_pool>(std::max<size_t>(modules, 1) * ring_size,
+                                               response_slot_size);
+
+    for (size_t i = 0; i < modules; ++i) {
+        auto module = std::make_unique<module_rx>();
+        for (auto& ring : module->rings) {
+            ring = std::make_unique<mesh::frame_ring>(ring_size);
+        }
+
+        _modules.push_back(std::move(module));
+    }
+}
+
+auto response_publisher::ring(size_t module, FrameEncoding encoding) noexcept
+    -> mesh::frame_ring* {
+    if (module >= _modules.size()) {
+        return nullptr;
+    }
+
+    return _modules[module]->rings[encoding_index(encoding)].get();
+}
+
+auto response_publisher::on_receive(const mesh::frame_view& frame) -> void {
+    if (frame.info.module >= _modules.size()) {
+        log::error("[Response Publisher] Frame of unknown module {}", frame.info.module);
+        return;
+    }
+
+    auto& module = *_modules[frame.info.module];
+
+    for (size_t i = 0; i < frame_encodings.size(); ++i) {
+        auto& ring = *module.rings[i];
+        if (ring.subscriber_count() == 0) {
+            continue;
+        }
+
+        // Serialized once however many consumers read it, the response keeps its capacity
+        radio_frame_response(frame, frame_encodings[i], module.response);
+
+        mesh::frame response { serialize(module.response, *_pool), frame.info };
+        if (!response.buffer) {
+            log::error("[Response Publisher] No buffer for a {}B response",
+                       module.response.GetCachedSize());
+            continue;
+        }
+
+        ring.publish(response);
+    }
+}
+
+auto response_publisher::on_receive_pooled(const mesh::frame& frame) -> void {
+    on_receive(mesh::frame_view { frame });
+}
+
+} // namespace kaonic::comm
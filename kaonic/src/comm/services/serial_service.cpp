@@ -6,6 +6,7 @@
 #include <unistd.h>
 #include <zlib.h>
 
+#include "kaonic/comm/services/radio_frame.hpp"
 #include "kaonic/common/logging.hpp"
 
 using namespace std::chrono_literals;
@@ -15,36 +16,15 @@ namespace kaonic::comm {
 constexpr static auto rx_timeout = 100ms;
 constexpr static size_t max_hdlc_size = 10240;
 
-static auto buf_pack(const RadioFrame& src, std::vector<uint8_t>& dst) -> void {
-    const auto& data = src.data();
-    dst.resize(data.size() * sizeof(uint32_t));
-    memcpy(dst.data(), data.data(), data.size() * sizeof(uint32_t));
-    dst.resize(src.length());
-}
-
-static auto buf_unpack(const std::vector<uint8_t>& src, RadioFrame& dst) -> void {
-    auto data = dst.mutable_data();
-
-    size_t dst_size = src.size() / sizeof(uint32_t);
-    dst_size += (src.size() - dst_size * sizeof(uint32_t)) ? 1 : 0;
-    data->Resize(dst_size, 0);
-    std::memcpy(data->mutable_data(), src.data(), src.size());
-
-    dst.set_length(src.size());
-}
-
-serial_radio_listener::serial_radio_listener(
-    const std::shared_ptr<serial_service>& service) noexcept
-    : _serial_service { service } {}
-
-auto serial_radio_listener::on_receive(const mesh::frame& frame) -> void {
-    _serial_service->receive_frame(frame);
-}
+// Serial peers have no way to ask for bytes, they always get words
+constexpr static auto rx_encoding = FRAME_ENCODING_WORDS;
 
 serial_service::serial_service(const std::shared_ptr<serial::serial> serial,
-                               const std::shared_ptr<radio_service>& service) noexcept
+                               const std::shared_ptr<radio_service>& service,
+                               const std::shared_ptr<response_publisher>& publisher) noexcept
     : _serial { serial }
     , _radio_service { service }
+    , _publisher { publisher }
     , _hdlc_processor { max_hdlc_size } {
     if (!_serial) {
         log::error("[Serial Service] Serial wasn't initialized");
@@ -55,10 +35,23 @@ serial_service::serial_service(const std::shared_ptr<serial::serial> serial,
         log::error("[Serial Service] Radio service wasn't initialized");
         return;
     }
+
+    if (!_publisher) {
+        log::error("[Serial Service] Response publisher wasn't initialized");
+        return;
+    }
 }
 
 serial_service::~serial_service() {
-    _serial->close();
+    if (_write_thread.joinable()) {
+        if (auto err = stop_rx(); !err.is_ok()) {
+            log::warn("[Serial Service] Unable to stop RX");
+        }
+    }
+
+    if (_serial) {
+        _serial->close();
+    }
 }
 
 auto serial_service::start_tx() -> error {
@@ -137,8 +130,12 @@ auto serial_service::handle_packet(serial::payload_t& payload) noexcept -> void
                 }
             }
             if constexpr (std::is_same_v<T, TransmitRequest>) {
-                buf_pack(payload.frame(), _frame.buffer);
-                if (auto err = _radio_service->transmit(payload.module(), _frame); !err.is_ok()) {
+                auto view = radio_frame_view(payload.frame());
+                if (payload.destination()) {
+                    view.info.destination = payload.destination();
+                }
+
+                if (auto err = _radio_service->transmit(payload.module(), view); !err.is_ok()) {
                     log::warn("[Serial Service] TX failed: unable to transmit to the radio");
                     return;
                 }
@@ -166,14 +163,89 @@ auto serial_service::stop_tx() -> error {
     return error::ok();
 }
 
-auto serial_service::receive_frame(const mesh::frame& frame) -> void {
-    auto& radio_frame = *_rx_response.mutable_frame();
-    buf_unpack(frame.buffer, radio_frame);
+auto serial_service::start_rx() -> error {
+    if (!_publisher) {
+        log::error("[Serial Service] RX failed: response publisher wasn't initialized");
+        return error::precondition_failed();
+    }
+
+    if (_write_thread.joinable()) {
+        log::error("[Serial Service] RX is currently active");
+        return error::precondition_failed();
+    }
+
+    _rx_active = true;
+
+    // Called by the publisher with its ring locked
+    const auto wake = [this] {
+        {
+            std::lock_guard lock { _rx_mut };
+            _rx_pending = true;
+        }
+        _rx_cond.notify_one();
+    };
+
+    for (size_t i = 0; i < _publisher->module_count(); ++i) {
+        _rx_subscribers.push_back(std::make_unique<mesh::frame_subscriber>(
+            *_publisher->ring(i, rx_encoding), mesh::subscriber_config {}, wake));
+    }
+
+    _write_thread = std::thread(&serial_service::rx, this);
+
+    return error::ok();
+}
+
+auto serial_service::stop_rx() -> error {
+    if (!_write_thread.joinable()) {
+        log::error("[Serial Service] RX is not currently active");
+        return error::precondition_failed();
+    }
+
+    {
+        std::lock_guard lock { _rx_mut };
+        _rx_active = false;
+    }
+    _rx_cond.notify_one();
+
+    _write_thread.join();
+
+    // Publisher stops waking the thread before the subscribers go away
+    _rx_subscribers.clear();
+
+    return error::ok();
+}
+
+auto serial_service::rx() -> void {
+    std::unique_lock lock { _rx_mut };
+
+    while (true) {
+        _rx_cond.wait(lock, [this] { return _rx_pending || !_rx_active; });
+
+        if (!_rx_active) {
+            break;
+        }
+
+        _rx_pending = false;
+        lock.unlock();
+
+        mesh::frame frame;
+        for (const auto& subscriber : _rx_subscribers) {
+            while (subscriber->pop(frame, 0ms)) {
+                write_frame(frame);
+            }
+        }
+
+        lock.lock();
+    }
+}
 
-    serial::packet::encode(_rx_response, _rx_protobuf);
-    serial::hdlc::escape(_rx_protobuf, _escaped_buffer);
+auto serial_service::write_frame(const mesh::frame& frame) noexcept -> void {
+    // Response was serialized once by the publisher, it's only framed for the port
+    serial::packet::encode_receive(span<const uint8_t> { frame.buffer.data(), frame.buffer.size() },
+                                   _rx_packet);
+    serial::hdlc::escape(_rx_packet, _escaped_buffer);
 
-    if (_serial->write(_rx_protobuf.data(), _rx_protobuf.size()) != _rx_protobuf.size()) {
+    if (_serial->write(_rx_packet.data(), _rx_packet.size()) != _rx_packet.size()) {
         log::error("[Serial peripheral] Problem occured while writing to the serial port");
     }
 }
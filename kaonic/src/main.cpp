@@ -1,22 +1,23 @@
 #include "version.hpp"
 
 #include <algorithm>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
 
 #include "kaonic/common/logging.hpp"
 
 #include "kaonic/comm/mesh/radio_network.hpp"
 #include "kaonic/comm/radio/rf215_radio.hpp"
+#include "kaonic/comm/radio/sim_radio.hpp"
 #include "kaonic/comm/serial/serial.hpp"
 
 #include "kaonic/comm/services/grpc_service.hpp"
 #include "kaonic/comm/services/radio_service.hpp"
 
-#include <grpcpp/server_builder.h>
-
 using namespace kaonic;
 using namespace std::chrono_literals;
 
@@ -118,6 +119,105 @@ static auto select_machine_config() noexcept -> const kaonic_machine_config& {
     return machine_config_protoc;
 }
 
+struct commd_options {
+    // Use in-process simulated radios instead of RF215 hardware
+    bool simulate = false;
+    double sim_loss_rate = 0.0;
+    // Run RF09 and RF24 of frontend A as two independent radios
+    bool dual_band = false;
+    // Relay frames over several hops, every node of the mesh has to enable it
+    bool mesh_routing = false;
+    // Split payloads larger than one frame, every node of the mesh has to enable it
+    bool mesh_fragmentation = false;
+    // Nodes in radio range rfnet keeps track of
+    size_t mesh_peers = 128;
+    // Threads serving gRPC calls, however many clients are connected
+    size_t grpc_threads = 2;
+    // CSMA-CA of the RF215 radios: CCA threshold, attempts and TX deadline
+    comm::channel_access_config channel_access;
+    // Period of the radio counters in the log (0 - never)
+    std::chrono::seconds stats_interval { 0 };
+};
+
+static auto parse_options(int argc, char** argv) noexcept -> commd_options {
+    commd_options options;
+
+    constexpr std::string_view sim_loss_arg = "--sim-loss=";
+    constexpr std::string_view grpc_threads_arg = "--grpc-threads=";
+    constexpr std::string_view mesh_peers_arg = "--mesh-peers=";
+    constexpr std::string_view cca_threshold_arg = "--cca-threshold=";
+    constexpr std::string_view cca_attempts_arg = "--cca-attempts=";
+    constexpr std::string_view tx_deadline_arg = "--tx-deadline=";
+    constexpr std::string_view stats_interval_arg = "--stats-interval=";
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg { argv[i] };
+
+        if (arg == "--sim") {
+            options.simulate = true;
+        } else if (arg == "--dual-band") {
+            options.dual_band = true;
+        } else if (arg == "--mesh-routing") {
+            options.mesh_routing = true;
+        } else if (arg == "--mesh-fragmentation") {
+            options.mesh_fragmentation = true;
+        } else if (arg.substr(0, sim_loss_arg.size()) == sim_loss_arg) {
+            options.sim_loss_rate =
+                std::clamp(std::atof(argv[i] + sim_loss_arg.size()), 0.0, 1.0);
+        } else if (arg.substr(0, grpc_threads_arg.size()) == grpc_threads_arg) {
+            options.grpc_threads = std::clamp<size_t>(
+                std::strtoul(argv[i] + grpc_threads_arg.size(), nullptr, 10), 1, 16);
+        } else if (arg.substr(0, mesh_peers_arg.size()) == mesh_peers_arg) {
+            options.mesh_peers = std::clamp<size_t>(
+                std::strtoul(argv[i] + mesh_peers_arg.size(), nullptr, 10), 1, 4096);
+        } else if (arg.substr(0, cca_threshold_arg.size()) == cca_threshold_arg) {
+            options.channel_access.cca_threshold = static_cast<int8_t>(std::clamp<long>(
+                std::strtol(argv[i] + cca_threshold_arg.size(), nullptr, 10), -127, 0));
+        } else if (arg.substr(0, cca_attempts_arg.size()) == cca_attempts_arg) {
+            options.channel_access.max_attempts = std::clamp<size_t>(
+                std::strtoul(argv[i] + cca_attempts_arg.size(), nullptr, 10), 1, 64);
+        } else if (arg.substr(0, tx_deadline_arg.size()) == tx_deadline_arg) {
+            options.channel_access.deadline = std::chrono::milliseconds { std::clamp<size_t>(
+                std::strtoul(argv[i] + tx_deadline_arg.size(), nullptr, 10), 0, 10000) };
+        } else if (arg.substr(0, stats_interval_arg.size()) == stats_interval_arg) {
+            options.stats_interval = std::chrono::seconds { std::clamp<size_t>(
+                std::strtoul(argv[i] + stats_interval_arg.size(), nullptr, 10), 0, 3600) };
+        } else {
+            log::warn("commd: unknown argument '{}'", arg);
+        }
+    }
+
+    return options;
+}
+
+static auto default_radio_config(uint8_t channel) noexcept -> comm::radio_config {
+    return comm::radio_config {
+        .freq = 869535,
+        .channel = channel,
+        .channel_spacing = 200,
+        .tx_power = 10,
+        .phy_config =
+            comm::radio_phy_config_ofdm {
+                .mcs = 6,
+                .opt = 0,
+            },
+    };
+}
+
+static auto default_radio_config_24(uint8_t channel) noexcept -> comm::radio_config {
+    return comm::radio_config {
+        .freq = 2450000,
+        .channel = channel,
+        .channel_spacing = 1200,
+        .tx_power = 10,
+        .phy_config =
+            comm::radio_phy_config_ofdm {
+                .mcs = 6,
+                .opt = 0,
+            },
+    };
+}
+
 static auto create_radio(const kaonic::comm::rf215_radio_config& config, uint8_t channel)
     -> std::shared_ptr<comm::rf215_radio> {
     auto radio = std::make_shared<comm::rf215_radio>(config);
@@ -127,18 +227,7 @@ static auto create_radio(const kaonic::comm::rf215_radio_config& config, uint8_t
         return nullptr;
     }
 
-    if (auto err = radio->configure({
-            .freq = 869535,
-            .channel = channel,
-            .channel_spacing = 200,
-            .tx_power = 10,
-            .phy_config =
-                comm::radio_phy_config_ofdm {
-                    .mcs = 6,
-                    .opt = 0,
-                },
-        });
-        !err.is_ok()) {
+    if (auto err = radio->configure(default_radio_config(channel)); !err.is_ok()) {
         log::error("commd: configuration err");
         return nullptr;
     }
@@ -146,29 +235,97 @@ static auto create_radio(const kaonic::comm::rf215_radio_config& config, uint8_t
     return radio;
 }
 
+static auto create_dual_band_radios(const kaonic::comm::rf215_radio_config& config,
+                                    std::vector<std::shared_ptr<comm::radio>>& radios) -> void {
+    auto chip = std::make_shared<comm::rf215_radio>(config);
+
+    if (auto err = chip->init(); !err.is_ok()) {
+        log::error("radio init failed");
+        return;
+    }
+
+    const auto rf09 = std::make_shared<comm::rf215_trx_radio>(chip, RF215_TRX_TYPE_RF09);
+    if (auto err = rf09->configure(default_radio_config(11)); !err.is_ok()) {
+        log::error("commd: rf09 configuration err");
+    } else {
+        radios.push_back(rf09);
+    }
+
+    const auto rf24 = std::make_shared<comm::rf215_trx_radio>(chip, RF215_TRX_TYPE_RF24);
+    if (auto err = rf24->configure(default_radio_config_24(0)); !err.is_ok()) {
+        log::error("commd: rf24 configuration err");
+    } else {
+        radios.push_back(rf24);
+    }
+}
+
+static auto create_sim_radio(const comm::sim_radio_config& config,
+                             const std::shared_ptr<comm::sim_medium>& medium,
+                             uint8_t channel) -> std::shared_ptr<comm::sim_radio> {
+    auto radio = std::make_shared<comm::sim_radio>(config, medium);
+
+    if (auto err = radio->configure(default_radio_config(channel)); !err.is_ok()) {
+        log::error("commd: sim configuration err");
+        return nullptr;
+    }
+
+    return radio;
+}
+
 auto main(int argc, char** argv) noexcept -> int {
 
     log::set_level(log::level::trace);
 
     log::info("commd: start service - {}", kaonic::info::version);
 
-    const auto& machine_config = select_machine_config();
+    const auto options = parse_options(argc, argv);
 
     std::vector<std::shared_ptr<comm::radio>> radios;
 
-    // Initialize Radio Frontend A
-    {
-        const auto radio = create_radio(machine_config.rfa_config, 11);
-        if (radio) {
-            radios.push_back(radio);
+    if (options.simulate) {
+        log::info("commd: use simulated radios (loss {:.2f})", options.sim_loss_rate);
+
+        // Both modules share one medium and channel, so frames sent on one are heard by the other
+        const auto medium = std::make_shared<comm::sim_medium>();
+
+        for (const auto name : { "sim-rfa", "sim-rfb" }) {
+            const auto radio = create_sim_radio(
+                comm::sim_radio_config {
+                    .name = name,
+                    .loss_rate = options.sim_loss_rate,
+                },
+                medium,
+                11);
+            if (radio) {
+                radios.push_back(radio);
+            }
+        }
+    } else {
+        const auto& machine_config = select_machine_config();
+
+        auto rfa_config = machine_config.rfa_config;
+        rfa_config.channel_access = options.channel_access;
+
+        auto rfb_config = machine_config.rfb_config;
+        rfb_config.channel_access = options.channel_access;
+
+        // Initialize Radio Frontend A
+        if (options.dual_band) {
+            log::info("commd: use RF09 and RF24 of frontend A concurrently");
+            create_dual_band_radios(rfa_config, radios);
+        } else {
+            const auto radio = create_radio(rfa_config, 11);
+            if (radio) {
+                radios.push_back(radio);
+            }
         }
-    }
 
-    // Initialize Radio Frontend B
-    if (false) {
-        const auto radio = create_radio(machine_config.rfb_config, 1);
-        if (radio) {
-            radios.push_back(radio);
+        // Initialize Radio Frontend B
+        if (false) {
+            const auto radio = create_radio(rfb_config, 1);
+            if (radio) {
+                radios.push_back(radio);
+            }
         }
     }
 
@@ -177,26 +334,34 @@ auto main(int argc, char** argv) noexcept -> int {
         .slot_duration = 15ms,
         .gap_duration = 2ms,
         .beacon_interval = 500ms,
+        .peer_capacity = options.mesh_peers,
+        .routing = { .enabled = options.mesh_routing },
+        .fragmentation = { .enabled = options.mesh_fragmentation },
     };
 
-    const auto radio_service = std::make_shared<comm::radio_service>(mesh_config, radios);
+    const auto radio_service = std::make_shared<comm::radio_service>(
+        mesh_config, radios, 256, options.stats_interval);
 
-    const auto grpc_service =
-        std::make_shared<comm::grpc_service>(radio_service, kaonic::info::version);
+    // Received frames are serialized once for gRPC and serial clients alike
+    const auto publisher = std::make_shared<comm::response_publisher>(
+        radio_service->module_count());
 
-    const auto grpc_listener = std::make_shared<comm::grpc_radio_listener>(grpc_service);
+    radio_service->attach_listener(publisher);
 
-    radio_service->attach_listener(grpc_listener);
+    const auto grpc_service = std::make_shared<comm::grpc_service>(
+        radio_service,
+        publisher,
+        kaonic::info::version,
+        comm::grpc_config { .address = "0.0.0.0:8080", .threads = options.grpc_threads });
 
     log::info("commd: start grpc service");
 
-    ::grpc::ServerBuilder builder;
-    builder.AddListeningPort(std::string("0.0.0.0:8080"), ::grpc::InsecureServerCredentials());
-    builder.RegisterService(grpc_service.get());
-
-    std::unique_ptr<::grpc::Server> server(builder.BuildAndStart());
+    if (auto err = grpc_service->start(); !err.is_ok()) {
+        log::error("commd: unable to start grpc service");
+        return -1;
+    }
 
-    server->Wait();
+    grpc_service->wait();
 
     log::info("commd: exit");
 
@@ -0,0 +1,74 @@
+#include "kaonic/comm/radio/channel_access.hpp"
+#include "kaonic/common/logging.hpp"
+
+using namespace kaonic;
+using namespace std::chrono_literals;
+
+static auto make_config() -> comm::channel_access_config {
+    return comm::channel_access_config {
+        .max_attempts = 5,
+        .min_be = 2,
+        .max_be = 4,
+        .backoff_period = 100us,
+        .seed = 1,
+    };
+}
+
+static auto test_backoff_window() -> int {
+    log::info("[Channel Access Test] Backoff window test");
+
+    const auto config = make_config();
+    comm::csma_backoff_policy policy { config };
+
+    // Window doubles with every busy CCA until max_be
+    for (size_t attempt = 1; attempt < config.max_attempts; ++attempt) {
+        const auto exponent = std::min<size_t>(config.min_be + attempt - 1, config.max_be);
+        const auto window = config.backoff_period * ((1u << exponent) - 1u);
+
+        std::chrono::microseconds longest { 0 };
+        for (size_t i = 0; i < 1000; ++i) {
+            const auto backoff = policy.backoff(attempt);
+            if (!backoff || *backoff > window || backoff->count() % config.backoff_period.count()) {
+                log::error("FAIL: backoff is out of the window");
+                return -1;
+            }
+            longest = std::max(longest, *backoff);
+        }
+
+        log::info("[Channel Access Test] attempt {}: window={}us longest={}us",
+                  attempt,
+                  window.count(),
+                  longest.count());
+
+        if (longest != window) {
+            log::error("FAIL: backoff doesn't cover the window");
+            return -1;
+        }
+    }
+
+    log::info("[Channel Access Test] [window] PASSED");
+    return 0;
+}
+
+static auto test_max_attempts() -> int {
+    log::info("[Channel Access Test] Max attempts test");
+
+    comm::csma_backoff_policy policy { make_config() };
+
+    if (!policy.backoff(4) || policy.backoff(5) || policy.backoff(6)) {
+        log::error("FAIL: frame isn't dropped after max attempts");
+        return -1;
+    }
+
+    log::info("[Channel Access Test] [max attempts] PASSED");
+    return 0;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+    int rc = 0;
+
+    rc += test_backoff_window();
+    rc += test_max_attempts();
+
+    return rc;
+}
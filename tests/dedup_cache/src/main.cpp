@@ -0,0 +1,138 @@
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "kaonic/comm/mesh/dedup_cache.hpp"
+#include "kaonic/common/logging.hpp"
+
+using namespace kaonic;
+using namespace std::chrono_literals;
+
+using comm::mesh::dedup_cache;
+using comm::mesh::frame_info;
+using comm::mesh::frame_view;
+
+static auto routed(uint64_t source, uint32_t seq, uint8_t module = 0) -> frame_info {
+    return frame_info { .module = module, .source = source, .seq = seq };
+}
+
+static auto test_routed() -> int {
+    log::info("[Dedup Cache Test] Routed frames test");
+
+    dedup_cache cache { comm::mesh::dedup_config { .window = 100ms } };
+
+    const std::vector<uint8_t> payload { 1, 2, 3 };
+    const auto start = dedup_cache::clock::now();
+
+    if (cache.check(frame_view { payload, routed(7, 1) }, start)
+        || !cache.check(frame_view { payload, routed(7, 1, 1) }, start + 10ms)
+        || cache.check(frame_view { payload, routed(7, 2) }, start + 10ms)
+        || cache.check(frame_view { payload, routed(8, 1) }, start + 10ms)) {
+        log::error("FAIL: routed frames aren't told apart by source and sequence");
+        return -1;
+    }
+
+    if (cache.check(frame_view { payload, routed(7, 1) }, start + 150ms)) {
+        log::error("FAIL: frame is still remembered after the window");
+        return -1;
+    }
+
+    // Same source and sequence with another payload, e.g. after the source restarted
+    const std::vector<uint8_t> other { 4, 5, 6 };
+    if (cache.check(frame_view { other, routed(7, 2) }, start + 20ms)
+        || cache.get_stats().false_positives != 1) {
+        log::error("FAIL: key collision was taken for a duplicate");
+        return -1;
+    }
+
+    log::info("[Dedup Cache Test] [routed] PASSED");
+    return 0;
+}
+
+static auto test_modules() -> int {
+    log::info("[Dedup Cache Test] Modules test");
+
+    dedup_cache cache { comm::mesh::dedup_config {} };
+
+    const std::vector<uint8_t> payload { 9, 8, 7, 6 };
+    const auto now = dedup_cache::clock::now();
+
+    if (cache.check(frame_view { payload, frame_info { .module = 0 } }, now)
+        || cache.check(frame_view { payload, frame_info { .module = 0 } }, now)
+        || !cache.check(frame_view { payload, frame_info { .module = 1 } }, now)) {
+        log::error("FAIL: only copies from another module are duplicates");
+        return -1;
+    }
+
+    log::info("[Dedup Cache Test] [modules] PASSED");
+    return 0;
+}
+
+// Every frame is heard over one or two paths, reported hits are checked against the truth
+static auto bench_hit_rate(size_t capacity, double duplicate_rate) -> int {
+    constexpr size_t frames = 200000;
+    constexpr size_t in_flight = 64;
+
+    dedup_cache cache { comm::mesh::dedup_config { .capacity = capacity, .window = 1000ms } };
+
+    std::mt19937_64 generator { 3 };
+    std::bernoulli_distribution is_duplicate { duplicate_rate };
+
+    std::vector<uint8_t> payload(128);
+    size_t expected = 0;
+    size_t reported = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    auto now = dedup_cache::clock::now();
+
+    for (size_t i = 0; i < frames; ++i) {
+        const auto source = 1 + (i % in_flight);
+        const auto seq = static_cast<uint32_t>(i / in_flight);
+
+        payload[0] = static_cast<uint8_t>(i);
+        now += 100us;
+
+        reported += cache.check(frame_view { payload, routed(source, seq) }, now);
+
+        if (is_duplicate(generator)) {
+            ++expected;
+            reported += cache.check(frame_view { payload, routed(source, seq, 1) }, now + 5ms);
+        }
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const auto stats = cache.get_stats();
+
+    log::info("[Dedup Cache Bench] capacity={:>5} dup={:.2f}: hit rate={:.4f} found {}/{} "
+              "false positives={} evictions={} {:.1f}ns/frame",
+              capacity,
+              duplicate_rate,
+              stats.hit_rate(),
+              reported,
+              expected,
+              stats.false_positives,
+              stats.evictions,
+              static_cast<double>(std::chrono::nanoseconds { elapsed }.count())
+                  / static_cast<double>(stats.lookups));
+
+    // Unique frames must never be dropped
+    if (reported > expected) {
+        log::error("FAIL: unique frames were taken for duplicates");
+        return -1;
+    }
+
+    return 0;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+    int rc = 0;
+
+    rc += test_routed();
+    rc += test_modules();
+
+    for (const auto capacity : { 64u, 1024u, 16384u }) {
+        rc += bench_hit_rate(capacity, 0.3);
+    }
+
+    return rc;
+}
@@ -0,0 +1,364 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "kaonic/comm/mesh/fragmentation.hpp"
+#include "kaonic/comm/mesh/radio_network.hpp"
+#include "kaonic/comm/radio/sim_radio.hpp"
+#include "kaonic/common/logging.hpp"
+
+using namespace kaonic;
+using namespace std::chrono_literals;
+
+using comm::mesh::fragment_header;
+using comm::mesh::fragmenter;
+using comm::mesh::frame_view;
+using comm::mesh::reassembler;
+
+class message_receiver final : public comm::mesh::network_receiver {
+
+public:
+    explicit message_receiver() noexcept = default;
+    ~message_receiver() final = default;
+
+    auto on_receive(const comm::mesh::frame_view& frame) -> void final {
+        std::lock_guard lock { _mut };
+        _messages.emplace_back(frame.buffer.begin(), frame.buffer.end());
+    }
+
+    [[nodiscard]] auto messages() -> std::vector<std::vector<uint8_t>> {
+        std::lock_guard lock { _mut };
+        return _messages;
+    }
+
+private:
+    std::vector<std::vector<uint8_t>> _messages;
+    std::mutex _mut;
+};
+
+// Fragments of 'payload' as they go on air
+static auto make_fragments(fragmenter& fragmenter, const std::vector<uint8_t>& payload)
+    -> std::vector<std::vector<uint8_t>> {
+    std::vector<std::vector<uint8_t>> frames;
+
+    fragment_header first;
+    if (!fragmenter.start(payload.size(), first).is_ok()) {
+        return frames;
+    }
+
+    for (size_t i = 0; i < first.count; ++i) {
+        const auto header = fragmenter.fragment(first, i);
+        const auto length = fragmenter.length(header);
+
+        auto& frame = frames.emplace_back(fragmenter::header_size + length);
+        fragmenter::encode(header, frame);
+        std::copy_n(payload.begin() + header.offset, length, frame.begin() + fragmenter::header_size);
+    }
+
+    return frames;
+}
+
+static auto test_reassembly() -> int {
+    log::info("[Fragmentation Test] Reassembly test");
+
+    const comm::mesh::fragmentation_config config { .enabled = true, .mtu = 256 };
+
+    fragmenter fragmenter { config, 0 };
+    reassembler reassembler { config };
+
+    std::vector<uint8_t> payload(5000);
+    std::iota(payload.begin(), payload.end(), 0);
+
+    auto frames = make_fragments(fragmenter, payload);
+    if (frames.size() != (payload.size() + 239) / 240) {
+        log::error("FAIL: payload split into {} fragments", frames.size());
+        return -1;
+    }
+
+    // Out of order, with a fragment heard twice
+    std::reverse(frames.begin(), frames.end());
+    frames.insert(frames.begin() + 3, frames[1]);
+
+    const auto now = reassembler::clock::now();
+
+    size_t completed = 0;
+    for (const auto& frame : frames) {
+        frame_view message;
+        if (!reassembler.receive(frame_view { frame }, now, message)) {
+            continue;
+        }
+
+        ++completed;
+        if (std::vector<uint8_t>(message.buffer.begin(), message.buffer.end()) != payload) {
+            log::error("FAIL: reassembled payload differs");
+            return -1;
+        }
+    }
+
+    const auto stats = reassembler.get_stats();
+    if (completed != 1 || stats.duplicates != 1 || reassembler.memory() != 0) {
+        log::error("FAIL: message wasn't completed exactly once");
+        return -1;
+    }
+
+    // Frames without a fragment header pass through
+    const std::vector<uint8_t> plain { 1, 2, 3 };
+    frame_view message;
+    if (!reassembler.receive(frame_view { plain }, now, message) || message.buffer.size() != 3) {
+        log::error("FAIL: plain frame wasn't delivered");
+        return -1;
+    }
+
+    log::info("[Fragmentation Test] [reassembly] PASSED");
+    return 0;
+}
+
+static auto test_limits() -> int {
+    log::info("[Fragmentation Test] Limits test");
+
+    const comm::mesh::fragmentation_config config {
+        .enabled = true,
+        .mtu = 256,
+        .max_payload = 8 * 1024,
+        .max_messages = 4,
+        .max_memory = 16 * 1024,
+        .timeout = 100ms,
+    };
+
+    fragmenter fragmenter { config, 0 };
+    reassembler reassembler { config };
+
+    fragment_header header;
+    if (fragmenter.start(config.max_payload + 1, header).is_ok()) {
+        log::error("FAIL: payload over the limit was accepted");
+        return -1;
+    }
+
+    const std::vector<uint8_t> payload(6000);
+    auto now = reassembler::clock::now();
+
+    // First fragments only, none of the messages completes
+    for (size_t i = 0; i < 10; ++i) {
+        const auto frames = make_fragments(fragmenter, payload);
+
+        frame_view message;
+        if (reassembler.receive(frame_view { frames.front() }, now, message)) {
+            log::error("FAIL: incomplete message was delivered");
+            return -1;
+        }
+
+        if (reassembler.memory() > config.max_memory) {
+            log::error("FAIL: reassembly took {}B", reassembler.memory());
+            return -1;
+        }
+
+        now += 1ms;
+    }
+
+    auto stats = reassembler.get_stats();
+    if (stats.evicted != 8) {
+        log::error("FAIL: {} messages evicted", stats.evicted);
+        return -1;
+    }
+
+    if (reassembler.expire(now + config.timeout) != 2 || reassembler.memory() != 0) {
+        log::error("FAIL: stalled messages weren't dropped");
+        return -1;
+    }
+
+    log::info("[Fragmentation Test] [limits] PASSED");
+    return 0;
+}
+
+// Fragment with its header rewritten, the payload stays as it was
+static auto rewrite(const std::vector<uint8_t>& frame, uint32_t offset, size_t length)
+    -> std::vector<uint8_t> {
+    fragment_header header;
+    span<const uint8_t> payload;
+    if (!fragmenter::decode(frame, header, payload)) {
+        return {};
+    }
+
+    header.offset = offset;
+
+    std::vector<uint8_t> result(fragmenter::header_size + std::min(length, payload.size()));
+    fragmenter::encode(header, result);
+    std::copy_n(payload.begin(),
+                result.size() - fragmenter::header_size,
+                result.begin() + fragmenter::header_size);
+
+    return result;
+}
+
+static auto test_overlaps() -> int {
+    log::info("[Fragmentation Test] Overlaps test");
+
+    const comm::mesh::fragmentation_config config {
+        .enabled = true,
+        .mtu = 256,
+        .max_messages = 1,
+    };
+
+    fragmenter fragmenter { config, 0 };
+    reassembler reassembler { config };
+
+    const auto now = reassembler::clock::now();
+
+    // Leaves its bytes in the only slot buffer
+    const std::vector<uint8_t> stale(600, 0xAA);
+    for (const auto& frame : make_fragments(fragmenter, stale)) {
+        frame_view message;
+        (void)reassembler.receive(frame_view { frame }, now, message);
+    }
+
+    std::vector<uint8_t> payload(600);
+    std::iota(payload.begin(), payload.end(), 0);
+
+    // 240, 240 and 120 bytes, the middle one is sent at an offset that overlaps the others
+    const auto frames = make_fragments(fragmenter, payload);
+    const std::vector<std::vector<uint8_t>> overlapping {
+        frames[0],
+        rewrite(frames[1], 0, 240),
+        rewrite(frames[1], 120, 240),
+        rewrite(frames[1], 240, 120),
+        frames[2],
+    };
+
+    for (const auto& frame : overlapping) {
+        frame_view message;
+        if (reassembler.receive(frame_view { frame }, now, message)) {
+            log::error("FAIL: message without all of its bytes was delivered");
+            return -1;
+        }
+    }
+
+    if (reassembler.get_stats().rejected != 3) {
+        log::error("FAIL: {} fragments rejected", reassembler.get_stats().rejected);
+        return -1;
+    }
+
+    frame_view message;
+    if (!reassembler.receive(frame_view { frames[1] }, now, message)
+        || std::vector<uint8_t>(message.buffer.begin(), message.buffer.end()) != payload) {
+        log::error("FAIL: message wasn't completed by its own fragment");
+        return -1;
+    }
+
+    // Stride is taken from the last fragment when it comes first
+    const auto reversed = make_fragments(fragmenter, payload);
+    for (size_t i = reversed.size(); i > 0; --i) {
+        const auto completed = reassembler.receive(frame_view { reversed[i - 1] }, now, message);
+        if (completed != (i == 1)) {
+            log::error("FAIL: fragment {} out of order wasn't taken", i - 1);
+            return -1;
+        }
+    }
+
+    log::info("[Fragmentation Test] [overlaps] PASSED");
+    return 0;
+}
+
+static auto test_network() -> int {
+    log::info("[Fragmentation Test] Network test");
+
+    // Fragmentation is under test, not channel access
+    const auto medium =
+        std::make_shared<comm::sim_medium>(comm::sim_medium_config { .collisions = false });
+
+    const comm::mesh::config mesh_config {
+        .packet_pattern = 0xB1EE,
+        .slot_duration = 15ms,
+        .gap_duration = 2ms,
+        .beacon_interval = 500ms,
+        .fragmentation = { .enabled = true },
+    };
+
+    const auto radio_a =
+        std::make_shared<comm::sim_radio>(comm::sim_radio_config { .name = "a" }, medium);
+    const auto radio_b =
+        std::make_shared<comm::sim_radio>(comm::sim_radio_config { .name = "b" }, medium);
+
+    auto err = radio_a->configure(comm::radio_config {});
+    err += radio_b->configure(comm::radio_config {});
+
+    const auto receiver_a = std::make_shared<message_receiver>();
+    const auto receiver_b = std::make_shared<message_receiver>();
+
+    comm::mesh::radio_network network_a { mesh_config, radio_a, receiver_a };
+    comm::mesh::radio_network network_b { mesh_config, radio_b, receiver_b };
+
+    err += network_a.start();
+    err += network_b.start();
+
+    if (!err.is_ok()) {
+        log::error("FAIL: unable to start networks");
+        return -1;
+    }
+
+    constexpr size_t messages = 4;
+
+    std::vector<uint8_t> payload(20000);
+    std::iota(payload.begin(), payload.end(), 7);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < messages; ++i) {
+        payload[0] = static_cast<uint8_t>(i);
+
+        comm::mesh::tx_result result;
+        if (!network_a.transmit(frame_view { payload }, result).is_ok()) {
+            log::error("FAIL: message {} wasn't sent", i);
+            return -1;
+        }
+    }
+
+    const auto deadline = start + 5s;
+    while (receiver_b->messages().size() < messages && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    err += network_a.stop();
+    err += network_b.stop();
+
+    const auto received = receiver_b->messages();
+    const auto stats = network_b.get_fragmentation_stats();
+
+    log::info("[Fragmentation Test] {}x{}B in {}ms: {} fragments sent, {} received",
+              received.size(),
+              payload.size(),
+              std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(),
+              network_a.get_fragmentation_stats().fragments_sent,
+              stats.fragments_received);
+
+    if (received.size() != messages) {
+        log::error("FAIL: {}/{} messages delivered", received.size(), messages);
+        return -1;
+    }
+
+    for (size_t i = 0; i < messages; ++i) {
+        payload[0] = static_cast<uint8_t>(i);
+        if (received[i] != payload) {
+            log::error("FAIL: message {} differs", i);
+            return -1;
+        }
+    }
+
+    log::info("[Fragmentation Test] [network] PASSED");
+    return 0;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+    int rc = 0;
+
+    rc += test_reassembly();
+    rc += test_limits();
+    rc += test_overlaps();
+    rc += test_network();
+
+    return rc;
+}
@@ -0,0 +1,145 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <numeric>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "kaonic/comm/mesh/radio_network.hpp"
+#include "kaonic/comm/radio/sim_radio.hpp"
+#include "kaonic/common/copy_stats.hpp"
+#include "kaonic/common/logging.hpp"
+
+using namespace kaonic;
+using namespace std::chrono_literals;
+
+struct copy_bench_config final {
+    size_t frames = 200;
+    size_t frame_size = 512;
+};
+
+class counting_receiver final : public comm::mesh::network_receiver {
+
+public:
+    explicit counting_receiver() noexcept = default;
+    ~counting_receiver() final = default;
+
+    // Payload is only inspected, nothing is kept past the call
+    auto on_receive(const comm::mesh::frame_view& frame) -> void final {
+        ++_frames;
+        _bytes += frame.buffer.size();
+    }
+
+    [[nodiscard]] auto frames() const noexcept -> size_t { return _frames; }
+
+    [[nodiscard]] auto bytes() const noexcept -> size_t { return _bytes; }
+
+private:
+    std::atomic<size_t> _frames { 0 };
+    std::atomic<size_t> _bytes { 0 };
+};
+
+static auto run_bench(const copy_bench_config& config) -> int {
+
+    log::info("[Frame Copy] frames={} size={}B", config.frames, config.frame_size);
+
+    const auto medium = std::make_shared<comm::sim_medium>();
+
+    // Long beacon interval keeps mesh control frames out of the counters
+    const comm::mesh::config mesh_config {
+        .packet_pattern = 0xB1EE,
+        .slot_duration = 15ms,
+        .gap_duration = 2ms,
+        .beacon_interval = 5000ms,
+    };
+
+    const auto radio_a = std::make_shared<comm::sim_radio>(comm::sim_radio_config { .name = "a" },
+                                                           medium);
+    const auto radio_b = std::make_shared<comm::sim_radio>(comm::sim_radio_config { .name = "b" },
+                                                           medium);
+
+    auto err = radio_a->configure(comm::radio_config {});
+    err += radio_b->configure(comm::radio_config {});
+
+    const auto receiver_a = std::make_shared<counting_receiver>();
+    const auto receiver_b = std::make_shared<counting_receiver>();
+
+    comm::mesh::radio_network network_a { mesh_config, radio_a, receiver_a };
+    comm::mesh::radio_network network_b { mesh_config, radio_b, receiver_b };
+
+    err += network_a.start();
+    err += network_b.start();
+
+    if (!err.is_ok()) {
+        log::error("[Frame Copy] unable to start networks");
+        return -1;
+    }
+
+    std::vector<uint8_t> payload(config.frame_size);
+    std::iota(payload.begin(), payload.end(), 0);
+
+    // Let the nodes discover each other before counting
+    std::this_thread::sleep_for(100ms);
+    copy_counter::reset();
+
+    size_t sent = 0;
+    for (size_t i = 0; i < config.frames; ++i) {
+        if (network_a.transmit(comm::mesh::frame_view { payload }).is_ok()) {
+            ++sent;
+        }
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (receiver_b->frames() < sent && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+
+    err += network_a.stop();
+    err += network_b.stop();
+
+    const auto stats = copy_counter::get_stats();
+    const auto received = receiver_b->frames();
+
+    if (sent == 0 || received == 0) {
+        log::error("[Frame Copy] no frames were delivered ({}/{})", received, sent);
+        return -1;
+    }
+
+    log::info("[Frame Copy] delivered {}/{} frames", received, sent);
+    log::info("[Frame Copy] tx: {:.2f} copies/frame {:.1f} B/frame",
+              static_cast<double>(stats.tx_copies) / sent,
+              static_cast<double>(stats.tx_bytes) / sent);
+    log::info("[Frame Copy] rx: {:.2f} copies/frame {:.1f} B/frame",
+              static_cast<double>(stats.rx_copies) / received,
+              static_cast<double>(stats.rx_bytes) / received);
+
+    return 0;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+
+    log::set_level(log::level::info);
+
+    copy_bench_config config;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg { argv[i] };
+
+        const auto pos = arg.find('=');
+        const auto key = arg.substr(0, pos);
+        const auto value = pos == std::string_view::npos ? std::string_view {} : arg.substr(pos + 1);
+
+        if (key == "--frames") {
+            config.frames = std::strtoul(value.data(), nullptr, 10);
+        } else if (key == "--size") {
+            config.frame_size = std::strtoul(value.data(), nullptr, 10);
+        } else {
+            log::error("[Frame Copy] unknown argument '{}'", arg);
+            log::info("usage: frame_copy [--frames=200] [--size=512]");
+            return -1;
+        }
+    }
+
+    return run_bench(config);
+}
@@ -0,0 +1,280 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "kaonic/comm/mesh/frame_pool.hpp"
+#include "kaonic/comm/mesh/frame_ring.hpp"
+#include "kaonic/comm/mesh/radio_network.hpp"
+#include "kaonic/comm/radio/sim_radio.hpp"
+#include "kaonic/common/logging.hpp"
+
+using namespace kaonic;
+using namespace std::chrono_literals;
+
+using comm::mesh::frame_pool;
+using comm::mesh::frame_view;
+
+static std::atomic<size_t> heap_allocations { 0 };
+
+auto operator new(size_t size) -> void* {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (auto ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc {};
+}
+
+auto operator new[](size_t size) -> void* {
+    return operator new(size);
+}
+
+auto operator new(size_t size, const std::nothrow_t&) noexcept -> void* {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+auto operator new[](size_t size, const std::nothrow_t& tag) noexcept -> void* {
+    return operator new(size, tag);
+}
+
+auto operator delete(void* ptr) noexcept -> void {
+    std::free(ptr);
+}
+
+auto operator delete[](void* ptr) noexcept -> void {
+    std::free(ptr);
+}
+
+auto operator delete(void* ptr, size_t) noexcept -> void {
+    std::free(ptr);
+}
+
+auto operator delete[](void* ptr, size_t) noexcept -> void {
+    std::free(ptr);
+}
+
+// Does what the gRPC and serial services do with a frame: keeps it in a pooled buffer
+// and hands it to a thread of its own
+class queueing_receiver final : public comm::mesh::network_receiver {
+
+public:
+    explicit queueing_receiver(const std::shared_ptr<frame_pool>& pool) noexcept
+        : _pool { pool }
+        , _ring { 64 }
+        , _subscriber { _ring } {
+        _consumer = std::thread([this] {
+            comm::mesh::frame frame;
+            while (_running) {
+                if (_subscriber.pop(frame, 10ms)) {
+                    frame.buffer.reset();
+                    ++_frames;
+                }
+            }
+        });
+    }
+
+    ~queueing_receiver() final { stop(); }
+
+    auto on_receive(const frame_view& frame) -> void final {
+        _ring.publish(comm::mesh::frame { _pool->copy(frame.buffer), frame.info });
+    }
+
+    auto stop() -> void {
+        _running = false;
+        if (_consumer.joinable()) {
+            _consumer.join();
+        }
+    }
+
+    [[nodiscard]] auto frames() const noexcept -> size_t { return _frames; }
+
+private:
+    std::shared_ptr<frame_pool> _pool;
+    comm::mesh::frame_ring _ring;
+    comm::mesh::frame_subscriber _subscriber;
+
+    std::atomic_bool _running { true };
+    std::atomic<size_t> _frames { 0 };
+
+    std::thread _consumer;
+};
+
+static auto test_pool() -> int {
+    log::info("[Frame Pool Test] Pool test");
+
+    frame_pool pool { 2 };
+
+    const std::vector<uint8_t> data { 1, 2, 3 };
+
+    auto first = pool.copy(data);
+    auto shared = first;
+
+    if (!first || first.size() != 3 || first.data()[2] != 3 || shared.data() != first.data()) {
+        log::error("FAIL: copy isn't in a shared buffer");
+        return -1;
+    }
+
+    auto second = pool.allocate(frame_pool::slot_size);
+    auto heap = pool.allocate(16);
+    auto oversized = pool.allocate(frame_pool::slot_size + 1);
+
+    auto stats = pool.get_stats();
+    if (!heap || !oversized || stats.available != 0 || stats.exhausted != 1
+        || stats.oversized != 1) {
+        log::error("FAIL: exhausted pool didn't fall back to the heap");
+        return -1;
+    }
+
+    // Slot is back only once the last handle is gone
+    first.reset();
+    if (pool.get_stats().available != 0) {
+        log::error("FAIL: shared buffer was released early");
+        return -1;
+    }
+
+    shared.reset();
+    second = {};
+    heap.reset();
+    oversized.reset();
+
+    if (pool.get_stats().available != 2) {
+        log::error("FAIL: buffers weren't returned to the pool");
+        return -1;
+    }
+
+    // Serialized responses are a bit larger than the frame they carry
+    frame_pool responses { 1, frame_pool::slot_size + 512 };
+    const auto response = responses.allocate(frame_pool::slot_size + 1);
+
+    stats = responses.get_stats();
+    if (!response || response.capacity() != responses.slot_capacity() || stats.oversized != 0
+        || stats.available != 0) {
+        log::error("FAIL: buffer wasn't taken from the larger slots");
+        return -1;
+    }
+
+    log::info("[Frame Pool Test] [pool] PASSED");
+    return 0;
+}
+
+// Two nodes over sim radios, frames are counted from the sender's transmit call until the
+// receiving client thread is done with them
+static auto test_steady_state() -> int {
+    log::info("[Frame Pool Test] Steady state test");
+
+    constexpr size_t warmup_frames = 50;
+    constexpr size_t frames = 500;
+
+    const auto medium =
+        std::make_shared<comm::sim_medium>(comm::sim_medium_config { .collisions = false });
+
+    const comm::mesh::config mesh_config {
+        .packet_pattern = 0xB1EE,
+        .slot_duration = 15ms,
+        .gap_duration = 2ms,
+        .beacon_interval = 5000ms,
+    };
+
+    const auto radio_a =
+        std::make_shared<comm::sim_radio>(comm::sim_radio_config { .name = "a" }, medium);
+    const auto radio_b =
+        std::make_shared<comm::sim_radio>(comm::sim_radio_config { .name = "b" }, medium);
+
+    auto err = radio_a->configure(comm::radio_config {});
+    err += radio_b->configure(comm::radio_config {});
+
+    const auto pool = std::make_shared<frame_pool>(128);
+
+    const auto broadcaster = std::make_shared<comm::mesh::network_broadcast_receiver>();
+    const auto receiver = std::make_shared<queueing_receiver>(pool);
+    broadcaster->attach_listener(receiver);
+
+    const auto sink = std::make_shared<queueing_receiver>(pool);
+
+    comm::mesh::radio_network network_a { mesh_config, radio_a, sink, pool };
+    comm::mesh::radio_network network_b { mesh_config, radio_b, broadcaster, pool };
+
+    err += network_a.start();
+    err += network_b.start();
+
+    if (!err.is_ok()) {
+        log::error("FAIL: unable to start networks");
+        return -1;
+    }
+
+    std::vector<uint8_t> payload(1024);
+    std::iota(payload.begin(), payload.end(), 0);
+
+    const auto send = [&](size_t count) {
+        const auto expected = receiver->frames() + count;
+
+        for (size_t i = 0; i < count; ++i) {
+            // Distinct payloads, the dedup cache would drop repeats on the same module
+            payload[0] = static_cast<uint8_t>(i);
+            payload[1] = static_cast<uint8_t>(i >> 8);
+
+            if (i % 2) {
+                err += network_a.transmit(frame_view { payload });
+            } else {
+                err += network_a.transmit_async(frame_view { payload }, {});
+            }
+        }
+
+        const auto deadline = std::chrono::steady_clock::now() + 10s;
+        while (receiver->frames() < expected && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(1ms);
+        }
+
+        return receiver->frames() >= expected;
+    };
+
+    auto delivered = send(warmup_frames);
+
+    const auto allocations_before = heap_allocations.load();
+    delivered = delivered && send(frames);
+    const auto allocations = heap_allocations.load() - allocations_before;
+
+    err += network_a.stop();
+    err += network_b.stop();
+
+    receiver->stop();
+    sink->stop();
+
+    const auto stats = pool->get_stats();
+
+    log::info("[Frame Pool Test] {} frames: {} heap allocations, pool {}/{} free, {} exhausted",
+              frames,
+              allocations,
+              stats.available,
+              stats.capacity,
+              stats.exhausted);
+
+    if (!delivered || !err.is_ok()) {
+        log::error("FAIL: frames weren't delivered");
+        return -1;
+    }
+
+    if (allocations != 0) {
+        log::error("FAIL: {:.2f} heap allocations per frame",
+                   static_cast<double>(allocations) / frames);
+        return -1;
+    }
+
+    log::info("[Frame Pool Test] [steady state] PASSED");
+    return 0;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+    int rc = 0;
+
+    rc += test_pool();
+    rc += test_steady_state();
+
+    return rc;
+}
@@ -0,0 +1,247 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "kaonic/comm/mesh/frame_pool.hpp"
+#include "kaonic/comm/mesh/frame_ring.hpp"
+#include "kaonic/common/logging.hpp"
+
+using namespace kaonic;
+using namespace std::chrono_literals;
+
+using comm::mesh::frame;
+using comm::mesh::frame_pool;
+using comm::mesh::frame_ring;
+using comm::mesh::frame_subscriber;
+using comm::mesh::overflow_policy;
+using comm::mesh::subscriber_config;
+
+static auto make_frame(frame_pool& pool, uint32_t id) -> frame {
+    std::vector<uint8_t> payload(128, 0x5A);
+    payload[0] = static_cast<uint8_t>(id);
+    payload[1] = static_cast<uint8_t>(id >> 8);
+    payload[2] = static_cast<uint8_t>(id >> 16);
+
+    return frame { pool.copy(payload), {} };
+}
+
+static auto frame_id(const frame& frame) -> uint32_t {
+    const auto* data = frame.buffer.data();
+    return data[0] | (data[1] << 8) | (data[2] << 16);
+}
+
+// Reads whatever is waiting without blocking
+static auto drain(frame_subscriber& subscriber) -> std::vector<uint32_t> {
+    std::vector<uint32_t> ids;
+
+    frame frame;
+    while (subscriber.pop(frame, 0ms)) {
+        ids.push_back(frame_id(frame));
+    }
+
+    return ids;
+}
+
+// Every subscriber sees every frame, all of them share the published buffer
+static auto test_fan_out() -> int {
+    log::info("[Frame Ring Test] Fan out test");
+
+    frame_pool pool { 64 };
+    frame_ring ring { 16 };
+
+    {
+        // Published before anybody listens, nobody gets it
+        ring.publish(make_frame(pool, 100));
+
+        frame_subscriber first { ring };
+        frame_subscriber second { ring };
+
+        std::vector<const uint8_t*> buffers;
+        for (uint32_t i = 0; i < 8; ++i) {
+            const auto published = make_frame(pool, i);
+            buffers.push_back(published.buffer.data());
+            ring.publish(published);
+        }
+
+        for (auto* subscriber : { &first, &second }) {
+            frame frame;
+            for (uint32_t i = 0; i < 8; ++i) {
+                if (!subscriber->pop(frame, 0ms) || frame_id(frame) != i
+                    || frame.buffer.data() != buffers[i]) {
+                    log::error("FAIL: subscriber didn't get frame {} in the published buffer", i);
+                    return -1;
+                }
+            }
+
+            if (subscriber->pop(frame, 0ms) || subscriber->get_stats().delivered != 8) {
+                log::error("FAIL: subscriber got more frames than were published");
+                return -1;
+            }
+        }
+    }
+
+    // Last subscriber gave the buffers back
+    if (ring.subscriber_count() != 0 || pool.get_stats().available != 64) {
+        log::error("FAIL: ring holds {} buffers without subscribers",
+                   64 - pool.get_stats().available);
+        return -1;
+    }
+
+    log::info("[Frame Ring Test] [fan out] PASSED");
+    return 0;
+}
+
+static auto test_policies() -> int {
+    log::info("[Frame Ring Test] Overflow policy test");
+
+    frame_pool pool { 64 };
+    frame_ring ring { 16 };
+
+    frame_subscriber oldest { ring, subscriber_config { .depth = 4 } };
+    frame_subscriber newest {
+        ring, subscriber_config { .depth = 4, .policy = overflow_policy::drop_newest }
+    };
+    frame_subscriber disconnect {
+        ring, subscriber_config { .depth = 4, .policy = overflow_policy::disconnect }
+    };
+    frame_subscriber reader { ring, subscriber_config { .depth = 16 } };
+
+    for (uint32_t i = 0; i < 10; ++i) {
+        ring.publish(make_frame(pool, i));
+    }
+
+    const auto oldest_stats = oldest.get_stats();
+    const auto newest_stats = newest.get_stats();
+
+    if (oldest_stats.lag != 4 || oldest_stats.dropped != 6 || newest_stats.lag != 4
+        || !disconnect.is_disconnected() || reader.get_stats().lag != 10) {
+        log::error("FAIL: lag and drops don't follow the policies");
+        return -1;
+    }
+
+    if (drain(oldest) != std::vector<uint32_t> { 6, 7, 8, 9 }
+        || drain(newest) != std::vector<uint32_t> { 0, 1, 2, 3 } || !drain(disconnect).empty()
+        || drain(reader).size() != 10) {
+        log::error("FAIL: subscribers didn't keep the frames of their policy");
+        return -1;
+    }
+
+    // Backlog is read, drop_newest takes frames again
+    ring.publish(make_frame(pool, 10));
+
+    if (drain(newest) != std::vector<uint32_t> { 10 } || newest.get_stats().dropped != 6) {
+        log::error("FAIL: drop_newest didn't pick up after its backlog");
+        return -1;
+    }
+
+    // Ring wraps around a backlog that's never read, 11-14 are replaced and 30-33 is the
+    // backlog taken once nothing was left of it
+    for (uint32_t i = 11; i < 40; ++i) {
+        ring.publish(make_frame(pool, i));
+    }
+
+    if (drain(newest) != std::vector<uint32_t> { 30, 31, 32, 33 }) {
+        log::error("FAIL: drop_newest read frames replaced in the ring");
+        return -1;
+    }
+
+    log::info("[Frame Ring Test] [policies] PASSED");
+    return 0;
+}
+
+// One producer and many readers, every reader sees the frames in order
+static auto run_concurrent(size_t subscribers) -> int {
+    constexpr uint32_t frames = 2000;
+
+    frame_pool pool { 256 };
+    frame_ring ring { 64 };
+
+    std::atomic<size_t> ready { 0 };
+    std::atomic<size_t> failed { 0 };
+    std::atomic<size_t> dropped { 0 };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < subscribers; ++i) {
+        threads.emplace_back([&] {
+            frame_subscriber subscriber { ring, subscriber_config { .depth = 64 } };
+            ++ready;
+
+            frame frame;
+            uint32_t expected = 0;
+
+            while (expected < frames) {
+                if (!subscriber.pop(frame, 1s)) {
+                    ++failed;
+                    return;
+                }
+
+                const auto id = frame_id(frame);
+                if (id < expected) {
+                    ++failed;
+                    return;
+                }
+                expected = id + 1;
+            }
+
+            dropped += subscriber.get_stats().dropped;
+        });
+    }
+
+    while (ready < subscribers) {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < frames; ++i) {
+        ring.publish(make_frame(pool, i));
+
+        // Radio pace, readers mostly keep up
+        if (i % 16 == 0) {
+            std::this_thread::sleep_for(100us);
+        }
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    log::info("[Frame Ring Test] {} frames to {} subscribers in {}ms, {} dropped",
+              frames,
+              subscribers,
+              std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(),
+              dropped.load());
+
+    if (failed != 0) {
+        log::error("FAIL: {} subscribers got frames out of order or none at all", failed.load());
+        return -1;
+    }
+
+    return 0;
+}
+
+static auto test_concurrent() -> int {
+    log::info("[Frame Ring Test] Concurrent test");
+
+    for (const auto subscribers : { 4u, 100u }) {
+        if (run_concurrent(subscribers) != 0) {
+            return -1;
+        }
+    }
+
+    log::info("[Frame Ring Test] [concurrent] PASSED");
+    return 0;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+    int rc = 0;
+
+    rc += test_fan_out();
+    rc += test_policies();
+    rc += test_concurrent();
+
+    return rc;
+}
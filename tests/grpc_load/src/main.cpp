@@ -0,0 +1,488 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "kaonic/comm/mesh/radio_network.hpp"
+#include "kaonic/comm/radio/sim_radio.hpp"
+#include "kaonic/comm/services/grpc_service.hpp"
+#include "kaonic/comm/services/radio_frame.hpp"
+#include "kaonic/comm/services/radio_service.hpp"
+#include "kaonic/common/copy_stats.hpp"
+#include "kaonic/common/logging.hpp"
+
+#include <grpcpp/create_channel.h>
+
+using namespace kaonic;
+using namespace std::chrono_literals;
+
+struct load_config final {
+    size_t subscribers = 128;
+    size_t frames = 100;
+    size_t server_threads = 2;
+};
+
+// Streams are spread over a few connections, like clients on several hosts
+constexpr static size_t connections = 8;
+
+static const comm::mesh::config mesh_config {
+    .packet_pattern = 0xB1EE,
+    .slot_duration = 15ms,
+    .gap_duration = 2ms,
+    .beacon_interval = 5000ms,
+};
+
+class counting_receiver final : public comm::mesh::network_receiver {
+
+public:
+    auto on_receive(const comm::mesh::frame_view& frame) -> void final { ++_frames; }
+
+    [[nodiscard]] auto frames() const noexcept -> size_t { return _frames; }
+
+private:
+    std::atomic<size_t> _frames { 0 };
+};
+
+static auto thread_count() -> size_t {
+    size_t count = 0;
+    for (const auto& entry : std::filesystem::directory_iterator { "/proc/self/task" }) {
+        (void)entry;
+        ++count;
+    }
+    return count;
+}
+
+static auto make_channel(int port, size_t index) -> std::shared_ptr<::grpc::Channel> {
+    // Channels with the same arguments would share one connection
+    ::grpc::ChannelArguments args;
+    args.SetInt("kaonic.connection", static_cast<int>(index));
+
+    return ::grpc::CreateCustomChannel(
+        "127.0.0.1:" + std::to_string(port), ::grpc::InsecureChannelCredentials(), args);
+}
+
+// Reads the frames of one stream, the first response only tells the stream is open
+class subscriber final {
+
+public:
+    explicit subscriber(const std::shared_ptr<::grpc::Channel>& channel,
+                        FrameEncoding encoding) noexcept
+        : _stub { Radio::NewStub(channel) }
+        , _encoding { encoding } {}
+
+    auto run(std::atomic<size_t>& subscribed, size_t frames) -> void {
+        ReceiveRequest request;
+        request.set_encoding(_encoding);
+
+        _reader = _stub->ReceiveStream(&_context, request);
+
+        ReceiveResponse response;
+        if (!_reader->Read(&response)) {
+            return;
+        }
+
+        ++subscribed;
+
+        uint32_t expected = 0;
+        while (_frames < frames && _reader->Read(&response)) {
+            // Frames come in the encoding the stream asked for
+            const auto encoded_bytes = !response.frame().payload().empty();
+            const auto view = comm::radio_frame_view(response.frame());
+            const uint32_t id = view.buffer[0] | (view.buffer[1] << 8);
+
+            _in_order = _in_order && id == expected
+                && encoded_bytes == (_encoding == FRAME_ENCODING_BYTES);
+            expected = id + 1;
+
+            ++_frames;
+        }
+    }
+
+    auto cancel() -> void { _context.TryCancel(); }
+
+    [[nodiscard]] auto frames() const noexcept -> size_t { return _frames; }
+
+    [[nodiscard]] auto in_order() const noexcept -> bool { return _in_order; }
+
+private:
+    std::unique_ptr<Radio::Stub> _stub;
+    const FrameEncoding _encoding;
+    ::grpc::ClientContext _context;
+    std::unique_ptr<::grpc::ClientReader<ReceiveResponse>> _reader;
+
+    std::atomic<size_t> _frames { 0 };
+    bool _in_order = true;
+};
+
+// Every stream gets every frame heard by the board, the server keeps its thread count
+static auto test_streams(const load_config& config,
+                         comm::grpc_service& service,
+                         comm::mesh::radio_network& peer) -> int {
+    log::info("[GRPC Load Test] {} streams, {} frames, {} server threads",
+              config.subscribers,
+              config.frames,
+              config.server_threads);
+
+    std::vector<std::shared_ptr<::grpc::Channel>> channels;
+    for (size_t i = 0; i < connections; ++i) {
+        channels.push_back(make_channel(service.port(), i));
+    }
+
+    // Old and new clients read the same frames
+    std::vector<std::unique_ptr<subscriber>> subscribers;
+    for (size_t i = 0; i < config.subscribers; ++i) {
+        subscribers.push_back(std::make_unique<subscriber>(
+            channels[i % connections], i % 2 ? FRAME_ENCODING_BYTES : FRAME_ENCODING_WORDS));
+    }
+
+    // Client threads are counted out, only threads the server starts for the streams remain
+    std::atomic_bool go { false };
+    std::atomic<size_t> subscribed { 0 };
+
+    std::vector<std::thread> threads;
+    for (auto& client : subscribers) {
+        threads.emplace_back([&, client = client.get()] {
+            while (!go) {
+                std::this_thread::sleep_for(1ms);
+            }
+            client->run(subscribed, config.frames);
+        });
+    }
+
+    std::this_thread::sleep_for(50ms);
+    const auto threads_before = thread_count();
+
+    go = true;
+
+    const auto subscribe_deadline = std::chrono::steady_clock::now() + 10s;
+    while (subscribed < config.subscribers
+           && std::chrono::steady_clock::now() < subscribe_deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+
+    const auto threads_after = thread_count();
+
+    std::vector<uint8_t> payload(256, 0x3C);
+    const auto start = std::chrono::steady_clock::now();
+
+    copy_counter::reset();
+
+    size_t sent = 0;
+    for (size_t i = 0; i < config.frames; ++i) {
+        payload[0] = static_cast<uint8_t>(i);
+        payload[1] = static_cast<uint8_t>(i >> 8);
+
+        sent += peer.transmit(comm::mesh::frame_view { payload }).is_ok() ? 1 : 0;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    const auto all_received = [&] {
+        for (const auto& client : subscribers) {
+            if (client->frames() < sent) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    while (!all_received() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const auto copies = copy_counter::get_stats();
+
+    size_t complete = 0;
+    size_t in_order = 0;
+    size_t min_frames = sent;
+
+    for (const auto& client : subscribers) {
+        complete += client->frames() == sent ? 1 : 0;
+        in_order += client->in_order() ? 1 : 0;
+        min_frames = std::min(min_frames, client->frames());
+        client->cancel();
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    log::info("[GRPC Load Test] {}/{} streams open, {}/{} got all {} frames (min {}) in {}ms",
+              subscribed.load(),
+              config.subscribers,
+              complete,
+              config.subscribers,
+              sent,
+              min_frames,
+              std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+    log::info("[GRPC Load Test] threads: {} before the streams, {} with them",
+              threads_before,
+              threads_after);
+    log::info("[GRPC Load Test] {} payload copies on the RX path for {} frames",
+              copies.rx_copies,
+              sent);
+
+    if (sent != config.frames || subscribed != config.subscribers
+        || complete != config.subscribers || in_order != config.subscribers) {
+        log::error("FAIL: streams didn't get every frame in order");
+        return -1;
+    }
+
+    // Radio and broadcaster copy a frame once each, it's packed and serialized once per
+    // encoding however many streams read it. A few beacons may be heard meanwhile.
+    if (copies.rx_copies > sent * 4 + 16) {
+        log::error("FAIL: frames were packed for every stream");
+        return -1;
+    }
+
+    // gRPC may start a few threads of its own, none are started per stream
+    if (threads_after > threads_before + connections) {
+        log::error("FAIL: server started {} threads for the streams",
+                   threads_after - threads_before);
+        return -1;
+    }
+
+    log::info("[GRPC Load Test] [streams] PASSED");
+    return 0;
+}
+
+static auto test_unary(comm::grpc_service& service, const counting_receiver& peer_receiver)
+    -> int {
+    log::info("[GRPC Load Test] Unary calls test");
+
+    const auto stub = Radio::NewStub(make_channel(service.port(), 0));
+
+    constexpr size_t frames = 10;
+    const auto received = peer_receiver.frames();
+
+    // Sent from several clients at once, each call waits for its frame to be sent
+    std::atomic<size_t> sent { 0 };
+    std::atomic<size_t> latency_us { 0 };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < frames; ++i) {
+        threads.emplace_back([&, i] {
+            TransmitRequest request;
+            request.set_module(MODULE_A);
+            request.mutable_frame()->add_data(static_cast<uint32_t>(0xC0DE0000 | i));
+            request.mutable_frame()->set_length(sizeof(uint32_t));
+
+            TransmitResponse response;
+            ::grpc::ClientContext context;
+
+            if (stub->Transmit(&context, request, &response).ok()) {
+                ++sent;
+                latency_us += response.latency();
+            }
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + 2s;
+    while (peer_receiver.frames() < received + frames
+           && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+
+    // Same channel as before, the peer keeps hearing the board
+    const comm::radio_config radio_config;
+    ConfigurationRequest configure;
+    configure.set_module(MODULE_A);
+    configure.set_freq(radio_config.freq);
+    configure.set_channel(radio_config.channel);
+    configure.set_channel_spacing(radio_config.channel_spacing);
+    Empty empty;
+    ::grpc::ClientContext configure_context;
+    const auto configured = stub->Configure(&configure_context, configure, &empty).ok();
+
+    // Unknown module ends the stream right away
+    ReceiveRequest invalid;
+    invalid.set_module(static_cast<RadioModule>(7));
+    ::grpc::ClientContext stream_context;
+    auto reader = stub->ReceiveStream(&stream_context, invalid);
+    ReceiveResponse response;
+    const auto read = reader->Read(&response);
+    const auto status = reader->Finish();
+
+    log::info("[GRPC Load Test] {}/{} frames sent, {} received by the peer, mean latency {}us",
+              sent.load(),
+              frames,
+              peer_receiver.frames() - received,
+              sent ? latency_us / sent : 0);
+
+    if (sent != frames || peer_receiver.frames() < received + frames || latency_us == 0) {
+        log::error("FAIL: transmits weren't sent");
+        return -1;
+    }
+
+    if (!configured || read || status.error_code() != ::grpc::StatusCode::INVALID_ARGUMENT) {
+        log::error("FAIL: configure or stream of an unknown module didn't finish as expected");
+        return -1;
+    }
+
+    log::info("[GRPC Load Test] [unary] PASSED");
+    return 0;
+}
+
+// One client keeps the TX queue full, every frame is acked once
+static auto test_transmit_stream(comm::grpc_service& service,
+                                 const counting_receiver& peer_receiver) -> int {
+    log::info("[GRPC Load Test] Transmit stream test");
+
+    const auto stub = Radio::NewStub(make_channel(service.port(), 0));
+
+    constexpr size_t frames = 200;
+    const auto received = peer_receiver.frames();
+
+    ::grpc::ClientContext context;
+    auto stream = stub->TransmitStream(&context);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::thread writer { [&] {
+        TransmitRequest request;
+        request.set_module(MODULE_A);
+
+        std::vector<uint8_t> payload(32, 0x5E);
+
+        for (size_t i = 0; i < frames; ++i) {
+            payload[0] = static_cast<uint8_t>(i);
+            comm::radio_frame_pack(payload, FRAME_ENCODING_BYTES, *request.mutable_frame());
+            if (!stream->Write(request)) {
+                break;
+            }
+        }
+
+        stream->WritesDone();
+    } };
+
+    std::vector<bool> acked(frames, false);
+    size_t acks = 0;
+    size_t sent = 0;
+    size_t responses = 0;
+    uint64_t latency_us = 0;
+
+    TransmitStreamResponse response;
+    while (stream->Read(&response)) {
+        ++responses;
+
+        for (const auto& ack : response.acks()) {
+            if (ack.sequence() < frames && !acked[ack.sequence()]) {
+                acked[ack.sequence()] = true;
+                ++acks;
+            }
+            sent += ack.sent() ? 1 : 0;
+            latency_us += ack.latency();
+        }
+    }
+
+    writer.join();
+    const auto status = stream->Finish();
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    const auto deadline = std::chrono::steady_clock::now() + 2s;
+    while (peer_receiver.frames() < received + frames
+           && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+
+    log::info("[GRPC Load Test] {}/{} frames acked in {} responses, {} sent, {} received by the "
+              "peer in {}ms, mean latency {}us",
+              acks,
+              frames,
+              responses,
+              sent,
+              peer_receiver.frames() - received,
+              std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(),
+              sent ? latency_us / sent : 0);
+
+    if (!status.ok() || acks != frames || sent != frames
+        || peer_receiver.frames() < received + frames) {
+        log::error("FAIL: stream didn't ack every frame once");
+        return -1;
+    }
+
+    log::info("[GRPC Load Test] [transmit stream] PASSED");
+    return 0;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+    log::set_level(log::level::info);
+
+    load_config config;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg { argv[i] };
+        const auto pos = arg.find('=');
+        const auto key = arg.substr(0, pos);
+        const auto value = pos == std::string_view::npos ? std::string_view {} : arg.substr(pos + 1);
+
+        if (key == "--subscribers") {
+            config.subscribers = std::strtoul(value.data(), nullptr, 10);
+        } else if (key == "--frames") {
+            config.frames = std::strtoul(value.data(), nullptr, 10);
+        } else if (key == "--threads") {
+            config.server_threads = std::strtoul(value.data(), nullptr, 10);
+        } else {
+            log::error("[GRPC Load Test] unknown argument '{}'", arg);
+            log::info("usage: grpc_load [--subscribers=128] [--frames=100] [--threads=2]");
+            return -1;
+        }
+    }
+
+    const auto medium =
+        std::make_shared<comm::sim_medium>(comm::sim_medium_config { .collisions = false });
+
+    const auto board_radio =
+        std::make_shared<comm::sim_radio>(comm::sim_radio_config { .name = "board" }, medium);
+    const auto peer_radio =
+        std::make_shared<comm::sim_radio>(comm::sim_radio_config { .name = "peer" }, medium);
+
+    auto err = board_radio->configure(comm::radio_config {});
+    err += peer_radio->configure(comm::radio_config {});
+
+    const auto radio_service = std::make_shared<comm::radio_service>(
+        mesh_config, std::vector<std::shared_ptr<comm::radio>> { board_radio });
+
+    // Broadcaster only keeps a weak reference to its listeners
+    const auto publisher = std::make_shared<comm::response_publisher>(
+        radio_service->module_count());
+    radio_service->attach_listener(publisher);
+
+    const auto grpc_service = std::make_shared<comm::grpc_service>(
+        radio_service,
+        publisher,
+        "test",
+        comm::grpc_config { .address = "127.0.0.1:0", .threads = config.server_threads });
+
+    const auto peer_receiver = std::make_shared<counting_receiver>();
+    comm::mesh::radio_network peer { mesh_config, peer_radio, peer_receiver };
+
+    err += peer.start();
+    err += grpc_service->start();
+
+    if (!err.is_ok()) {
+        log::error("[GRPC Load Test] unable to start the service");
+        return -1;
+    }
+
+    int rc = 0;
+
+    rc += test_streams(config, *grpc_service, peer);
+    rc += test_unary(*grpc_service, *peer_receiver);
+    rc += test_transmit_stream(*grpc_service, *peer_receiver);
+
+    grpc_service->stop();
+    err += peer.stop();
+
+    return rc;
+}
@@ -1,14 +1,40 @@
+#include <cstdlib>
 #include <iomanip>
+#include <new>
 #include <numeric>
 #include <sstream>
 
-#include "kaonic/comm/mesh/network_interface.hpp"
 #include "kaonic/comm/serial/hdlc.hpp"
 #include "kaonic/comm/serial/packet.hpp"
 #include "kaonic/common/logging.hpp"
 
 using namespace kaonic;
 
+// Decoding into a payload that already holds a message of the packet's type doesn't allocate
+static size_t allocations = 0;
+
+auto operator new(size_t size) -> void* {
+    ++allocations;
+
+    if (auto* ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc {};
+}
+
+auto operator delete(void* ptr) noexcept -> void {
+    std::free(ptr);
+}
+
+auto operator delete(void* ptr, size_t) noexcept -> void {
+    std::free(ptr);
+}
+
+// Payload as the services see it before it's packed into a RadioFrame
+struct test_frame final {
+    std::vector<uint8_t> buffer;
+};
+
 static auto buf_pack(const RadioFrame& src, std::vector<uint8_t>& dst) -> void {
     const auto& data = src.data();
     dst.resize(data.size() * sizeof(uint32_t));
@@ -22,7 +48,7 @@ static auto buf_unpack(const std::vector<uint8_t>& src, RadioFrame& dst) -> void
     size_t dst_size = src.size() / sizeof(uint32_t);
     dst_size += (src.size() - dst_size * sizeof(uint32_t)) ? 1 : 0;
     data->Resize(dst_size, 0);
-    memcpy(data->begin(), src.data(), src.size());
+    memcpy(data->mutable_data(), src.data(), src.size());
 
     dst.set_length(src.size());
 }
@@ -41,7 +67,7 @@ static auto vector_to_string(const std::vector<uint8_t>& vec) noexcept -> std::s
 static auto test_radio_to_client() -> int {
     log::info("[HDLC Test] Radio to Client test");
 
-    comm::mesh::frame rx_test_frame;
+    test_frame rx_test_frame;
     rx_test_frame.buffer.resize(10);
 
     std::iota(rx_test_frame.buffer.begin(), rx_test_frame.buffer.end(), 1);
@@ -78,7 +104,7 @@ static auto test_radio_to_client() -> int {
 
     comm::serial::packet::decode(rx_unescaped_buffer, rx_final_payload);
 
-    comm::mesh::frame rx_final_frame;
+    test_frame rx_final_frame;
     buf_pack(rx_final_response.frame(), rx_final_frame.buffer);
     log::info("[HDLC Test] Output frame elements:");
     log::info(vector_to_string(rx_final_frame.buffer));
@@ -102,7 +128,7 @@ static auto test_radio_to_client() -> int {
 static auto test_client_to_radio() -> int {
     log::info("[HDLC Test] Client to Radio test");
 
-    comm::mesh::frame tx_test_frame;
+    test_frame tx_test_frame;
     uint32_t tx_test_module = 1;
 
     tx_test_frame.buffer.resize(10);
@@ -117,7 +143,7 @@ static auto test_client_to_radio() -> int {
 
     auto& tx_radio_frame = *tx_test_request.mutable_frame();
     buf_unpack(tx_test_frame.buffer, tx_radio_frame);
-    tx_test_request.set_module(tx_test_module);
+    tx_test_request.set_module(static_cast<RadioModule>(tx_test_module));
 
     comm::serial::buffer_t tx_buffer;
     comm::serial::packet::encode(tx_test_request, tx_buffer);
@@ -142,7 +168,7 @@ static auto test_client_to_radio() -> int {
 
     comm::serial::packet::decode(tx_unescaped_buffer, tx_final_payload);
 
-    comm::mesh::frame tx_final_frame;
+    test_frame tx_final_frame;
     buf_pack(tx_final_request.frame(), tx_final_frame.buffer);
     log::info("[HDLC Test] Output frame elements:");
     log::info(vector_to_string(tx_final_frame.buffer));
@@ -210,6 +236,47 @@ static auto test_special_hdlc_flags() -> int {
     return 0;
 }
 
+static auto test_decode_reuse() -> int {
+    log::info("[HDLC Test] Decode reuse test");
+
+    constexpr size_t packets = 100;
+
+    TransmitRequest request;
+    request.set_module(MODULE_B);
+    for (uint32_t i = 0; i < 64; ++i) {
+        request.mutable_frame()->add_data(0xA5A50000 | i);
+    }
+    request.mutable_frame()->set_length(64 * sizeof(uint32_t));
+
+    comm::serial::buffer_t buffer;
+    comm::serial::packet::encode(request, buffer);
+
+    // First packet sizes the fields of the payload's message
+    comm::serial::payload_t payload;
+    comm::serial::packet::decode(buffer, payload);
+
+    const auto before = allocations;
+    for (size_t i = 0; i < packets; ++i) {
+        comm::serial::packet::decode(buffer, payload);
+    }
+    const auto made = allocations - before;
+
+    const auto* decoded = std::get_if<TransmitRequest>(&payload);
+    if (!decoded || decoded->module() != MODULE_B || decoded->frame().data_size() != 64
+        || decoded->frame().data(63) != (0xA5A50000 | 63)) {
+        log::error("FAIL: decoded request doesn't match");
+        return -1;
+    }
+
+    if (made != 0) {
+        log::error("FAIL: {} allocations for {} packets", made, packets);
+        return -1;
+    }
+
+    log::info("[HDLC Test] [decode-reuse] PASSED");
+    return 0;
+}
+
 auto main(int argc, char** argv) noexcept -> int {
     int rc = 0;
 
@@ -219,5 +286,8 @@ auto main(int argc, char** argv) noexcept -> int {
     std::cout << std::endl;
     rc += test_special_hdlc_flags();
 
+    std::cout << std::endl;
+    rc += test_decode_reuse();
+
     return rc;
 }
@@ -0,0 +1,196 @@
+#include <atomic>
+#include <chrono>
+#include <linux/gpio.h>
+#include <mutex>
+#include <poll.h>
+#include <thread>
+#include <unistd.h>
+
+#include "kaonic/comm/drivers/irq_line.hpp"
+#include "kaonic/common/logging.hpp"
+
+using namespace kaonic;
+using namespace std::chrono_literals;
+
+// Pipe standing in for the line request fd, the kernel hands edges out the same way
+class fake_line final {
+
+public:
+    explicit fake_line() noexcept {
+        if (::pipe(_fds) != 0) {
+            _fds[0] = _fds[1] = -1;
+        }
+    }
+
+    ~fake_line() {
+        ::close(_fds[0]);
+        ::close(_fds[1]);
+    }
+
+    [[nodiscard]] auto fd() const noexcept -> int { return _fds[0]; }
+
+    auto edge(uint64_t timestamp) noexcept -> bool {
+        gpio_v2_line_event event {};
+        event.timestamp_ns = timestamp;
+        return ::write(_fds[1], &event, sizeof(event)) == sizeof(event);
+    }
+
+private:
+    int _fds[2];
+};
+
+// Locking as in rf215_radio: the IRQ thread polls the line without the device lock and takes
+// the edge under it, a transmit holds the lock while it waits for its own IRQ
+class irq_device final {
+
+public:
+    explicit irq_device(const drivers::irq_line& line) noexcept
+        : _line { line } {
+        _thread = std::thread([this] {
+            pollfd fd { .fd = _line.fd(), .events = POLLIN, .revents = 0 };
+
+            while (_running) {
+                const auto rc = ::poll(&fd, 1, 50);
+
+                // A stuck reader would keep the lock forever and time the transmit out
+                std::lock_guard lock { _mut };
+
+                std::chrono::nanoseconds timestamp {};
+                if (rc > 0 && (fd.revents & POLLIN) && _line.take(timestamp)) {
+                    ++_irq_edges;
+                }
+            }
+        });
+    }
+
+    ~irq_device() { stop(); }
+
+    [[nodiscard]] auto transmit(fake_line& line, uint64_t timestamp) -> bool {
+        std::unique_lock lock { _mut, std::defer_lock };
+        if (!lock.try_lock_for(1s)) {
+            return false;
+        }
+
+        // TX end IRQ, the IRQ thread wakes up as well and waits for the lock
+        if (!line.edge(timestamp)) {
+            return false;
+        }
+        std::this_thread::sleep_for(100us);
+
+        std::chrono::nanoseconds taken {};
+        if (!_line.wait(10ms) || !_line.take(taken)) {
+            return false;
+        }
+
+        return taken.count() == static_cast<int64_t>(timestamp);
+    }
+
+    auto stop() -> void {
+        _running = false;
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+    [[nodiscard]] auto irq_edges() const noexcept -> size_t { return _irq_edges; }
+
+private:
+    const drivers::irq_line& _line;
+
+    std::timed_mutex _mut;
+    std::atomic_bool _running { true };
+    std::atomic<size_t> _irq_edges { 0 };
+
+    std::thread _thread;
+};
+
+static auto test_take() -> int {
+    log::info("[IRQ Line Test] Take test");
+
+    fake_line fake;
+    drivers::irq_line line;
+
+    if (!line.open(fake.fd()).is_ok()) {
+        log::error("FAIL: unable to open line");
+        return -1;
+    }
+
+    std::chrono::nanoseconds timestamp {};
+    if (line.wait(0ns) || line.take(timestamp)) {
+        log::error("FAIL: edge reported on an idle line");
+        return -1;
+    }
+
+    fake.edge(1);
+    fake.edge(2);
+    fake.edge(3);
+
+    if (!line.wait(0ns) || !line.take(timestamp) || timestamp != 3ns) {
+        log::error("FAIL: latest edge wasn't taken");
+        return -1;
+    }
+
+    if (line.wait(0ns) || line.take(timestamp)) {
+        log::error("FAIL: edges weren't drained");
+        return -1;
+    }
+
+    log::info("[IRQ Line Test] [take] PASSED");
+    return 0;
+}
+
+// IRQ-driven transmits take their edge while the IRQ thread already saw the line readable
+static auto test_transmit_with_irq_thread() -> int {
+    log::info("[IRQ Line Test] Transmit with IRQ thread test");
+
+    constexpr size_t transmits = 200;
+
+    fake_line fake;
+    drivers::irq_line line;
+
+    if (!line.open(fake.fd()).is_ok()) {
+        log::error("FAIL: unable to open line");
+        return -1;
+    }
+
+    irq_device device { line };
+
+    size_t sent = 0;
+    for (; sent < transmits; ++sent) {
+        if (!device.transmit(fake, sent + 1)) {
+            break;
+        }
+
+        // Receive IRQs in between are the IRQ thread's
+        if (sent % 10 == 0) {
+            fake.edge(0);
+        }
+    }
+
+    if (sent != transmits) {
+        // Lets a blocked reader go so the thread can be joined
+        fake.edge(0);
+        device.stop();
+
+        log::error("FAIL: transmit {} didn't complete", sent);
+        return -1;
+    }
+
+    device.stop();
+
+    log::info("[IRQ Line Test] {} transmits, {} edges taken by the IRQ thread",
+              transmits,
+              device.irq_edges());
+
+    log::info("[IRQ Line Test] [transmit with irq thread] PASSED");
+    return 0;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+    int rc = 0;
+
+    rc += test_take();
+    rc += test_transmit_with_irq_thread();
+
+    return rc;
+}
@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "kaonic/comm/mesh/network_receiver.hpp"
+#include "kaonic/common/logging.hpp"
+#include "kaonic/common/mpmc_queue.hpp"
+
+using namespace kaonic;
+using namespace std::chrono_literals;
+
+using comm::mesh::dedup_filter;
+using comm::mesh::drop_policy;
+using comm::mesh::frame_info;
+using comm::mesh::frame_view;
+using comm::mesh::listener_config;
+using comm::mesh::network_broadcast_receiver;
+
+// Records the id in the first payload bytes of every frame, may hold the first one back
+class recording_receiver final : public comm::mesh::network_receiver {
+
+public:
+    explicit recording_receiver(std::chrono::milliseconds delay = 0ms, bool hold = false) noexcept
+        : _delay { delay }
+        , _hold { hold } {}
+
+    auto on_receive(const frame_view& frame) -> void final {
+        if (_hold.load()) {
+            _holding = true;
+            while (_hold.load()) {
+                std::this_thread::sleep_for(1ms);
+            }
+        }
+
+        std::this_thread::sleep_for(_delay);
+
+        std::lock_guard lock { _mut };
+        _ids.push_back(frame.buffer[0] | (frame.buffer[1] << 8));
+    }
+
+    auto release() noexcept -> void { _hold = false; }
+
+    [[nodiscard]] auto holding() const noexcept -> bool { return _holding; }
+
+    [[nodiscard]] auto ids() const -> std::vector<int> {
+        std::lock_guard lock { _mut };
+        return _ids;
+    }
+
+    [[nodiscard]] auto wait(size_t count, std::chrono::milliseconds timeout) const -> bool {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (ids().size() < count && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(1ms);
+        }
+        return ids().size() >= count;
+    }
+
+private:
+    const std::chrono::milliseconds _delay;
+
+    std::atomic_bool _hold;
+    std::atomic_bool _holding { false };
+
+    mutable std::mutex _mut;
+    std::vector<int> _ids;
+};
+
+static auto send(network_broadcast_receiver& broadcaster, int id, uint8_t module = 0)
+    -> std::chrono::nanoseconds {
+    std::vector<uint8_t> payload(256, 0xA5);
+    payload[0] = static_cast<uint8_t>(id);
+    payload[1] = static_cast<uint8_t>(id >> 8);
+
+    const auto start = std::chrono::steady_clock::now();
+    broadcaster.on_receive(frame_view { payload, frame_info { .module = module } });
+    return std::chrono::steady_clock::now() - start;
+}
+
+static auto test_queue() -> int {
+    log::info("[Listener Channel Test] Queue test");
+
+    constexpr int producers = 4;
+    constexpr int count = 20000;
+
+    mpmc_queue<int> queue { 100 };
+
+    if (queue.capacity() != 128) {
+        log::error("FAIL: capacity isn't rounded up to a power of two");
+        return -1;
+    }
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, p] {
+            for (int i = 0; i < count; ++i) {
+                auto value = p * count + i;
+                while (!queue.try_push(std::move(value))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    // Every value arrives once, in order per producer
+    std::vector<int> last(producers, -1);
+    int received = 0;
+    bool ordered = true;
+
+    while (received < producers * count) {
+        int value = 0;
+        if (!queue.try_pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        const auto producer = value / count;
+        ordered = ordered && value % count > last[producer];
+        last[producer] = value % count;
+        ++received;
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    if (!ordered || !queue.empty()) {
+        log::error("FAIL: values were lost or reordered");
+        return -1;
+    }
+
+    log::info("[Listener Channel Test] [queue] PASSED");
+    return 0;
+}
+
+// Update thread keeps its timing while one listener takes 20ms per frame
+static auto test_slow_listener() -> int {
+    log::info("[Listener Channel Test] Slow listener test");
+
+    constexpr int frames = 200;
+
+    network_broadcast_receiver broadcaster;
+
+    const auto slow = std::make_shared<recording_receiver>(20ms);
+    const auto fast = std::make_shared<recording_receiver>();
+
+    broadcaster.attach_listener(slow, listener_config { .queue_size = 8 });
+    broadcaster.attach_listener(fast, listener_config { .queue_size = 256 });
+
+    // Attached twice it would get every frame twice
+    broadcaster.attach_listener(fast);
+
+    std::chrono::nanoseconds worst { 0 };
+    for (int i = 0; i < frames; ++i) {
+        worst = std::max(worst, send(broadcaster, i));
+        std::this_thread::sleep_for(100us);
+    }
+
+    const auto delivered = fast->wait(frames, 2s);
+
+    // Slow listener catches up with the frames left in its queue
+    const auto deadline = std::chrono::steady_clock::now() + 2s;
+    while (broadcaster.get_listener_stats()[0].queued != 0
+           && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+    std::this_thread::sleep_for(50ms);
+
+    const auto stats = broadcaster.get_listener_stats();
+    const auto slow_ids = slow->ids();
+
+    log::info("[Listener Channel Test] worst delivery call {}us, slow listener {} delivered "
+              "{} dropped, fast listener {} delivered",
+              std::chrono::duration_cast<std::chrono::microseconds>(worst).count(),
+              stats[0].delivered,
+              stats[0].dropped,
+              fast->ids().size());
+
+    if (stats.size() != 2 || !delivered || fast->ids().size() != frames) {
+        log::error("FAIL: fast listener didn't get every frame once");
+        return -1;
+    }
+
+    if (worst > 5ms) {
+        log::error("FAIL: update thread was held up by a listener");
+        return -1;
+    }
+
+    if (stats[0].dropped == 0 || slow_ids.empty() || slow_ids.back() != frames - 1) {
+        log::error("FAIL: slow listener didn't drop its stale frames");
+        return -1;
+    }
+
+    log::info("[Listener Channel Test] [slow listener] PASSED");
+    return 0;
+}
+
+static auto test_policy(drop_policy policy, const std::vector<int>& expected) -> int {
+    network_broadcast_receiver broadcaster;
+
+    const auto listener = std::make_shared<recording_receiver>(0ms, true);
+    broadcaster.attach_listener(listener, listener_config { .queue_size = 4, .policy = policy });
+
+    // Frame 0 is held by the listener, 1-9 wait in a queue of 4
+    send(broadcaster, 0);
+    while (!listener->holding()) {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    for (int i = 1; i < 10; ++i) {
+        send(broadcaster, i);
+    }
+
+    listener->release();
+    const auto delivered = listener->wait(expected.size(), 1s);
+    std::this_thread::sleep_for(20ms);
+
+    if (!delivered || listener->ids() != expected
+        || broadcaster.get_listener_stats()[0].dropped != 5) {
+        log::error("FAIL: got {} frames, not the ones the policy keeps", listener->ids().size());
+        return -1;
+    }
+
+    return 0;
+}
+
+static auto test_policies() -> int {
+    log::info("[Listener Channel Test] Drop policy test");
+
+    if (test_policy(drop_policy::oldest, { 0, 6, 7, 8, 9 }) != 0) {
+        return -1;
+    }
+
+    if (test_policy(drop_policy::newest, { 0, 1, 2, 3, 4 }) != 0) {
+        return -1;
+    }
+
+    log::info("[Listener Channel Test] [policies] PASSED");
+    return 0;
+}
+
+// Broadcaster per module, a frame heard by both radios goes to the module that heard it first
+static auto test_modules() -> int {
+    log::info("[Listener Channel Test] Modules test");
+
+    const auto dedup = std::make_shared<dedup_filter>(comm::mesh::dedup_config {});
+
+    network_broadcast_receiver broadcaster_a { dedup };
+    network_broadcast_receiver broadcaster_b { dedup };
+
+    const auto listener_a = std::make_shared<recording_receiver>();
+    const auto listener_b = std::make_shared<recording_receiver>();
+
+    broadcaster_a.attach_listener(listener_a);
+    broadcaster_b.attach_listener(listener_b);
+
+    send(broadcaster_a, 1, 0);
+    send(broadcaster_b, 1, 1);
+    send(broadcaster_b, 2, 1);
+    send(broadcaster_a, 3, 0);
+
+    const auto delivered = listener_a->wait(2, 1s) && listener_b->wait(1, 1s);
+    std::this_thread::sleep_for(20ms);
+
+    if (!delivered || listener_a->ids() != std::vector<int> { 1, 3 }
+        || listener_b->ids() != std::vector<int> { 2 } || dedup->get_stats().duplicates != 1) {
+        log::error("FAIL: frames weren't delivered on the module that heard them first");
+        return -1;
+    }
+
+    log::info("[Listener Channel Test] [modules] PASSED");
+    return 0;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+    int rc = 0;
+
+    rc += test_queue();
+    rc += test_slow_listener();
+    rc += test_policies();
+    rc += test_modules();
+
+    return rc;
+}
@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "kaonic/comm/mesh/radio_network.hpp"
+#include "kaonic/comm/radio/sim_radio.hpp"
+#include "kaonic/common/logging.hpp"
+
+using namespace kaonic;
+using namespace std::chrono_literals;
+
+using bench_clock = std::chrono::steady_clock;
+
+constexpr static uint32_t bench_magic = 0x4B4D4253;
+
+struct bench_header final {
+    uint32_t magic;
+    uint32_t node;
+    uint64_t seq;
+    int64_t timestamp_ns;
+};
+
+struct bench_config final {
+    size_t nodes = 2;
+    std::chrono::milliseconds slot_duration = 15ms;
+    std::chrono::milliseconds gap_duration = 2ms;
+    std::chrono::milliseconds beacon_interval = 500ms;
+    std::chrono::milliseconds duration = 10s;
+    std::chrono::milliseconds tx_interval = 20ms;
+    size_t frame_size = 128;
+    double loss_rate = 0.0;
+    std::chrono::microseconds propagation_delay { 0 };
+    uint32_t mcs = 6;
+    uint32_t opt = 0;
+};
+
+struct bench_sweep final {
+    std::vector<size_t> nodes { 2 };
+    std::vector<size_t> slot_duration { 15 };
+    std::vector<size_t> gap_duration { 2 };
+    std::vector<size_t> beacon_interval { 500 };
+};
+
+class bench_receiver final : public comm::mesh::network_receiver {
+
+public:
+    explicit bench_receiver() noexcept = default;
+    ~bench_receiver() final = default;
+
+    auto on_receive(const comm::mesh::frame_view& frame) -> void final {
+        if (frame.buffer.size() < sizeof(bench_header)) {
+            return;
+        }
+
+        bench_header header;
+        memcpy(&header, frame.buffer.data(), sizeof(header));
+
+        if (header.magic != bench_magic) {
+            return;
+        }
+
+        const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             bench_clock::now().time_since_epoch())
+                             .count();
+
+        std::lock_guard lock { _mut };
+        _latencies.push_back(now - header.timestamp_ns);
+        _bytes += frame.buffer.size();
+    }
+
+    auto collect(std::vector<int64_t>& latencies, size_t& bytes) -> void {
+        std::lock_guard lock { _mut };
+        latencies.insert(latencies.end(), _latencies.begin(), _latencies.end());
+        bytes += _bytes;
+    }
+
+private:
+    std::vector<int64_t> _latencies;
+    size_t _bytes = 0;
+
+    std::mutex _mut;
+};
+
+struct bench_node final {
+    std::shared_ptr<comm::sim_radio> radio;
+    std::shared_ptr<bench_receiver> receiver;
+    std::unique_ptr<comm::mesh::radio_network> network;
+    std::thread sender;
+    size_t sent = 0;
+};
+
+static auto percentile(const std::vector<int64_t>& sorted, double p) -> double {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+
+    const auto index = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+    return static_cast<double>(sorted[index]) / 1e6;
+}
+
+static auto run_bench(const bench_config& config) -> int {
+
+    log::info("[Mesh Bench] nodes={} slot={}ms gap={}ms beacon={}ms frame={}B interval={}ms",
+              config.nodes,
+              config.slot_duration.count(),
+              config.gap_duration.count(),
+              config.beacon_interval.count(),
+              config.frame_size,
+              config.tx_interval.count());
+
+    const auto medium = std::make_shared<comm::sim_medium>(comm::sim_medium_config {
+        .default_link =
+            {
+                .loss_rate = config.loss_rate,
+                .propagation_delay = config.propagation_delay,
+            },
+    });
+
+    const comm::mesh::config mesh_config {
+        .packet_pattern = 0xB1EE,
+        .slot_duration = config.slot_duration,
+        .gap_duration = config.gap_duration,
+        .beacon_interval = config.beacon_interval,
+        // Every other node of the bench is in range
+        .peer_capacity = config.nodes,
+    };
+
+    const comm::radio_config radio_config {
+        .phy_config =
+            comm::radio_phy_config_ofdm {
+                .mcs = config.mcs,
+                .opt = config.opt,
+            },
+    };
+
+    std::vector<bench_node> nodes(config.nodes);
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        auto& node = nodes[i];
+
+        node.radio = std::make_shared<comm::sim_radio>(
+            comm::sim_radio_config { .name = "node-" + std::to_string(i) }, medium);
+        node.receiver = std::make_shared<bench_receiver>();
+
+        if (auto err = node.radio->configure(radio_config); !err.is_ok()) {
+            log::error("[Mesh Bench] unable to configure node {}", i);
+            return -1;
+        }
+
+        node.network =
+            std::make_unique<comm::mesh::radio_network>(mesh_config, node.radio, node.receiver);
+
+        if (auto err = node.network->start(); !err.is_ok()) {
+            log::error("[Mesh Bench] unable to start node {}", i);
+            return -1;
+        }
+    }
+
+    std::atomic_bool running { true };
+
+    const auto start_time = bench_clock::now();
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        auto& node = nodes[i];
+
+        node.sender = std::thread([&config, &node, &running, i] {
+            std::vector<uint8_t> payload(std::max(config.frame_size, sizeof(bench_header)));
+
+            while (running) {
+                const bench_header header {
+                    .magic = bench_magic,
+                    .node = static_cast<uint32_t>(i),
+                    .seq = node.sent,
+                    .timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                        bench_clock::now().time_since_epoch())
+                                        .count(),
+                };
+                memcpy(payload.data(), &header, sizeof(header));
+
+                if (node.network->transmit(comm::mesh::frame_view { payload }).is_ok()) {
+                    ++node.sent;
+                }
+
+                std::this_thread::sleep_for(config.tx_interval);
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(config.duration);
+    running = false;
+
+    for (auto& node : nodes) {
+        if (node.sender.joinable()) {
+            node.sender.join();
+        }
+    }
+
+    // Let in-flight frames reach receivers
+    std::this_thread::sleep_for(config.slot_duration * 4);
+
+    const auto elapsed = std::chrono::duration<double>(bench_clock::now() - start_time).count();
+
+    std::vector<int64_t> latencies;
+    size_t rx_bytes = 0;
+    size_t tx_frames = 0;
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        auto& node = nodes[i];
+
+        const auto stats = node.network->get_stats();
+        log::info("[Mesh Bench]   node {:>2}: sent={:>6} tx={:>6} rx={:>6} tx_speed={:>8} "
+                  "rx_speed={:>8}",
+                  i,
+                  node.sent,
+                  stats.tx_counter,
+                  stats.rx_counter,
+                  stats.tx_speed,
+                  stats.rx_speed);
+
+        node.receiver->collect(latencies, rx_bytes);
+        tx_frames += node.sent;
+
+        auto err = node.network->stop();
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    const auto medium_stats = medium->get_stats();
+    const auto expected = tx_frames * (nodes.size() - 1);
+
+    log::info("[Mesh Bench] goodput={:.2f}kbit/s delivered={}/{} ({:.1f}%) "
+              "utilisation={:.1f}% collisions={}",
+              (rx_bytes * 8.0) / elapsed / 1000.0,
+              latencies.size(),
+              expected,
+              expected ? (latencies.size() * 100.0) / expected : 0.0,
+              (std::chrono::duration<double>(medium_stats.busy_time).count() * 100.0) / elapsed,
+              medium_stats.collisions);
+
+    log::info("[Mesh Bench] latency p50={:.2f}ms p90={:.2f}ms p99={:.2f}ms max={:.2f}ms",
+              percentile(latencies, 0.50),
+              percentile(latencies, 0.90),
+              percentile(latencies, 0.99),
+              percentile(latencies, 1.00));
+
+    return 0;
+}
+
+static auto parse_list(std::string_view value) -> std::vector<size_t> {
+    std::vector<size_t> list;
+
+    while (!value.empty()) {
+        const auto pos = value.find(',');
+        list.push_back(std::strtoul(std::string { value.substr(0, pos) }.c_str(), nullptr, 10));
+
+        if (pos == std::string_view::npos) {
+            break;
+        }
+        value.remove_prefix(pos + 1);
+    }
+
+    return list;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+
+    log::set_level(log::level::info);
+
+    bench_config config;
+    bench_sweep sweep;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg { argv[i] };
+
+        const auto pos = arg.find('=');
+        const auto key = arg.substr(0, pos);
+        const auto value = pos == std::string_view::npos ? std::string_view {} : arg.substr(pos + 1);
+
+        if (key == "--nodes") {
+            sweep.nodes = parse_list(value);
+        } else if (key == "--slot") {
+            sweep.slot_duration = parse_list(value);
+        } else if (key == "--gap") {
+            sweep.gap_duration = parse_list(value);
+        } else if (key == "--beacon") {
+            sweep.beacon_interval = parse_list(value);
+        } else if (key == "--duration") {
+            config.duration = std::chrono::seconds { std::atoi(value.data()) };
+        } else if (key == "--interval") {
+            config.tx_interval = std::chrono::milliseconds { std::atoi(value.data()) };
+        } else if (key == "--size") {
+            config.frame_size = std::strtoul(value.data(), nullptr, 10);
+        } else if (key == "--loss") {
+            config.loss_rate = std::atof(value.data());
+        } else if (key == "--delay") {
+            config.propagation_delay = std::chrono::microseconds { std::atoi(value.data()) };
+        } else if (key == "--mcs") {
+            config.mcs = std::strtoul(value.data(), nullptr, 10);
+        } else if (key == "--opt") {
+            config.opt = std::strtoul(value.data(), nullptr, 10);
+        } else {
+            log::error("[Mesh Bench] unknown argument '{}'", arg);
+            log::info("usage: mesh_bench [--nodes=2,8,64] [--slot=15] [--gap=2] [--beacon=500] "
+                      "[--duration=10] [--interval=20] [--size=128] [--loss=0.0] [--delay=0] "
+                      "[--mcs=6] [--opt=0]");
+            return -1;
+        }
+    }
+
+    int rc = 0;
+
+    // Every combination of the swept parameters is a separate run
+    for (const auto nodes : sweep.nodes) {
+        for (const auto slot : sweep.slot_duration) {
+            for (const auto gap : sweep.gap_duration) {
+                for (const auto beacon : sweep.beacon_interval) {
+                    config.nodes = std::clamp<size_t>(nodes, 2, 64);
+                    config.slot_duration = std::chrono::milliseconds { slot };
+                    config.gap_duration = std::chrono::milliseconds { gap };
+                    config.beacon_interval = std::chrono::milliseconds { beacon };
+
+                    rc += run_bench(config);
+                }
+            }
+        }
+    }
+
+    return rc;
+}
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "kaonic/comm/mesh/radio_network.hpp"
+#include "kaonic/comm/radio/sim_radio.hpp"
+#include "kaonic/common/logging.hpp"
+
+using namespace kaonic;
+using namespace std::chrono_literals;
+
+using comm::mesh::frame_view;
+
+class null_receiver final : public comm::mesh::network_receiver {
+
+public:
+    auto on_receive(const frame_view& frame) -> void final {}
+};
+
+static const comm::mesh::config mesh_config {
+    .packet_pattern = 0xB1EE,
+    .slot_duration = 15ms,
+    .gap_duration = 2ms,
+    .beacon_interval = 500ms,
+};
+
+// Commands are run by the caller when no update loop owns the network
+static auto test_stopped() -> int {
+    log::info("[Mesh Commands Test] Stopped network test");
+
+    const auto medium = std::make_shared<comm::sim_medium>();
+    const auto radio =
+        std::make_shared<comm::sim_radio>(comm::sim_radio_config { .name = "a" }, medium);
+
+    auto err = radio->configure(comm::radio_config {});
+
+    comm::mesh::network network {
+        mesh_config,
+        comm::mesh::context {
+            std::make_shared<comm::mesh::radio_network_interface>(radio),
+            std::make_shared<null_receiver>(),
+        },
+    };
+
+    const auto stats = network.get_stats();
+    const auto routes = network.get_routes();
+    const auto answer = network.execute([] { return 42; });
+
+    // Loop owns it until it's released, queries wait for its next update
+    for (int i = 0; i < 10; ++i) {
+        network.update();
+    }
+
+    auto query = std::async(std::launch::async, [&network] { return network.get_stats(); });
+    if (query.wait_for(50ms) != std::future_status::timeout) {
+        log::error("FAIL: query didn't wait for the update thread");
+        return -1;
+    }
+
+    network.update();
+    query.get();
+
+    network.release();
+    const auto released = network.execute([] { return std::this_thread::get_id(); });
+
+    if (!err.is_ok() || stats.tx_counter != 0 || !routes.empty() || answer != 42
+        || released != std::this_thread::get_id()) {
+        log::error("FAIL: commands didn't run without an update loop");
+        return -1;
+    }
+
+    log::info("[Mesh Commands Test] [stopped] PASSED");
+    return 0;
+}
+
+// Queries and reconfiguration from other threads while senders keep the queue busy
+static auto test_running() -> int {
+    log::info("[Mesh Commands Test] Running network test");
+
+    constexpr size_t senders = 4;
+    constexpr size_t frames = 25;
+    constexpr size_t queries = 500;
+
+    const auto medium =
+        std::make_shared<comm::sim_medium>(comm::sim_medium_config { .collisions = false });
+
+    const auto radio_a =
+        std::make_shared<comm::sim_radio>(comm::sim_radio_config { .name = "a" }, medium);
+    const auto radio_b =
+        std::make_shared<comm::sim_radio>(comm::sim_radio_config { .name = "b" }, medium);
+
+    auto err = radio_a->configure(comm::radio_config {});
+    err += radio_b->configure(comm::radio_config {});
+
+    comm::mesh::radio_network network_a { mesh_config, radio_a, std::make_shared<null_receiver>() };
+    comm::mesh::radio_network network_b { mesh_config, radio_b, std::make_shared<null_receiver>() };
+
+    err += network_a.start();
+    err += network_b.start();
+
+    std::atomic<size_t> sent { 0 };
+    std::atomic<size_t> callback_queries { 0 };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < senders; ++i) {
+        threads.emplace_back([&, i] {
+            std::vector<uint8_t> payload(256, static_cast<uint8_t>(i));
+
+            for (size_t n = 0; n < frames; ++n) {
+                if (n % 2) {
+                    sent += network_a.transmit(frame_view { payload }).is_ok() ? 1 : 0;
+                    continue;
+                }
+
+                // Query from the update thread itself is run right away
+                auto async_err = network_a.transmit_async(frame_view { payload },
+                                                          [&](const comm::mesh::tx_result&) {
+                                                              if (network_a.get_routes().empty()) {
+                                                                  ++callback_queries;
+                                                              }
+                                                          });
+                sent += async_err.is_ok() ? 1 : 0;
+                std::this_thread::sleep_for(1ms);
+            }
+        });
+    }
+
+    std::vector<std::chrono::nanoseconds> latencies;
+    size_t tx_counter = 0;
+
+    for (size_t i = 0; i < queries; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        tx_counter = std::max(tx_counter, network_a.get_stats().tx_counter);
+        latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start));
+
+        if (i % 100 == 0) {
+            err += network_a.configure(comm::radio_config {});
+        }
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::this_thread::sleep_for(100ms);
+
+    err += network_a.stop();
+    err += network_b.stop();
+
+    // Taken by the caller once the loop is gone
+    const auto stats = network_a.get_stats();
+
+    std::sort(latencies.begin(), latencies.end());
+
+    log::info("[Mesh Commands Test] {} frames sent, {} sent by rfnet, query p50={}ns p99={}ns "
+              "max={}ns",
+              sent.load(),
+              stats.tx_counter,
+              latencies[latencies.size() / 2].count(),
+              latencies[latencies.size() * 99 / 100].count(),
+              latencies.back().count());
+
+    if (!err.is_ok() || sent != senders * frames
+        || stats.tx_counter < std::max(sent.load(), tx_counter)) {
+        log::error("FAIL: frames weren't sent");
+        return -1;
+    }
+
+    if (callback_queries == 0) {
+        log::error("FAIL: query from a callback didn't complete");
+        return -1;
+    }
+
+    log::info("[Mesh Commands Test] [running] PASSED");
+    return 0;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+    int rc = 0;
+
+    rc += test_stopped();
+    rc += test_running();
+
+    return rc;
+}
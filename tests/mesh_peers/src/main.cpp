@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "kaonic/comm/mesh/radio_network.hpp"
+#include "kaonic/common/logging.hpp"
+
+using namespace kaonic;
+using namespace std::chrono_literals;
+
+using bench_clock = std::chrono::steady_clock;
+
+struct peers_bench_config final {
+    size_t peers = 16;
+    size_t capacity = 16;
+    size_t rounds = 5;
+    std::chrono::milliseconds beacon_interval = 20ms;
+};
+
+// Frames sent by the beaconing nodes, only the listener reads them
+struct beacon_air final {
+    std::mutex mut;
+    std::deque<std::vector<uint8_t>> frames;
+};
+
+class beacon_radio final : public comm::radio {
+
+public:
+    explicit beacon_radio(const std::shared_ptr<beacon_air>& air, bool listener) noexcept
+        : _air { air }
+        , _listener { listener } {}
+    ~beacon_radio() final = default;
+
+    auto configure(const comm::radio_config& config) -> error final { return error::ok(); }
+
+    auto transmit(span<const uint8_t> data) -> error final {
+        // Nobody listens to the listener
+        if (_listener) {
+            return error::ok();
+        }
+
+        std::lock_guard lock { _air->mut };
+        _air->frames.emplace_back(data.begin(), data.end());
+
+        return error::ok();
+    }
+
+    auto receive(span<uint8_t> buffer,
+                 size_t& len,
+                 comm::radio_rx_info& info,
+                 const std::chrono::milliseconds& timeout) -> error final {
+        if (!_listener) {
+            return error::timeout();
+        }
+
+        std::lock_guard lock { _air->mut };
+        if (_air->frames.empty()) {
+            return error::timeout();
+        }
+
+        const auto& frame = _air->frames.front();
+        len = std::min(frame.size(), buffer.size());
+        std::copy(frame.begin(), frame.begin() + len, buffer.begin());
+        _air->frames.pop_front();
+
+        info.rssi = -60;
+
+        return error::ok();
+    }
+
+    [[nodiscard]] auto pending() const -> size_t {
+        std::lock_guard lock { _air->mut };
+        return _air->frames.size();
+    }
+
+private:
+    const std::shared_ptr<beacon_air> _air;
+    const bool _listener;
+};
+
+class null_receiver final : public comm::mesh::network_receiver {
+
+public:
+    auto on_receive(const comm::mesh::frame_view& frame) -> void final {}
+};
+
+static auto make_network(const comm::mesh::config& config,
+                         const std::shared_ptr<comm::radio>& radio,
+                         const std::shared_ptr<comm::mesh::network_receiver>& receiver,
+                         const std::shared_ptr<comm::mesh::frame_pool>& pool)
+    -> std::unique_ptr<comm::mesh::network> {
+    return std::make_unique<comm::mesh::network>(
+        config,
+        comm::mesh::context {
+            std::make_shared<comm::mesh::radio_network_interface>(radio),
+            receiver,
+            {},
+            pool,
+        });
+}
+
+static auto percentile(const std::vector<int64_t>& sorted, double p) -> int64_t {
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+}
+
+// Updates run on this thread only: every beaconing node sends its beacon, then the listener
+// takes them in one update each. Time of those updates is rfnet's beacon processing and peer
+// lookup in storage of the given capacity.
+static auto run_bench(const peers_bench_config& config) -> int {
+
+    const auto air = std::make_shared<beacon_air>();
+    const auto receiver = std::make_shared<null_receiver>();
+    const auto pool = std::make_shared<comm::mesh::frame_pool>(16);
+
+    comm::mesh::config mesh_config {
+        .packet_pattern = 0xB1EE,
+        .slot_duration = 15ms,
+        .gap_duration = 2ms,
+        .beacon_interval = config.beacon_interval,
+        .peer_capacity = config.peers,
+    };
+
+    // Nodes without an OTP id warn about it, once for each of them
+    log::set_level(log::level::err);
+
+    std::vector<std::unique_ptr<comm::mesh::network>> nodes;
+    nodes.reserve(config.peers);
+    for (size_t i = 0; i < config.peers; ++i) {
+        nodes.push_back(
+            make_network(mesh_config, std::make_shared<beacon_radio>(air, false), receiver, pool));
+    }
+
+    mesh_config.peer_capacity = config.capacity;
+
+    const auto listener_radio = std::make_shared<beacon_radio>(air, true);
+    const auto listener = make_network(mesh_config, listener_radio, receiver, pool);
+
+    log::set_level(log::level::info);
+
+    std::vector<int64_t> samples;
+    samples.reserve(config.peers * config.rounds);
+
+    size_t sent = 0;
+    for (size_t round = 0; round < config.rounds; ++round) {
+        const auto next_round = bench_clock::now() + config.beacon_interval;
+
+        for (auto& node : nodes) {
+            node->update();
+        }
+
+        sent += listener_radio->pending();
+
+        while (listener_radio->pending() > 0) {
+            const auto start = bench_clock::now();
+            const auto received = listener->update();
+            const auto elapsed = bench_clock::now() - start;
+
+            if (received) {
+                samples.push_back(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+            }
+        }
+
+        std::this_thread::sleep_until(next_round);
+    }
+
+    if (samples.empty()) {
+        log::error("[Mesh Peers] no beacon was processed");
+        return -1;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    const auto mean = std::accumulate(samples.begin(), samples.end(), int64_t { 0 })
+                    / static_cast<int64_t>(samples.size());
+
+    log::info("[Mesh Peers] peers={:5} storage={:5}: {} beacons, per beacon mean={}ns "
+              "p50={}ns p99={}ns",
+              config.peers,
+              config.capacity,
+              sent,
+              mean,
+              percentile(samples, 0.5),
+              percentile(samples, 0.99));
+
+    return 0;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+
+    log::set_level(log::level::info);
+
+    std::vector<size_t> peer_counts { 16, 128, 1024 };
+    peers_bench_config config;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg { argv[i] };
+
+        const auto pos = arg.find('=');
+        const auto key = arg.substr(0, pos);
+        const auto value = pos == std::string_view::npos ? std::string_view {} : arg.substr(pos + 1);
+
+        if (key == "--peers") {
+            peer_counts = { std::strtoul(std::string { value }.c_str(), nullptr, 10) };
+        } else if (key == "--rounds") {
+            config.rounds = std::strtoul(std::string { value }.c_str(), nullptr, 10);
+        } else {
+            log::error("[Mesh Peers] unknown argument '{}'", arg);
+            log::info("usage: mesh_peers [--peers=1024] [--rounds=5]");
+            return -1;
+        }
+    }
+
+    int rc = 0;
+
+    // Fixed 16-entry storage the daemon used to hand rfnet, then storage sized to the peers
+    for (const auto peers : peer_counts) {
+        config.peers = std::max<size_t>(peers, 1);
+
+        for (const auto capacity : { size_t { 16 }, config.peers }) {
+            config.capacity = capacity;
+            rc += run_bench(config);
+
+            if (capacity == config.peers) {
+                break;
+            }
+        }
+    }
+
+    return rc;
+}
@@ -0,0 +1,216 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "kaonic/comm/mesh/radio_network.hpp"
+#include "kaonic/comm/mesh/router.hpp"
+#include "kaonic/comm/radio/sim_radio.hpp"
+#include "kaonic/common/logging.hpp"
+
+using namespace kaonic;
+using namespace std::chrono_literals;
+
+using comm::mesh::route_action;
+using comm::mesh::router;
+
+class source_receiver final : public comm::mesh::network_receiver {
+
+public:
+    explicit source_receiver() noexcept = default;
+    ~source_receiver() final = default;
+
+    auto on_receive(const comm::mesh::frame_view& frame) -> void final {
+        std::lock_guard lock { _mut };
+        _sources.push_back(frame.info.source);
+    }
+
+    [[nodiscard]] auto sources() -> std::vector<uint64_t> {
+        std::lock_guard lock { _mut };
+        return _sources;
+    }
+
+private:
+    std::vector<uint64_t> _sources;
+    std::mutex _mut;
+};
+
+// Hands an advertisement of 'from' to 'to'
+static auto exchange_hello(router& from, router& to, router::clock::time_point now) -> bool {
+    std::vector<uint8_t> hello;
+    std::vector<uint8_t> forward;
+
+    if (!from.make_hello(now, hello)) {
+        return false;
+    }
+
+    comm::mesh::frame_info info { .rssi = -60 };
+    span<const uint8_t> payload;
+
+    return to.receive(hello, info, payload, forward, now) == route_action::hello;
+}
+
+static auto test_relay() -> int {
+    log::info("[Mesh Routing Test] Relay test");
+
+    const comm::mesh::routing_config config { .enabled = true, .hello_interval = 0ms };
+
+    // a <-> b <-> c, a and c don't hear each other
+    router a { config, 0xA0 };
+    router b { config, 0xB0 };
+    router c { config, 0xC0 };
+
+    const auto now = router::clock::now();
+
+    if (!exchange_hello(a, b, now) || !exchange_hello(b, c, now) || !exchange_hello(c, b, now)
+        || !exchange_hello(b, a, now)) {
+        log::error("FAIL: advertisements weren't handled");
+        return -1;
+    }
+
+    const auto route = c.find(0xA0);
+    if (!route || route->next_hop != 0xB0 || route->hops != 2) {
+        log::error("FAIL: c has no route to a through b");
+        return -1;
+    }
+
+    const std::vector<uint8_t> data { 1, 2, 3, 4 };
+
+    std::vector<uint8_t> frame(router::header_size);
+    if (!c.encode(0xA0, frame).is_ok()) {
+        log::error("FAIL: frame to a wasn't encoded");
+        return -1;
+    }
+    frame.insert(frame.end(), data.begin(), data.end());
+
+    std::vector<uint8_t> forward;
+    span<const uint8_t> payload;
+    comm::mesh::frame_info info;
+
+    if (b.receive(frame, info, payload, forward, now) != route_action::forward) {
+        log::error("FAIL: b didn't relay the frame");
+        return -1;
+    }
+
+    // Only the named next hop takes a unicast frame
+    comm::mesh::frame_info overheard;
+    std::vector<uint8_t> ignored;
+    if (c.receive(forward, overheard, payload, ignored, now) != route_action::drop) {
+        log::error("FAIL: relayed frame was taken by another node");
+        return -1;
+    }
+
+    if (a.receive(forward, info, payload, ignored, now) != route_action::deliver
+        || info.source != 0xC0 || std::vector<uint8_t>(payload.begin(), payload.end()) != data) {
+        log::error("FAIL: a didn't get the payload from c");
+        return -1;
+    }
+
+    if (a.encode(0xD0, frame).code != error_code::not_ready) {
+        log::error("FAIL: frame to an unknown node was encoded");
+        return -1;
+    }
+
+    log::info("[Mesh Routing Test] [relay] PASSED");
+    return 0;
+}
+
+static auto test_line_network() -> int {
+    log::info("[Mesh Routing Test] Line network test");
+
+    // Routing is under test, not channel access
+    const auto medium =
+        std::make_shared<comm::sim_medium>(comm::sim_medium_config { .collisions = false });
+
+    const comm::mesh::config mesh_config {
+        .packet_pattern = 0xB1EE,
+        .slot_duration = 15ms,
+        .gap_duration = 2ms,
+        .beacon_interval = 500ms,
+        .routing = { .enabled = true, .hello_interval = 50ms },
+    };
+
+    std::vector<std::shared_ptr<comm::sim_radio>> radios;
+    std::vector<std::shared_ptr<source_receiver>> receivers;
+    std::vector<std::unique_ptr<comm::mesh::radio_network>> networks;
+
+    for (const auto name : { "a", "b", "c" }) {
+        const auto radio =
+            std::make_shared<comm::sim_radio>(comm::sim_radio_config { .name = name }, medium);
+        if (!radio->configure(comm::radio_config {}).is_ok()) {
+            log::error("FAIL: configure");
+            return -1;
+        }
+
+        radios.push_back(radio);
+        receivers.push_back(std::make_shared<source_receiver>());
+        networks.push_back(
+            std::make_unique<comm::mesh::radio_network>(mesh_config, radio, receivers.back()));
+    }
+
+    medium->set_link(*radios[0], *radios[2], comm::sim_link { .loss_rate = 1.0 });
+    medium->set_link(*radios[2], *radios[0], comm::sim_link { .loss_rate = 1.0 });
+
+    for (auto& network : networks) {
+        if (!network->start().is_ok()) {
+            log::error("FAIL: start");
+            return -1;
+        }
+    }
+
+    const auto a_id = networks[0]->node_id();
+    const auto c_id = networks[2]->node_id();
+
+    const auto has_route = [&] {
+        for (const auto& route : networks[0]->get_routes()) {
+            if (route.destination == c_id) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    const auto deadline = std::chrono::steady_clock::now() + 3s;
+    while (!has_route() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+
+    const std::vector<uint8_t> data(64, 0xC3);
+    comm::mesh::frame_view frame { data };
+    frame.info.destination = c_id;
+
+    auto err = networks[0]->transmit(frame);
+
+    std::vector<uint64_t> sources;
+    while (sources.empty() && std::chrono::steady_clock::now() < deadline + 1s) {
+        std::this_thread::sleep_for(10ms);
+        sources = receivers[2]->sources();
+    }
+
+    for (auto& network : networks) {
+        err += network->stop();
+    }
+
+    if (!has_route() || !err.is_ok()) {
+        log::error("FAIL: a has no route to c");
+        return -1;
+    }
+
+    if (sources.size() != 1 || sources.front() != a_id) {
+        log::error("FAIL: c didn't get the frame of a");
+        return -1;
+    }
+
+    log::info("[Mesh Routing Test] [line network] PASSED");
+    return 0;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+    int rc = 0;
+
+    rc += test_relay();
+    rc += test_line_network();
+
+    return rc;
+}
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "kaonic/comm/mesh/radio_network.hpp"
+#include "kaonic/comm/radio/sim_radio.hpp"
+#include "kaonic/common/logging.hpp"
+
+using namespace kaonic;
+using namespace std::chrono_literals;
+
+struct sched_bench_config final {
+    std::chrono::milliseconds idle_duration = 2s;
+    std::chrono::milliseconds stall_duration = 1s;
+    size_t frames = 200;
+    size_t frame_size = 128;
+};
+
+class null_receiver final : public comm::mesh::network_receiver {
+
+public:
+    explicit null_receiver() noexcept = default;
+    ~null_receiver() final = default;
+
+    auto on_receive(const comm::mesh::frame_view& frame) -> void final { ++_frames; }
+
+    [[nodiscard]] auto frames() const noexcept -> size_t { return _frames; }
+
+private:
+    std::atomic<size_t> _frames { 0 };
+};
+
+// Records how late every transmission starts after the millisecond of rfnet's clock it's due.
+// Receiving can be held off, the way rfnet leaves the radio alone outside of its RX state.
+class timing_radio final : public comm::radio {
+
+public:
+    explicit timing_radio(const std::shared_ptr<comm::radio>& radio) noexcept
+        : _radio { radio } {}
+    ~timing_radio() final = default;
+
+    auto configure(const comm::radio_config& config) -> error final {
+        return _radio->configure(config);
+    }
+
+    auto transmit(span<const uint8_t> data) -> error final {
+        const auto now = comm::mesh::network::clock::now().time_since_epoch();
+        const auto lateness = now - std::chrono::floor<std::chrono::milliseconds>(now);
+
+        {
+            std::lock_guard lock { _mut };
+            _lateness.push_back(
+                std::chrono::duration_cast<std::chrono::microseconds>(lateness).count());
+        }
+
+        return _radio->transmit(data);
+    }
+
+    auto receive(span<uint8_t> buffer,
+                 size_t& len,
+                 comm::radio_rx_info& info,
+                 const std::chrono::milliseconds& timeout) -> error final {
+        if (_rx_held) {
+            return error::timeout();
+        }
+
+        return _radio->receive(buffer, len, info, timeout);
+    }
+
+    auto rx_event_fd() const noexcept -> int final { return _radio->rx_event_fd(); }
+
+    auto hold_rx(bool hold) noexcept -> void { _rx_held = hold; }
+
+    [[nodiscard]] auto take_lateness() -> std::vector<int64_t> {
+        std::lock_guard lock { _mut };
+        return std::move(_lateness);
+    }
+
+private:
+    const std::shared_ptr<comm::radio> _radio;
+
+    std::atomic_bool _rx_held { false };
+
+    std::vector<int64_t> _lateness;
+    std::mutex _mut;
+};
+
+static auto cpu_time() -> std::chrono::nanoseconds {
+    timespec ts {};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return std::chrono::seconds { ts.tv_sec } + std::chrono::nanoseconds { ts.tv_nsec };
+}
+
+static auto cpu_load(std::chrono::nanoseconds cpu, std::chrono::milliseconds duration) -> double {
+    return 100.0 * std::chrono::duration<double>(cpu).count()
+         / std::chrono::duration<double>(duration).count();
+}
+
+static auto percentile(const std::vector<int64_t>& sorted, double p) -> int64_t {
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+}
+
+static auto run_bench(const sched_bench_config& config) -> int {
+
+    log::info("[Mesh Sched] idle={}ms frames={} size={}B",
+              config.idle_duration.count(),
+              config.frames,
+              config.frame_size);
+
+    const auto medium = std::make_shared<comm::sim_medium>();
+
+    const comm::mesh::config mesh_config {
+        .packet_pattern = 0x5C4E,
+        .slot_duration = 15ms,
+        .gap_duration = 2ms,
+        .beacon_interval = 500ms,
+    };
+
+    const auto radio_a = std::make_shared<timing_radio>(std::make_shared<comm::sim_radio>(
+        comm::sim_radio_config { .name = "a" }, medium));
+    const auto radio_b = std::make_shared<timing_radio>(std::make_shared<comm::sim_radio>(
+        comm::sim_radio_config { .name = "b" }, medium));
+
+    auto err = radio_a->configure(comm::radio_config {});
+    err += radio_b->configure(comm::radio_config {});
+
+    const auto receiver_a = std::make_shared<null_receiver>();
+    const auto receiver_b = std::make_shared<null_receiver>();
+
+    comm::mesh::radio_network network_a { mesh_config, radio_a, receiver_a };
+    comm::mesh::radio_network network_b { mesh_config, radio_b, receiver_b };
+
+    err += network_a.start();
+    err += network_b.start();
+
+    if (!err.is_ok()) {
+        log::error("[Mesh Sched] unable to start networks");
+        return -1;
+    }
+
+    // Two update loops with nothing to send but beacons
+    const auto cpu_start = cpu_time();
+    std::this_thread::sleep_for(config.idle_duration);
+    const auto idle_load = cpu_load(cpu_time() - cpu_start, config.idle_duration);
+
+    log::info("[Mesh Sched] idle cpu: {:.1f}% of one core for 2 nodes", idle_load);
+
+    // A frame waits in b's radio while its RX event stays set
+    std::vector<uint8_t> payload(config.frame_size, 0x5A);
+
+    const auto before_stall = receiver_b->frames();
+
+    radio_b->hold_rx(true);
+    err += network_a.transmit(comm::mesh::frame_view { payload });
+
+    const auto stall_start = cpu_time();
+    std::this_thread::sleep_for(config.stall_duration);
+    const auto stall_load = cpu_load(cpu_time() - stall_start, config.stall_duration);
+
+    radio_b->hold_rx(false);
+
+    const auto stall_deadline = std::chrono::steady_clock::now() + 1s;
+    while (receiver_b->frames() == before_stall
+           && std::chrono::steady_clock::now() < stall_deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    log::info("[Mesh Sched] cpu with a frame left in the radio: {:.1f}% of one core", stall_load);
+
+    (void)radio_a->take_lateness();
+
+    const auto delivered = receiver_b->frames();
+
+    size_t sent = 0;
+    for (size_t i = 0; i < config.frames; ++i) {
+        if (network_a.transmit(comm::mesh::frame_view { payload }).is_ok()) {
+            ++sent;
+        }
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + 2s;
+    while (receiver_b->frames() < delivered + sent
+           && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+
+    err += network_a.stop();
+    err += network_b.stop();
+
+    auto lateness = radio_a->take_lateness();
+    std::sort(lateness.begin(), lateness.end());
+
+    if (lateness.empty()) {
+        log::error("[Mesh Sched] nothing was transmitted");
+        return -1;
+    }
+
+    log::info("[Mesh Sched] delivered {}/{} frames", receiver_b->frames() - delivered, sent);
+    log::info("[Mesh Sched] tx start after tick: p50={}us p99={}us max={}us",
+              percentile(lateness, 0.5),
+              percentile(lateness, 0.99),
+              lateness.back());
+
+    return 0;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+
+    log::set_level(log::level::info);
+
+    sched_bench_config config;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg { argv[i] };
+
+        const auto pos = arg.find('=');
+        const auto key = arg.substr(0, pos);
+        const auto value = pos == std::string_view::npos ? std::string_view {} : arg.substr(pos + 1);
+
+        if (key == "--idle") {
+            config.idle_duration =
+                std::chrono::milliseconds { std::strtoul(value.data(), nullptr, 10) };
+        } else if (key == "--stall") {
+            config.stall_duration =
+                std::chrono::milliseconds { std::strtoul(value.data(), nullptr, 10) };
+        } else if (key == "--frames") {
+            config.frames = std::strtoul(value.data(), nullptr, 10);
+        } else if (key == "--size") {
+            config.frame_size = std::strtoul(value.data(), nullptr, 10);
+        } else {
+            log::error("[Mesh Sched] unknown argument '{}'", arg);
+            log::info(
+                "usage: mesh_sched [--idle=2000] [--stall=1000] [--frames=200] [--size=128]");
+            return -1;
+        }
+    }
+
+    return run_bench(config);
+}
@@ -0,0 +1,154 @@
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "kaonic/comm/services/radio_frame.hpp"
+#include "kaonic/common/logging.hpp"
+
+using namespace kaonic;
+using namespace std::chrono_literals;
+
+using comm::radio_frame_pack;
+using comm::radio_frame_view;
+
+static auto make_payload(size_t size, uint32_t seed) -> std::vector<uint8_t> {
+    std::mt19937 random { seed };
+    std::vector<uint8_t> payload(size);
+
+    for (auto& byte : payload) {
+        byte = static_cast<uint8_t>(random());
+    }
+
+    return payload;
+}
+
+static auto same_payload(const comm::mesh::frame_view& view, const std::vector<uint8_t>& payload)
+    -> bool {
+    return view.buffer.size() == payload.size()
+        && std::equal(payload.begin(), payload.end(), view.buffer.begin());
+}
+
+// Both encodings give the client back the exact payload, a reused response leaks nothing of the
+// previous frame
+static auto test_round_trip() -> int {
+    log::info("[Radio Frame Test] Round trip test");
+
+    ReceiveResponse sent;
+    ReceiveResponse received;
+    std::string wire;
+
+    for (const auto encoding : { FRAME_ENCODING_WORDS, FRAME_ENCODING_BYTES }) {
+        for (const auto size : { 2047u, 0u, 1u, 3u, 4u, 5u, 255u, 2047u, 6u }) {
+            const auto payload = make_payload(size, size);
+
+            radio_frame_pack(payload, encoding, *sent.mutable_frame());
+
+            if (!sent.SerializeToString(&wire) || !received.ParseFromString(wire)) {
+                log::error("FAIL: response of {}B doesn't serialize", size);
+                return -1;
+            }
+
+            if (!same_payload(radio_frame_view(received.frame()), payload)) {
+                log::error("FAIL: {}B payload changed in encoding {}", size, encoding);
+                return -1;
+            }
+
+            // Padding of the last word is zeroed even when the words held a longer frame
+            const auto& data = received.frame().data();
+            if (encoding == FRAME_ENCODING_WORDS && size % sizeof(uint32_t) != 0
+                && (data[data.size() - 1] >> (8 * (size % sizeof(uint32_t)))) != 0) {
+                log::error("FAIL: padding of a {}B frame isn't zero", size);
+                return -1;
+            }
+        }
+    }
+
+    // Requests of clients that only know words keep working
+    TransmitRequest request;
+    request.mutable_frame()->add_data(0x04030201);
+    request.mutable_frame()->add_data(0x00000005);
+    request.mutable_frame()->set_length(5);
+
+    if (!same_payload(radio_frame_view(request.frame()), { 1, 2, 3, 4, 5 })) {
+        log::error("FAIL: payload of words wasn't read");
+        return -1;
+    }
+
+    log::info("[Radio Frame Test] [round trip] PASSED");
+    return 0;
+}
+
+struct encoding_cost final {
+    size_t wire_size = 0;
+    std::chrono::nanoseconds per_frame { 0 };
+};
+
+// Server packs and serializes the response, the client parses it and reads the payload
+static auto measure(FrameEncoding encoding, const std::vector<uint8_t>& payload)
+    -> encoding_cost {
+    constexpr size_t frames = 20000;
+
+    ReceiveResponse sent;
+    ReceiveResponse received;
+    std::string wire;
+
+    sent.set_module(MODULE_A);
+    sent.set_rssi(-72);
+    sent.set_timestamp(1'000'000'000);
+    sent.set_latency(350);
+
+    size_t checksum = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < frames; ++i) {
+        radio_frame_pack(payload, encoding, *sent.mutable_frame());
+        sent.SerializeToString(&wire);
+
+        received.ParseFromString(wire);
+        checksum += radio_frame_view(received.frame()).buffer.size();
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return encoding_cost {
+        .wire_size = checksum / frames == payload.size() ? wire.size() : 0,
+        .per_frame = elapsed / frames,
+    };
+}
+
+static auto test_cost() -> int {
+    log::info("[Radio Frame Test] Encoding cost test");
+
+    for (const auto size : { 16u, 64u, 256u, 1024u, 2047u }) {
+        const auto payload = make_payload(size, 0xC0DE);
+
+        const auto words = measure(FRAME_ENCODING_WORDS, payload);
+        const auto bytes = measure(FRAME_ENCODING_BYTES, payload);
+
+        log::info("[Radio Frame Test] {:>4}B payload: words {:>4}B {:>5}ns, bytes {:>4}B {:>5}ns",
+                  size,
+                  words.wire_size,
+                  words.per_frame.count(),
+                  bytes.wire_size,
+                  bytes.per_frame.count());
+
+        if (words.wire_size == 0 || bytes.wire_size == 0 || bytes.wire_size >= words.wire_size) {
+            log::error("FAIL: bytes of a {}B payload aren't smaller on the wire", size);
+            return -1;
+        }
+    }
+
+    log::info("[Radio Frame Test] [cost] PASSED");
+    return 0;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+    int rc = 0;
+
+    rc += test_round_trip();
+    rc += test_cost();
+
+    return rc;
+}
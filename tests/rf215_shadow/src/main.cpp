@@ -0,0 +1,113 @@
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "kaonic/comm/radio/rf215_radio.hpp"
+#include "kaonic/common/logging.hpp"
+
+using namespace kaonic;
+
+using comm::rf215_register_shadow;
+
+// Register addresses of the RF215 datasheet
+constexpr static rf215_reg_t rg_rf_rst = 0x0005;
+constexpr static rf215_reg_t rg_rf09_cmd = 0x0103;
+constexpr static rf215_reg_t rg_rf24_cmd = 0x0203;
+
+constexpr static uint8_t cmd_txprep = 0x03;
+constexpr static uint8_t cmd_reset = 0x07;
+
+// Channel registers of RF09 (CS, CCF0L, CCF0H, CNL) and RF24
+static const std::vector<std::pair<rf215_reg_t, uint8_t>> channel_config {
+    { 0x0104, 0x08 }, { 0x0105, 0x8C }, { 0x0106, 0x86 }, { 0x0107, 0x01 },
+    { 0x0204, 0x08 }, { 0x0205, 0x20 }, { 0x0206, 0x8D }, { 0x0207, 0x02 },
+};
+
+static auto make_shadow() -> rf215_register_shadow {
+    rf215_register_shadow shadow;
+
+    for (const auto reg : { rg_rf_rst, rg_rf09_cmd, rg_rf24_cmd }) {
+        shadow.uncached.set(reg);
+        shadow.resets.set(reg);
+    }
+
+    return shadow;
+}
+
+// Does what rf215_radio::write() does, returns whether the write reaches the chip
+static auto write(rf215_register_shadow& shadow, rf215_reg_t reg, uint8_t value) -> bool {
+    if (shadow.is_cached(reg, &value, 1)) {
+        return false;
+    }
+
+    shadow.update(reg, &value, 1);
+    return true;
+}
+
+static auto configure(rf215_register_shadow& shadow) -> size_t {
+    size_t writes = 0;
+    for (const auto& [reg, value] : channel_config) {
+        writes += write(shadow, reg, value) ? 1 : 0;
+    }
+    return writes;
+}
+
+// Same configuration after a reset is written again, the chip forgot it
+static auto test_reset() -> int {
+    log::info("[RF215 Shadow Test] Reset test");
+
+    auto shadow = make_shadow();
+
+    if (configure(shadow) != channel_config.size() || configure(shadow) != 0) {
+        log::error("FAIL: unchanged configuration wasn't skipped");
+        return -1;
+    }
+
+    // Other commands leave the registers alone
+    if (!write(shadow, rg_rf09_cmd, cmd_txprep) || configure(shadow) != 0) {
+        log::error("FAIL: a command other than RESET dropped the cache");
+        return -1;
+    }
+
+    const std::array<std::pair<rf215_reg_t, const char*>, 3> resets { {
+        { rg_rf09_cmd, "RF09 RESET command" },
+        { rg_rf24_cmd, "RF24 RESET command" },
+        { rg_rf_rst, "chip reset" },
+    } };
+
+    for (const auto& [reg, name] : resets) {
+        if (!write(shadow, reg, cmd_reset)) {
+            log::error("FAIL: {} didn't reach the chip", name);
+            return -1;
+        }
+
+        if (const auto writes = configure(shadow); writes != channel_config.size()) {
+            log::error("FAIL: {} of {} registers rewritten after the {}",
+                       writes,
+                       channel_config.size(),
+                       name);
+            return -1;
+        }
+    }
+
+    // Reset inside a burst, e.g. RG_CMD written along with the registers after it
+    const std::array<uint8_t, 2> burst { cmd_reset, 0x08 };
+    shadow.update(rg_rf09_cmd, burst.data(), burst.size());
+
+    if (configure(shadow) != channel_config.size()) {
+        log::error("FAIL: reset written in a burst kept the cache");
+        return -1;
+    }
+
+    log::info("[RF215 Shadow Test] [reset] PASSED");
+    return 0;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+    int rc = 0;
+
+    rc += test_reset();
+
+    return rc;
+}
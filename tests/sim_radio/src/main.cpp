@@ -0,0 +1,228 @@
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "kaonic/comm/radio/sim_radio.hpp"
+#include "kaonic/common/logging.hpp"
+
+using namespace kaonic;
+using namespace std::chrono_literals;
+
+static auto make_config(uint8_t channel) -> comm::radio_config {
+    return comm::radio_config {
+        .freq = 869535,
+        .channel = channel,
+        .channel_spacing = 200,
+        .tx_power = 10,
+        .phy_config =
+            comm::radio_phy_config_ofdm {
+                .mcs = 6,
+                .opt = 0,
+            },
+    };
+}
+
+static auto make_frame(size_t len) -> std::vector<uint8_t> {
+    std::vector<uint8_t> frame(len);
+    std::iota(frame.begin(), frame.end(), 1);
+    return frame;
+}
+
+static auto test_airtime() -> int {
+    log::info("[Sim Radio Test] Airtime test");
+
+    const auto mcs6 =
+        comm::sim_radio::airtime(comm::radio_phy_config_ofdm { .mcs = 6, .opt = 0 }, 100);
+    const auto mcs0 =
+        comm::sim_radio::airtime(comm::radio_phy_config_ofdm { .mcs = 0, .opt = 0 }, 100);
+    const auto opt3 =
+        comm::sim_radio::airtime(comm::radio_phy_config_ofdm { .mcs = 6, .opt = 3 }, 100);
+    const auto fsk = comm::sim_radio::airtime(comm::radio_phy_config_fsk {}, 100);
+
+    log::info("[Sim Radio Test] 100B: mcs6={}us mcs0={}us opt3={}us fsk={}us",
+              mcs6.count(),
+              mcs0.count(),
+              opt3.count(),
+              fsk.count());
+
+    if (!(mcs6 < mcs0) || !(mcs6 < opt3)) {
+        log::error("FAIL: OFDM airtime doesn't follow data rate");
+        return -1;
+    }
+
+    // 50ksym/s 2-FSK: (100 + 4 FCS + 4 preamble + 4 SFD/PHR) * 8 bits at 20us
+    if (fsk != 17920us) {
+        log::error("FAIL: FSK airtime mismatch");
+        return -1;
+    }
+
+    log::info("[Sim Radio Test] [airtime] PASSED");
+    return 0;
+}
+
+static auto test_delivery() -> int {
+    log::info("[Sim Radio Test] Delivery test");
+
+    const auto medium = std::make_shared<comm::sim_medium>();
+
+    comm::sim_radio radio_a { comm::sim_radio_config { .name = "a" }, medium };
+    comm::sim_radio radio_b { comm::sim_radio_config { .name = "b" }, medium };
+    comm::sim_radio radio_c { comm::sim_radio_config { .name = "c" }, medium };
+
+    auto err = radio_a.configure(make_config(11));
+    err += radio_b.configure(make_config(11));
+    err += radio_c.configure(make_config(1));
+
+    if (!err.is_ok()) {
+        log::error("FAIL: configure");
+        return -1;
+    }
+
+    const auto tx_frame = make_frame(64);
+    if (auto err = radio_a.transmit(tx_frame); !err.is_ok()) {
+        log::error("FAIL: transmit");
+        return -1;
+    }
+
+    comm::radio_frame rx_frame;
+    size_t rx_len = 0;
+    comm::radio_rx_info rx_info;
+    if (auto err = radio_b.receive(rx_frame.data, rx_len, rx_info, 10ms); !err.is_ok()) {
+        log::error("FAIL: frame wasn't delivered");
+        return -1;
+    }
+
+    if (rx_len != tx_frame.size() || !std::equal(tx_frame.begin(), tx_frame.end(), rx_frame.data)) {
+        log::error("FAIL: frame mismatch");
+        return -1;
+    }
+
+    if (rx_info.rssi != comm::sim_link {}.rssi || rx_info.timestamp.count() == 0) {
+        log::error("FAIL: frame metadata is missing");
+        return -1;
+    }
+
+    if (auto err = radio_c.receive(rx_frame.data, rx_len, rx_info, 10ms); err.is_ok()) {
+        log::error("FAIL: frame delivered to another channel");
+        return -1;
+    }
+
+    if (auto err = radio_a.receive(rx_frame.data, rx_len, rx_info, 10ms); err.is_ok()) {
+        log::error("FAIL: frame delivered to the sender");
+        return -1;
+    }
+
+    log::info("[Sim Radio Test] [delivery] PASSED");
+    return 0;
+}
+
+static auto test_loss() -> int {
+    log::info("[Sim Radio Test] Loss test");
+
+    const auto medium = std::make_shared<comm::sim_medium>();
+
+    comm::sim_radio radio_a { comm::sim_radio_config { .name = "a" }, medium };
+    comm::sim_radio radio_b { comm::sim_radio_config { .name = "b",
+                                                       .loss_rate = 0.5,
+                                                       .rx_queue_size = 1024,
+                                                       .seed = 1 },
+                              medium };
+
+    auto config = make_config(11);
+    config.phy_config = comm::radio_phy_config_ofdm { .mcs = 6, .opt = 0 };
+
+    auto err = radio_a.configure(config);
+    err += radio_b.configure(config);
+
+    constexpr size_t frame_count = 200;
+
+    const auto tx_frame = make_frame(8);
+    for (size_t i = 0; i < frame_count; ++i) {
+        err += radio_a.transmit(tx_frame);
+    }
+
+    if (!err.is_ok()) {
+        log::error("FAIL: transmit");
+        return -1;
+    }
+
+    size_t received = 0;
+    comm::radio_frame rx_frame;
+    size_t rx_len = 0;
+    comm::radio_rx_info rx_info;
+    while (radio_b.receive(rx_frame.data, rx_len, rx_info, 1ms).is_ok()) {
+        ++received;
+    }
+
+    log::info("[Sim Radio Test] received {}/{} frames", received, frame_count);
+
+    if (received < frame_count / 4 || received > (frame_count * 3) / 4) {
+        log::error("FAIL: loss rate is out of range");
+        return -1;
+    }
+
+    log::info("[Sim Radio Test] [loss] PASSED");
+    return 0;
+}
+
+static auto test_collision() -> int {
+    log::info("[Sim Radio Test] Collision test");
+
+    const auto medium = std::make_shared<comm::sim_medium>(comm::sim_medium_config {
+        .default_link = { .propagation_delay = 2ms },
+    });
+
+    comm::sim_radio radio_a { comm::sim_radio_config { .name = "a" }, medium };
+    comm::sim_radio radio_b { comm::sim_radio_config { .name = "b" }, medium };
+    comm::sim_radio radio_c { comm::sim_radio_config { .name = "c" }, medium };
+
+    auto err = radio_a.configure(make_config(11));
+    err += radio_b.configure(make_config(11));
+    err += radio_c.configure(make_config(11));
+
+    const auto tx_frame = make_frame(512);
+
+    std::thread tx_thread { [&] { auto err = radio_a.transmit(tx_frame); } };
+    err += radio_b.transmit(tx_frame);
+    tx_thread.join();
+
+    comm::radio_frame rx_frame;
+    size_t rx_len = 0;
+    comm::radio_rx_info rx_info;
+    if (auto err = radio_c.receive(rx_frame.data, rx_len, rx_info, 10ms); err.is_ok()) {
+        log::error("FAIL: collided frame was delivered");
+        return -1;
+    }
+
+    const auto stats = medium->get_stats();
+    if (stats.collisions == 0 || stats.delivered != 0) {
+        log::error("FAIL: collision wasn't detected");
+        return -1;
+    }
+
+    err += radio_a.transmit(tx_frame);
+
+    if (auto err = radio_c.receive(rx_frame.data, rx_len, rx_info, 1ms); err.is_ok()) {
+        log::error("FAIL: frame delivered before propagation delay");
+        return -1;
+    }
+
+    if (auto err = radio_c.receive(rx_frame.data, rx_len, rx_info, 10ms); !err.is_ok()) {
+        log::error("FAIL: frame wasn't delivered after propagation delay");
+        return -1;
+    }
+
+    log::info("[Sim Radio Test] [collision] PASSED");
+    return 0;
+}
+
+auto main(int argc, char** argv) noexcept -> int {
+    int rc = 0;
+
+    rc += test_airtime();
+    rc += test_delivery();
+    rc += test_loss();
+    rc += test_collision();
+
+    return rc;
+}